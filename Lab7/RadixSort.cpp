@@ -0,0 +1,193 @@
+#include "RadixSort.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstring>
+#include <mutex>
+#include <thread>
+
+// all threads of one sort wait here between the phases of a pass
+class RadixSort::Barrier
+{
+public:
+    Barrier() : count(1), waiting(0), generation(0) {}
+
+    // only between sorts, when nobody is waiting
+    void reset(unsigned countIn) { count = countIn; }
+
+    void wait()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        unsigned current = generation;
+        if (++waiting == count)
+        {
+            waiting = 0;
+            generation++;
+            released.notify_all();
+            return;
+        }
+        released.wait(lock, [&] { return generation != current; });
+    }
+
+private:
+    std::mutex mutex;
+    std::condition_variable released;
+    unsigned count, waiting, generation;
+};
+
+RadixSort::RadixSort(unsigned threadsIn)
+    : size(0), workers(1), skip(false), barrier(new Barrier()), jobGeneration(0), jobPending(0), quitting(false)
+{
+    threads = threadsIn ? threadsIn : std::max(1u, std::thread::hardware_concurrency());
+    source[0] = source[1] = target[0] = target[1] = nullptr;
+    for (unsigned t = 1; t < threads; t++)
+        helpers.emplace_back(&RadixSort::helperLoop, this, t);
+}
+
+RadixSort::~RadixSort()
+{
+    {
+        std::lock_guard<std::mutex> lock(jobMutex);
+        quitting = true;
+    }
+    jobReady.notify_all();
+    for (std::thread& helper : helpers)
+        helper.join();
+}
+
+void RadixSort::helperLoop(unsigned t)
+{
+    unsigned seen = 0;
+    for (;;)
+    {
+        bool part;
+        {
+            std::unique_lock<std::mutex> lock(jobMutex);
+            jobReady.wait(lock, [&] { return quitting || jobGeneration != seen; });
+            if (quitting)
+                return;
+            seen = jobGeneration;
+            // small sorts use fewer threads, the rest sleep through them
+            part = t < workers;
+        }
+        if (!part)
+            continue;
+        runPasses(t);
+        std::lock_guard<std::mutex> lock(jobMutex);
+        if (--jobPending == 0)
+            jobDone.notify_one();
+    }
+}
+
+uint32_t RadixSort::floatKey(float value)
+{
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    // negatives: all bits flipped so larger magnitudes come first; positives: above every negative
+    return (bits & 0x80000000u) ? ~bits : bits | 0x80000000u;
+}
+
+void RadixSort::histogram(const uint32_t* keys, size_t first, size_t last, int shift, size_t* out) const
+{
+    std::fill(out, out + RADIX, 0);
+    for (size_t i = first; i < last; i++)
+        out[(keys[i] >> shift) & (RADIX - 1)]++;
+}
+
+void RadixSort::scatter(const uint32_t* keysIn, const uint32_t* valuesIn, uint32_t* keysOut, uint32_t* valuesOut,
+    size_t first, size_t last, int shift, size_t* offsets) const
+{
+    for (size_t i = first; i < last; i++)
+    {
+        size_t position = offsets[(keysIn[i] >> shift) & (RADIX - 1)]++;
+        keysOut[position] = keysIn[i];
+        valuesOut[position] = valuesIn[i];
+    }
+}
+
+void RadixSort::runPasses(unsigned t)
+{
+    const size_t n = size;
+    const size_t first = n * t / workers, last = n * (t + 1) / workers;
+    size_t* own = &counts[(size_t)t * RADIX];
+    for (int shift = 0; shift < 32; shift += 8)
+    {
+        histogram(source[0]->data(), first, last, shift, own);
+        barrier->wait();
+        if (t == 0)
+        {
+            // digit-major, thread-minor: thread t's keys with digit d go after every earlier thread's
+            skip = false;
+            size_t total = 0;
+            for (int d = 0; d < RADIX; d++)
+            {
+                size_t digitCount = 0;
+                for (unsigned w = 0; w < workers; w++)
+                {
+                    size_t count = counts[(size_t)w * RADIX + d];
+                    counts[(size_t)w * RADIX + d] = total;
+                    total += count;
+                    digitCount += count;
+                }
+                // every key has this digit, the pass would not move anything
+                if (digitCount == n)
+                    skip = true;
+            }
+        }
+        barrier->wait();
+        if (!skip)
+        {
+            scatter(source[0]->data(), source[1]->data(), target[0]->data(), target[1]->data(), first, last, shift, own);
+            barrier->wait();
+        }
+        if (t == 0 && !skip)
+        {
+            std::swap(source[0], target[0]);
+            std::swap(source[1], target[1]);
+        }
+        barrier->wait();
+    }
+}
+
+void RadixSort::sort(std::vector<uint32_t>& keys, std::vector<uint32_t>& values)
+{
+    const size_t n = keys.size();
+    if (n < 2 || values.size() != n)
+        return;
+    keyScratch.resize(n);
+    valueScratch.resize(n);
+    const unsigned used = (unsigned)std::min<size_t>(threads, std::max<size_t>(1, n / MIN_PARALLEL));
+    counts.assign((size_t)used * RADIX, 0);
+
+    // passes alternate between the input and the scratch vectors
+    size = n;
+    source[0] = &keys;
+    source[1] = &values;
+    target[0] = &keyScratch;
+    target[1] = &valueScratch;
+    skip = false;
+    barrier->reset(used);
+
+    {
+        std::lock_guard<std::mutex> lock(jobMutex);
+        workers = used;
+        jobPending = used - 1;
+        if (used > 1)
+            jobGeneration++;
+    }
+    if (used > 1)
+        jobReady.notify_all();
+    runPasses(0);
+    if (used > 1)
+    {
+        std::unique_lock<std::mutex> lock(jobMutex);
+        jobDone.wait(lock, [&] { return jobPending == 0; });
+    }
+
+    // an odd number of passes ran, the result sits in the scratch vectors
+    if (source[0] != &keys)
+    {
+        keys.swap(keyScratch);
+        values.swap(valueScratch);
+    }
+}
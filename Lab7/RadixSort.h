@@ -0,0 +1,71 @@
+#pragma once
+#ifndef RADIXSORT_H
+#define RADIXSORT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// LSD radix sort of 32 bit keys with a payload, four passes of 8 bits. Every pass the threads histogram
+// their own slice of the input, one prefix sum over all (digit, thread) counts gives every thread its
+// output positions, and the threads scatter their slices in parallel; each pass is stable, so the result is.
+// O(n) whatever the key distribution, which is what a per-frame sort of transparent draws needs.
+//
+// The helper threads are started once by the constructor and sleep between sorts, so a sort only pays for
+// waking them. Small inputs are sorted on the calling thread alone, waking helpers costs more than it saves there.
+class RadixSort
+{
+public:
+    // threads 0: one per hardware thread
+    explicit RadixSort(unsigned threads = 0);
+    ~RadixSort();
+
+    RadixSort(const RadixSort&) = delete;
+    RadixSort& operator=(const RadixSort&) = delete;
+
+    // sorts keys ascending and applies the same permutation to values (same size as keys)
+    void sort(std::vector<uint32_t>& keys, std::vector<uint32_t>& values);
+
+    // key that sorts like the float: ascending keys are ascending values, negatives included
+    static uint32_t floatKey(float value);
+
+    unsigned getThreadCount() const { return threads; }
+
+private:
+    static const int RADIX = 256;
+    static const size_t MIN_PARALLEL = 16384;   // keys per thread before more threads pay off
+
+    class Barrier;
+
+    unsigned threads;
+    std::vector<uint32_t> keyScratch, valueScratch;
+    std::vector<size_t> counts;                 // [thread][digit], then the output offsets
+
+    // the sort in flight, set up by sort() before the helpers are woken
+    size_t size;
+    unsigned workers;
+    std::vector<uint32_t>* source[2];
+    std::vector<uint32_t>* target[2];
+    bool skip;
+    std::unique_ptr<Barrier> barrier;
+
+    // helpers 1..threads-1; thread 0 is the caller of sort()
+    std::vector<std::thread> helpers;
+    std::mutex jobMutex;
+    std::condition_variable jobReady, jobDone;
+    unsigned jobGeneration;
+    unsigned jobPending;                        // helpers of the current sort still running
+    bool quitting;
+
+    void helperLoop(unsigned t);
+    void runPasses(unsigned t);
+    void histogram(const uint32_t* keys, size_t first, size_t last, int shift, size_t* out) const;
+    void scatter(const uint32_t* keysIn, const uint32_t* valuesIn, uint32_t* keysOut, uint32_t* valuesOut,
+        size_t first, size_t last, int shift, size_t* offsets) const;
+};
+
+#endif
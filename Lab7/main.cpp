@@ -9,25 +9,36 @@
 #include <iostream>
 #include <vector>
 #include <cmath>
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+
+#include "RadixSort.h"
 
 //  
 const char* vertexShaderSource = R"(
         #version 330 core
         layout (location = 0) in vec3 inPosition;  //  :  
         layout (location = 1) in vec3 inNormal;    //  :  
+        layout (location = 2) in mat4 inModel;     //  :   ( 2-5)
+        layout (location = 6) in vec4 inColor;     //  :   
 
         out vec3 FragPos;  //     
         out vec3 Normal;    //     
+        out vec4 Color;     //  
+        out float ViewDepth; //      
 
-        uniform mat4 model;       //  
         uniform mat4 view;        //  
         uniform mat4 projection;  //  
 
         void main()
         {
-            FragPos = vec3(model * vec4(inPosition, 1.0));  //      
-            Normal = mat3(transpose(inverse(model))) * inNormal;  //      
-            gl_Position = projection * view * vec4(FragPos, 1.0);  //    
+            FragPos = vec3(inModel * vec4(inPosition, 1.0));  //      
+            Normal = mat3(transpose(inverse(inModel))) * inNormal;  //      
+            Color = inColor;
+            vec4 viewPos = view * vec4(FragPos, 1.0);
+            ViewDepth = -viewPos.z;
+            gl_Position = projection * viewPos;  //    
         }
     )";
 
@@ -36,13 +47,14 @@ const char* fragmentShaderSource = R"(
         #version 330 core
         in vec3 FragPos;  //     
         in vec3 Normal;   //     
+        in vec4 Color;    //  
+        in float ViewDepth;
 
-        out vec4 FragColor;  //   
+        layout (location = 0) out vec4 FragColor;  //    (  OIT - )
+        layout (location = 1) out float Revealage; //    OIT:  ,   
 
         //      
         struct Material {
-            vec3 ambient;   //  
-            vec3 diffuse;   //  
             vec3 specular;  //  
             float shininess; //  
         };
@@ -58,18 +70,19 @@ const char* fragmentShaderSource = R"(
         uniform Material material;  //  
         uniform Light light;        //   
         uniform vec3 viewPos;       //  
+        uniform bool weighted;      //   (weighted blended OIT)   
 
         void main()
         {
             //    
-            vec3 ambient = light.ambient * material.ambient;
+            vec3 ambient = light.ambient * Color.rgb;
     
             //   
             vec3 norm = normalize(Normal);
             //       
             vec3 lightDir = normalize(light.position - FragPos);
             float diff = max(dot(norm, lightDir), 0.0);
-            vec3 diffuse = light.diffuse * (diff * material.diffuse);
+            vec3 diffuse = light.diffuse * (diff * Color.rgb);
     
             //       
             vec3 viewDir = normalize(viewPos - FragPos);
@@ -79,10 +92,56 @@ const char* fragmentShaderSource = R"(
     
             //    -  ,    
             vec3 result = ambient + diffuse + specular;
-            FragColor = vec4(result, 0.5);  //     
+            float alpha = Color.a;
+            if (!weighted)
+            {
+                FragColor = vec4(result, alpha);  //     
+                return;
+            }
+
+            //    (McGuire, Bavoil 2013):    ,    
+            float weight = alpha * clamp(10.0 / (1e-5 + pow(ViewDepth / 5.0, 2.0) + pow(ViewDepth / 200.0, 6.0)), 1e-2, 3e3);
+            FragColor = vec4(result * alpha, alpha) * weight;
+            Revealage = alpha;
         }
     )";
 
+//   :       
+const char* compositeVertexSource = R"(
+        #version 330 core
+        out vec2 TexCoords;
+
+        void main()
+        {
+            vec2 position = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);
+            TexCoords = position;
+            gl_Position = vec4(position * 2.0 - 1.0, 0.0, 1.0);
+        }
+    )";
+
+//   :      ,    
+const char* compositeFragmentSource = R"(
+        #version 330 core
+        in vec2 TexCoords;
+        out vec4 FragColor;
+
+        uniform sampler2D accumulation;
+        uniform sampler2D revealage;
+
+        void main()
+        {
+            float reveal = texture(revealage, TexCoords).r;
+            //     
+            if (reveal >= 1.0)
+                discard;
+            vec4 accum = texture(accumulation, TexCoords);
+            //   :    
+            if (isinf(max(max(abs(accum.r), abs(accum.g)), max(abs(accum.b), abs(accum.a)))))
+                accum.rgb = vec3(accum.a);
+            // :  * (1 - reveal) +  * reveal
+            FragColor = vec4(accum.rgb / clamp(accum.a, 1e-4, 5e4), 1.0 - reveal);
+        }
+    )";
 
 //        
 GLuint CompileShader(GLenum type, const char* source)
@@ -157,6 +216,90 @@ float vertices[] = {
 //  
 glm::ivec2 g_windowSize(640, 480);
 
+//   : GRID^3 
+const int GRID = 32;
+const int INSTANCE_COUNT = GRID * GRID * GRID;
+
+//    ,     2-6
+struct Instance
+{
+    glm::mat4 model;
+    glm::vec4 color;
+};
+
+//     ( 1, 2, 3)
+enum TransparencyMode
+{
+    MODE_UNSORTED,  //     :    
+    MODE_SORTED,    //         
+    MODE_WEIGHTED   // weighted blended OIT:      
+};
+
+const char* g_modeNames[] = { "unsorted blend", "radix sorted", "weighted blended OIT" };
+
+//   :  (RGBA16F)   (R8)
+struct OitTargets
+{
+    GLuint framebuffer = 0;
+    GLuint accumulation = 0;
+    GLuint revealage = 0;
+    glm::ivec2 size = glm::ivec2(0);
+};
+
+void ReleaseOitTargets(OitTargets& targets)
+{
+    glDeleteFramebuffers(1, &targets.framebuffer);
+    glDeleteTextures(1, &targets.accumulation);
+    glDeleteTextures(1, &targets.revealage);
+    targets = OitTargets();
+}
+
+bool CreateOitTargets(OitTargets& targets, glm::ivec2 size)
+{
+    ReleaseOitTargets(targets);
+    targets.size = size;
+
+    glGenTextures(1, &targets.accumulation);
+    glBindTexture(GL_TEXTURE_2D, targets.accumulation);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, size.x, size.y, 0, GL_RGBA, GL_HALF_FLOAT, NULL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+    glGenTextures(1, &targets.revealage);
+    glBindTexture(GL_TEXTURE_2D, targets.revealage);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, size.x, size.y, 0, GL_RED, GL_UNSIGNED_BYTE, NULL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    glGenFramebuffers(1, &targets.framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, targets.framebuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, targets.accumulation, 0);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, targets.revealage, 0);
+    const GLenum drawBuffers[] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+    glDrawBuffers(2, drawBuffers);
+    bool complete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    if (!complete)
+        std::cerr << "OIT framebuffer is not complete!" << std::endl;
+    return complete;
+}
+
+GLuint LinkProgram(const char* vertexSource, const char* fragmentSource)
+{
+    GLuint vertexShader = CompileShader(GL_VERTEX_SHADER, vertexSource);
+    GLuint fragmentShader = CompileShader(GL_FRAGMENT_SHADER, fragmentSource);
+
+    GLuint program = glCreateProgram();
+    glAttachShader(program, vertexShader);
+    glAttachShader(program, fragmentShader);
+    glLinkProgram(program);
+
+    glDeleteShader(vertexShader);
+    glDeleteShader(fragmentShader);
+    return program;
+}
+
 int main(void)
 {
     if (!glfwInit()) 
@@ -191,19 +334,12 @@ int main(void)
     //       OpenGL
     std::cout << "Renderer: " << glGetString(GL_RENDERER) << std::endl;
     std::cout << "OpenGL version: " << glGetString(GL_VERSION) << std::endl;
+    std::cout << "1 - unsorted blend, 2 - radix sorted, 3 - weighted blended OIT" << std::endl;
 
 
     //  
-    GLuint vertexShader = CompileShader(GL_VERTEX_SHADER, vertexShaderSource);
-    GLuint fragmentShader = CompileShader(GL_FRAGMENT_SHADER, fragmentShaderSource);
-
-    GLuint shaderProgram = glCreateProgram();
-    glAttachShader(shaderProgram, vertexShader);
-    glAttachShader(shaderProgram, fragmentShader);
-    glLinkProgram(shaderProgram);
-
-    glDeleteShader(vertexShader);
-    glDeleteShader(fragmentShader);
+    GLuint shaderProgram = LinkProgram(vertexShaderSource, fragmentShaderSource);
+    GLuint compositeProgram = LinkProgram(compositeVertexSource, compositeFragmentSource);
 
     //      
     glEnable(GL_DEPTH_TEST);
@@ -211,9 +347,11 @@ int main(void)
     glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
     //       
-    GLuint VBO, VAO;
+    GLuint VBO, VAO, instanceVBO, emptyVAO;
     glGenVertexArrays(1, &VAO);
+    glGenVertexArrays(1, &emptyVAO);
     glGenBuffers(1, &VBO);
+    glGenBuffers(1, &instanceVBO);
 
     glBindVertexArray(VAO);
     glBindBuffer(GL_ARRAY_BUFFER, VBO);
@@ -226,14 +364,43 @@ int main(void)
     glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)(3 * sizeof(float)));
     glEnableVertexAttribArray(1);
 
+    //  :     ,  
+    glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+    glBufferData(GL_ARRAY_BUFFER, INSTANCE_COUNT * sizeof(Instance), NULL, GL_STREAM_DRAW);
+    for (int column = 0; column < 4; column++)
+    {
+        glVertexAttribPointer(2 + column, 4, GL_FLOAT, GL_FALSE, sizeof(Instance), (void*)(column * sizeof(glm::vec4)));
+        glEnableVertexAttribArray(2 + column);
+        glVertexAttribDivisor(2 + column, 1);
+    }
+    glVertexAttribPointer(6, 4, GL_FLOAT, GL_FALSE, sizeof(Instance), (void*)offsetof(Instance, color));
+    glEnableVertexAttribArray(6);
+    glVertexAttribDivisor(6, 1);
+    glBindVertexArray(0);
+
+    // ,      
+    std::vector<glm::vec3> positions(INSTANCE_COUNT);
+    std::vector<glm::vec4> colors(INSTANCE_COUNT);
+    const float spacing = 3.0f / GRID;
+    for (int i = 0; i < INSTANCE_COUNT; i++)
+    {
+        glm::ivec3 cell(i % GRID, (i / GRID) % GRID, i / (GRID * GRID));
+        positions[i] = (glm::vec3(cell) - 0.5f * (GRID - 1)) * spacing;
+        glm::vec3 t = glm::vec3(cell) / float(GRID - 1);
+        colors[i] = glm::vec4(t.x, 0.3f + 0.7f * t.y, 1.0f - t.z, 0.25f + 0.5f * ((i * 7919) % 101) / 100.0f);
+    }
+    std::vector<Instance> instances(INSTANCE_COUNT);
+    std::vector<Instance> sortedInstances(INSTANCE_COUNT);
+    std::vector<uint32_t> sortKeys(INSTANCE_COUNT), sortOrder(INSTANCE_COUNT);
+    RadixSort radixSort;
+
+    OitTargets oit;
+
     //   
     glUseProgram(shaderProgram);
     //  uniform-  
-    GLuint modelLoc = glGetUniformLocation(shaderProgram, "model");
     GLuint viewLoc = glGetUniformLocation(shaderProgram, "view");
     GLuint projectionLoc = glGetUniformLocation(shaderProgram, "projection");
-    GLuint materialAmbientLoc = glGetUniformLocation(shaderProgram, "material.ambient");
-    GLuint materialDiffuseLoc = glGetUniformLocation(shaderProgram, "material.diffuse");
     GLuint materialSpecularLoc = glGetUniformLocation(shaderProgram, "material.specular");
     GLuint materialShininessLoc = glGetUniformLocation(shaderProgram, "material.shininess");
     GLuint lightPositionLoc = glGetUniformLocation(shaderProgram, "light.position");
@@ -241,10 +408,9 @@ int main(void)
     GLuint lightDiffuseLoc = glGetUniformLocation(shaderProgram, "light.diffuse");
     GLuint lightSpecularLoc = glGetUniformLocation(shaderProgram, "light.specular");
     GLuint viewPosLoc = glGetUniformLocation(shaderProgram, "viewPos");
+    GLuint weightedLoc = glGetUniformLocation(shaderProgram, "weighted");
 
     //   
-    glUniform3f(materialAmbientLoc, 0.0f, 0.1f, 0.06f);
-    glUniform3f(materialDiffuseLoc, 0.0f, 0.50980392f, 0.50980392f);
     glUniform3f(materialSpecularLoc, 0.50196078f, 0.50196078f, 0.50196078f);
     glUniform1f(materialShininessLoc, 32.0f);
 
@@ -254,36 +420,141 @@ int main(void)
     glUniform3f(lightDiffuseLoc, 0.5f, 0.5f, 0.5f);
     glUniform3f(lightSpecularLoc, 1.0f, 1.0f, 1.0f);
 
+    //  :    0,    1
+    glUseProgram(compositeProgram);
+    glUniform1i(glGetUniformLocation(compositeProgram, "accumulation"), 0);
+    glUniform1i(glGetUniformLocation(compositeProgram, "revealage"), 1);
+
+    TransparencyMode mode = MODE_UNSORTED;
+    double sortMilliseconds = 0.0;
+    double titleTime = 0.0;
+    const glm::vec3 cameraPos(0.0f, 0.0f, 5.0f);
+
     while (!glfwWindowShouldClose(window)) {
+        //   
+        for (int key = 0; key < 3; key++)
+            if (glfwGetKey(window, GLFW_KEY_1 + key) == GLFW_PRESS)
+                mode = (TransparencyMode)key;
+
+        glm::ivec2 framebufferSize;
+        glfwGetFramebufferSize(window, &framebufferSize.x, &framebufferSize.y);
+        if (framebufferSize.x == 0 || framebufferSize.y == 0) {
+            glfwPollEvents();
+            continue;
+        }
+        glViewport(0, 0, framebufferSize.x, framebufferSize.y);
+
         glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
         //     
-        glm::mat4 view = glm::lookAt(glm::vec3(0.0f, 0.0f, 3.0f), glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-        glm::mat4 projection = glm::perspective(glm::radians(45.0f), 800.0f / 600.0f, 0.1f, 100.0f);
+        glm::mat4 view = glm::lookAt(cameraPos, glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+        glm::mat4 projection = glm::perspective(glm::radians(45.0f), (float)framebufferSize.x / framebufferSize.y, 0.1f, 100.0f);
+
+        //    ,      ,      
+        float time = (float)glfwGetTime();
+        glm::mat4 grid = glm::rotate(glm::mat4(1.0f), 0.3f * time, glm::vec3(0.2f, 1.0f, 0.0f));
+        for (int i = 0; i < INSTANCE_COUNT; i++)
+        {
+            glm::mat4 model = glm::translate(grid, positions[i]);
+            model = glm::rotate(model, time + 0.1f * i, glm::vec3(1.0f, 0.5f, 0.0f));
+            instances[i].model = glm::scale(model, glm::vec3(0.6f * spacing));
+            instances[i].color = colors[i];
+        }
+
+        //     :  -    
+        const Instance* upload = instances.data();
+        if (mode == MODE_SORTED)
+        {
+            auto sortStart = std::chrono::high_resolution_clock::now();
+            for (int i = 0; i < INSTANCE_COUNT; i++)
+            {
+                float depth = -(view * instances[i].model[3]).z;
+                sortKeys[i] = ~RadixSort::floatKey(depth);
+                sortOrder[i] = (uint32_t)i;
+            }
+            radixSort.sort(sortKeys, sortOrder);
+            for (int i = 0; i < INSTANCE_COUNT; i++)
+                sortedInstances[i] = instances[sortOrder[i]];
+            sortMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - sortStart).count();
+            upload = sortedInstances.data();
+        }
+
+        //    (  ,    GPU)
+        glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+        glBufferData(GL_ARRAY_BUFFER, INSTANCE_COUNT * sizeof(Instance), NULL, GL_STREAM_DRAW);
+        glBufferSubData(GL_ARRAY_BUFFER, 0, INSTANCE_COUNT * sizeof(Instance), upload);
 
+        glUseProgram(shaderProgram);
         //  uniform-   
         glUniformMatrix4fv(viewLoc, 1, GL_FALSE, glm::value_ptr(view));
         glUniformMatrix4fv(projectionLoc, 1, GL_FALSE, glm::value_ptr(projection));
 
-        //  
-        glm::mat4 model = glm::mat4(1.0f);
-        model = glm::rotate(model, (float)glfwGetTime(), glm::vec3(1.0f, 0.5f, 0.0f));
-        glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(model));
-
         //  
-        glUniform3f(viewPosLoc, 0.0f, 0.0f, 3.0f);
+        glUniform3f(viewPosLoc, cameraPos.x, cameraPos.y, cameraPos.z);
+        glUniform1i(weightedLoc, mode == MODE_WEIGHTED);
 
         glBindVertexArray(VAO);
-        glDrawArrays(GL_TRIANGLES, 0, 36);
+        if (mode == MODE_WEIGHTED)
+        {
+            if (oit.size != framebufferSize)
+                CreateOitTargets(oit, framebufferSize);
+
+            // :      (1 - alpha),    .
+            //   ,     ;  -       
+            glBindFramebuffer(GL_FRAMEBUFFER, oit.framebuffer);
+            const GLfloat clearAccumulation[] = { 0.0f, 0.0f, 0.0f, 0.0f };
+            const GLfloat clearRevealage[] = { 1.0f, 1.0f, 1.0f, 1.0f };
+            glClearBufferfv(GL_COLOR, 0, clearAccumulation);
+            glClearBufferfv(GL_COLOR, 1, clearRevealage);
+            glDisable(GL_DEPTH_TEST);
+            glBlendFunci(0, GL_ONE, GL_ONE);
+            glBlendFunci(1, GL_ZERO, GL_ONE_MINUS_SRC_COLOR);
+            glDrawArraysInstanced(GL_TRIANGLES, 0, 36, INSTANCE_COUNT);
+
+            //   
+            glBindFramebuffer(GL_FRAMEBUFFER, 0);
+            glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+            glUseProgram(compositeProgram);
+            glActiveTexture(GL_TEXTURE0);
+            glBindTexture(GL_TEXTURE_2D, oit.accumulation);
+            glActiveTexture(GL_TEXTURE1);
+            glBindTexture(GL_TEXTURE_2D, oit.revealage);
+            glBindVertexArray(emptyVAO);
+            glDrawArrays(GL_TRIANGLES, 0, 3);
+            glEnable(GL_DEPTH_TEST);
+        }
+        else
+        {
+            //     ,  : ,     .
+            //     ,       
+            glDepthMask(mode == MODE_SORTED ? GL_FALSE : GL_TRUE);
+            glDrawArraysInstanced(GL_TRIANGLES, 0, 36, INSTANCE_COUNT);
+            glDepthMask(GL_TRUE);
+        }
+
+        if (time - titleTime > 0.5)
+        {
+            char title[128];
+            if (mode == MODE_SORTED)
+                snprintf(title, sizeof(title), "Hello OpenGL - %d cubes, %s (%.2f ms, %u threads)", INSTANCE_COUNT, g_modeNames[mode], sortMilliseconds, radixSort.getThreadCount());
+            else
+                snprintf(title, sizeof(title), "Hello OpenGL - %d cubes, %s", INSTANCE_COUNT, g_modeNames[mode]);
+            glfwSetWindowTitle(window, title);
+            titleTime = time;
+        }
 
         glfwSwapBuffers(window);
         glfwPollEvents();
     }
 
+    ReleaseOitTargets(oit);
     glDeleteVertexArrays(1, &VAO);
+    glDeleteVertexArrays(1, &emptyVAO);
     glDeleteBuffers(1, &VBO);
+    glDeleteBuffers(1, &instanceVBO);
     glDeleteProgram(shaderProgram);
+    glDeleteProgram(compositeProgram);
 
     glfwTerminate();
     return 0;
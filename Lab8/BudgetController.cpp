@@ -0,0 +1,72 @@
+#include "BudgetController.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+	// weight of a new measurement in the running average
+	const double SMOOTHING = 0.3;
+	// relative error that is left alone
+	const double DEAD_BAND = 0.05;
+}
+
+double SmoothedValue::add(double sample)
+{
+	if (haveSample)
+		value += (sample - value) * SMOOTHING;
+	else
+	{
+		value = sample;
+		haveSample = true;
+	}
+	return value;
+}
+
+void SmoothedValue::reset()
+{
+	value = 0.0;
+	haveSample = false;
+}
+
+BudgetController::BudgetController(float dampingIn, float minScaleIn, float maxScaleIn)
+{
+	scale = 1.0f;
+	minScale = 0.0f;
+	maxScale = 1.0f;
+	damping = 1.0f;
+	setDamping(dampingIn);
+	setLimits(minScaleIn, maxScaleIn);
+}
+
+void BudgetController::setLimits(float minScaleIn, float maxScaleIn)
+{
+	minScale = std::max(minScaleIn, 0.0f);
+	maxScale = std::max(maxScaleIn, minScale);
+	scale = std::min(std::max(scale, minScale), maxScale);
+}
+
+void BudgetController::setDamping(float dampingIn)
+{
+	damping = std::min(std::max(dampingIn, 0.01f), 1.0f);
+}
+
+void BudgetController::reset(float scaleIn)
+{
+	scale = scaleIn;
+}
+
+float BudgetController::update(double measured, double budget)
+{
+	if (measured <= 0.0 || budget <= 0.0)
+		return scale;
+	const double ratio = budget / measured;
+	if (std::fabs(ratio - 1.0) < DEAD_BAND)
+		return scale;
+
+	// the measurement goes with the square of the scale
+	const double wanted = scale * std::sqrt(ratio);
+	scale += (float)((wanted - scale) * damping);
+	scale = std::min(std::max(scale, minScale), maxScale);
+	return scale;
+}
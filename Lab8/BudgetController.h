@@ -0,0 +1,48 @@
+#pragma once
+#ifndef BUDGETCONTROLLER_H
+#define BUDGETCONTROLLER_H
+
+// Running average of a measurement; the first sample is taken as it is.
+class SmoothedValue
+{
+public:
+	SmoothedValue() { reset(); }
+
+	double add(double sample);
+	void reset();
+
+	double get() const { return value; }
+
+private:
+	double value;
+	bool haveSample;
+};
+
+// Moves a scale so that a measurement which grows with its square (triangles with the tessellation levels,
+// pixels with the resolution) meets a budget. The measurements are query results a few frames old, so errors
+// inside a dead band are ignored and only part of each correction is applied; the scale does not hunt while
+// the results of the last change are still in flight. Shared by TessellationController and DynamicResolution.
+class BudgetController
+{
+public:
+	BudgetController(float damping, float minScale, float maxScale);
+
+	void setLimits(float minScaleIn, float maxScaleIn);
+	// share of each correction applied per measurement, (0, 1]
+	void setDamping(float dampingIn);
+	void reset(float scaleIn);
+
+	// one (smoothed) measurement against the budget; returns the scale to use from now on
+	float update(double measured, double budget);
+
+	float getScale() const { return scale; }
+	float getMinScale() const { return minScale; }
+	float getMaxScale() const { return maxScale; }
+
+private:
+	float scale;
+	float minScale, maxScale;
+	float damping;
+};
+
+#endif
@@ -40,6 +40,13 @@ glm::mat4 Camera::GetViewMatrix()
 	return glm::lookAt(Position, Position + Front, Up);
 }
 
+glm::mat4 Camera::GetProjectionMatrix(float aspect, float zNear, float zFar, const glm::vec2 &jitter) const
+{
+	glm::mat4 projection = glm::perspective(glm::radians(Zoom), aspect, zNear, zFar);
+	// offset after the projection, so it is the same in NDC at every depth
+	return glm::translate(glm::mat4(1.0f), glm::vec3(jitter, 0.0f)) * projection;
+}
+
 void Camera::ProcessKeyboard(Camera_Movement direction, float deltaTime)
 {
 	float velocity = MovementSpeed * deltaTime;
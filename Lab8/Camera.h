@@ -51,6 +51,8 @@ public:
 	void printCameraCoords();
 	// Returns the view matrix calculated using Euler Angles and the LookAt Matrix
 	glm::mat4 GetViewMatrix();
+	// Perspective projection from Zoom; jitter moves the whole image by a sub-pixel amount in NDC (temporal upscaling)
+	glm::mat4 GetProjectionMatrix(float aspect, float zNear, float zFar, const glm::vec2 &jitter = glm::vec2(0.0f)) const;
 	// Processes input received from any keyboard-like input system. Accepts input parameter in the form of camera defined ENUM (to abstract it from windowing systems)
 	void ProcessKeyboard(Camera_Movement direction, float deltaTime);
 	// Processes input received from a mouse input system. Expects the offset value in both the x and y direction.
@@ -0,0 +1,321 @@
+#include "ClusteredLights.h"
+#include "JobSystem.h"
+#include "FrameArena.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define CLUSTEREDLIGHTS_SSE
+#include <xmmintrin.h>
+#endif
+
+const float ClusteredLights::SLICE_NEAR = 2.0f;
+
+namespace
+{
+	const int TILES_PER_SLICE = ClusteredLights::TILES_X * ClusteredLights::TILES_Y;
+	// alignment padding of the three allocations per frame
+	const GLsizeiptr RING_SLACK = 1024;
+}
+
+ClusteredLights::ClusteredLights()
+{
+	frameOpen = false;
+	maxLights = 0;
+	maxIndices = 0;
+	fovY = aspect = zNear = zFar = 0.0f;
+	for (int i = 0; i <= SLICES; i++)
+		sliceDepth[i] = 0.0f;
+	for (int i = 0; i < SLICES; i++)
+		sliceLights[i] = SliceLights();
+	lightOffset = clusterOffset = indexOffset = 0;
+	lightBytes = clusterBytes = indexBytes = 0;
+	stats = Stats();
+}
+
+ClusteredLights::~ClusteredLights()
+{
+	release();
+}
+
+bool ClusteredLights::create(size_t maxLightsIn, size_t maxIndicesIn)
+{
+	release();
+	if (maxLightsIn == 0 || maxIndicesIn == 0)
+	{
+		std::cout << "ERROR::CLUSTEREDLIGHTS:: needs room for at least one light" << std::endl;
+		return false;
+	}
+	maxLights = maxLightsIn;
+	maxIndices = maxIndicesIn;
+	GLsizeiptr frameBytes = (GLsizeiptr)(maxLights * sizeof(PointLight) + CLUSTER_COUNT * 2 * sizeof(GLuint)
+		+ maxIndices * sizeof(GLuint)) + RING_SLACK;
+	ring.reset(new RingBuffer(frameBytes));
+
+	viewLights.reserve(maxLights);
+	sliceIndices.resize(SLICES);
+	clusterCounts.assign(CLUSTER_COUNT, 0);
+	bounds.minX.resize(CLUSTER_COUNT);
+	bounds.minY.resize(CLUSTER_COUNT);
+	bounds.minZ.resize(CLUSTER_COUNT);
+	bounds.maxX.resize(CLUSTER_COUNT);
+	bounds.maxY.resize(CLUSTER_COUNT);
+	bounds.maxZ.resize(CLUSTER_COUNT);
+	fovY = 0.0f;
+	return true;
+}
+
+void ClusteredLights::release()
+{
+	ring.reset();
+	frameOpen = false;
+	viewLights.clear();
+	sliceIndices.clear();
+	clusterCounts.clear();
+	lightBytes = clusterBytes = indexBytes = 0;
+	stats = Stats();
+}
+
+void ClusteredLights::buildBounds(float fovYIn, float aspectIn, float zNearIn, float zFarIn)
+{
+	fovY = fovYIn;
+	aspect = aspectIn;
+	zNear = zNearIn;
+	zFar = zFarIn;
+
+	// slice 0 up to SLICE_NEAR, then equal steps in log depth; close to the camera a linear split would
+	// waste most slices on a few metres
+	const float sliceNear = std::min(SLICE_NEAR, zFar);
+	sliceDepth[0] = std::min(zNear, sliceNear);
+	for (int k = 1; k < SLICES; k++)
+		sliceDepth[k] = sliceNear * std::pow(zFar / sliceNear, (float)(k - 1) / (SLICES - 1));
+	sliceDepth[SLICES] = zFar;
+
+	const float tanY = std::tan(fovY * 0.5f);
+	const float tanX = tanY * aspect;
+	for (int z = 0; z < SLICES; z++)
+	{
+		const float d0 = sliceDepth[z], d1 = sliceDepth[z + 1];
+		for (int y = 0; y < TILES_Y; y++)
+		{
+			const float y0 = -1.0f + 2.0f * y / TILES_Y, y1 = -1.0f + 2.0f * (y + 1) / TILES_Y;
+			for (int x = 0; x < TILES_X; x++)
+			{
+				const float x0 = -1.0f + 2.0f * x / TILES_X, x1 = -1.0f + 2.0f * (x + 1) / TILES_X;
+				// the tile's side planes through the slice's two depths, the box around those eight corners
+				const int c = x + TILES_X * (y + TILES_Y * z);
+				bounds.minX[c] = std::min(std::min(x0 * d0, x0 * d1), std::min(x1 * d0, x1 * d1)) * tanX;
+				bounds.maxX[c] = std::max(std::max(x0 * d0, x0 * d1), std::max(x1 * d0, x1 * d1)) * tanX;
+				bounds.minY[c] = std::min(std::min(y0 * d0, y0 * d1), std::min(y1 * d0, y1 * d1)) * tanY;
+				bounds.maxY[c] = std::max(std::max(y0 * d0, y0 * d1), std::max(y1 * d0, y1 * d1)) * tanY;
+				bounds.minZ[c] = -d1;
+				bounds.maxZ[c] = -d0;
+			}
+		}
+	}
+}
+
+glm::vec3 ClusteredLights::getSliceParams() const
+{
+	const float sliceNear = std::min(SLICE_NEAR, zFar);
+	const float scale = zFar > sliceNear ? (SLICES - 1) / std::log(zFar / sliceNear) : 0.0f;
+	return glm::vec3(scale, std::log(sliceNear) * scale, sliceNear);
+}
+
+void ClusteredLights::update(const std::vector<PointLight> &lights, const glm::mat4 &view, float fovYIn, float aspectIn,
+	float zNearIn, float zFarIn)
+{
+	if (!ring)
+		return;
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	// fences the region the previous frame read; every draw of that frame has been issued by now
+	if (frameOpen)
+		ring->endFrame();
+	ring->beginFrame();
+	frameOpen = true;
+	if (fovYIn != fovY || aspectIn != aspect || zNearIn != zNear || zFarIn != zFar)
+		buildBounds(fovYIn, aspectIn, zNearIn, zFarIn);
+
+	// view-space spheres, each handed to the slices its depth range reaches; the lists only live through
+	// this update, so they come from the frame arena, counted first to give every slice one exact span
+	const size_t count = std::min(lights.size(), maxLights);
+	const glm::vec3 slice = getSliceParams();
+	LinearArena &arena = FrameArena::get().current();
+	int *ranges = static_cast<int*>(arena.allocate(std::max<size_t>(count, 1) * 2 * sizeof(int), alignof(int)));
+	size_t sliceCounts[SLICES] = {};
+	viewLights.resize(count);
+	for (size_t i = 0; i < count; i++)
+	{
+		glm::vec3 centre = glm::vec3(view * glm::vec4(lights[i].position, 1.0f));
+		const float radius = lights[i].radius;
+		viewLights[i] = glm::vec4(centre, radius);
+		ranges[i * 2] = 0;
+		ranges[i * 2 + 1] = -1;
+		const float nearest = -centre.z - radius, farthest = -centre.z + radius;
+		if (radius <= 0.0f || farthest < zNear || nearest > zFar)
+			continue;
+		int first = nearest < slice.z ? 0 : 1 + (int)(std::log(nearest) * slice.x - slice.y);
+		int last = farthest < slice.z ? 0 : 1 + (int)(std::log(farthest) * slice.x - slice.y);
+		ranges[i * 2] = first = std::max(first, 0);
+		ranges[i * 2 + 1] = last = std::min(last, SLICES - 1);
+		for (int z = first; z <= last; z++)
+			sliceCounts[z]++;
+	}
+	size_t idTotal = 0, groupTotal = 0;
+	for (int z = 0; z < SLICES; z++)
+	{
+		idTotal += sliceCounts[z];
+		groupTotal += (sliceCounts[z] + 3) / 4;
+	}
+	int *ids = static_cast<int*>(arena.allocate(std::max<size_t>(idTotal, 1) * sizeof(int), alignof(int)));
+	// 16-byte aligned, the SSE path loads the groups with aligned loads
+	float *packed = static_cast<float*>(arena.allocate(std::max<size_t>(groupTotal, 1) * 16 * sizeof(float), 16));
+	for (int z = 0; z < SLICES; z++)
+	{
+		sliceLights[z].ids = ids;
+		sliceLights[z].count = 0;
+		sliceLights[z].packed = packed;
+		ids += sliceCounts[z];
+		packed += (sliceCounts[z] + 3) / 4 * 16;
+	}
+	for (size_t i = 0; i < count; i++)
+		for (int z = ranges[i * 2]; z <= ranges[i * 2 + 1]; z++)
+			sliceLights[z].ids[sliceLights[z].count++] = (int)i;
+
+	JobSystem::instance().parallelFor(0, SLICES, 1, [this](int first, int last)
+	{
+		for (int z = first; z < last; z++)
+			binSlice(z);
+	});
+
+	// the slices' lists one after another are the index buffer; the counts give every cluster its range
+	stats = Stats();
+	stats.lights = count;
+	lightBytes = (GLsizeiptr)std::max<size_t>(count, 1) * sizeof(PointLight);
+	clusterBytes = CLUSTER_COUNT * 2 * sizeof(GLuint);
+	size_t total = 0;
+	for (int z = 0; z < SLICES; z++)
+		total += sliceIndices[z].size();
+	indexBytes = (GLsizeiptr)(std::max<size_t>(std::min(total, maxIndices), 1) * sizeof(GLuint));
+	RingBuffer::Allocation lightBlock = ring->allocate(lightBytes);
+	RingBuffer::Allocation clusterBlock = ring->allocate(clusterBytes);
+	RingBuffer::Allocation indexBlock = ring->allocate(indexBytes);
+	if (!lightBlock.data || !clusterBlock.data || !indexBlock.data)
+	{
+		lightBytes = clusterBytes = indexBytes = 0;
+		return;
+	}
+	lightOffset = lightBlock.offset;
+	clusterOffset = clusterBlock.offset;
+	indexOffset = indexBlock.offset;
+
+	if (count > 0)
+		std::memcpy(lightBlock.data, lights.data(), count * sizeof(PointLight));
+	GLuint *clusters = static_cast<GLuint*>(clusterBlock.data);
+	GLuint *indices = static_cast<GLuint*>(indexBlock.data);
+	size_t written = 0;
+	for (int z = 0; z < SLICES; z++)
+	{
+		const GLuint *source = sliceIndices[z].data();
+		for (int t = 0; t < TILES_PER_SLICE; t++)
+		{
+			const int c = z * TILES_PER_SLICE + t;
+			size_t found = clusterCounts[c];
+			size_t kept = std::min(found, maxIndices - written);
+			if (kept < found)
+				stats.overflow = true;
+			if (kept > 0)
+				std::memcpy(indices + written, source, kept * sizeof(GLuint));
+			clusters[c * 2] = (GLuint)written;
+			clusters[c * 2 + 1] = (GLuint)kept;
+			source += found;
+			written += kept;
+			stats.maxPerCluster = std::max(stats.maxPerCluster, found);
+			if (found > 0)
+				stats.busyClusters++;
+		}
+	}
+	stats.indices = written;
+	stats.binMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+void ClusteredLights::binSlice(int z)
+{
+	// the slice's lights in groups of four, padded with spheres nothing can touch
+	const int *ids = sliceLights[z].ids;
+	const size_t idCount = sliceLights[z].count;
+	float *packed = sliceLights[z].packed;
+	std::vector<GLuint> &out = sliceIndices[z];
+	out.clear();
+	const size_t groups = (idCount + 3) / 4;
+	std::fill(packed, packed + groups * 16, 0.0f);
+	for (size_t i = 0; i < groups * 4; i++)
+	{
+		float *group = &packed[(i / 4) * 16 + i % 4];
+		if (i < idCount)
+		{
+			const glm::vec4 &light = viewLights[ids[i]];
+			group[0] = light.x;
+			group[4] = light.y;
+			group[8] = light.z;
+			group[12] = light.w * light.w;
+		}
+		else
+			group[12] = -1.0f;
+	}
+
+	for (int t = 0; t < TILES_PER_SLICE; t++)
+	{
+		const int c = z * TILES_PER_SLICE + t;
+		const size_t before = out.size();
+		// squared distance from each sphere centre to the box, against the squared radius
+#ifdef CLUSTEREDLIGHTS_SSE
+		const __m128 zero = _mm_setzero_ps();
+		const __m128 minX = _mm_set1_ps(bounds.minX[c]), maxX = _mm_set1_ps(bounds.maxX[c]);
+		const __m128 minY = _mm_set1_ps(bounds.minY[c]), maxY = _mm_set1_ps(bounds.maxY[c]);
+		const __m128 minZ = _mm_set1_ps(bounds.minZ[c]), maxZ = _mm_set1_ps(bounds.maxZ[c]);
+		for (size_t g = 0; g < groups; g++)
+		{
+			const float *group = &packed[g * 16];
+			__m128 x = _mm_load_ps(group);
+			__m128 y = _mm_load_ps(group + 4);
+			__m128 zc = _mm_load_ps(group + 8);
+			__m128 dx = _mm_max_ps(_mm_max_ps(_mm_sub_ps(minX, x), zero), _mm_sub_ps(x, maxX));
+			__m128 dy = _mm_max_ps(_mm_max_ps(_mm_sub_ps(minY, y), zero), _mm_sub_ps(y, maxY));
+			__m128 dz = _mm_max_ps(_mm_max_ps(_mm_sub_ps(minZ, zc), zero), _mm_sub_ps(zc, maxZ));
+			__m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+			int hits = _mm_movemask_ps(_mm_cmple_ps(distance, _mm_load_ps(group + 12)));
+			for (int lane = 0; hits != 0; lane++, hits >>= 1)
+				if (hits & 1)
+					out.push_back((GLuint)ids[g * 4 + lane]);
+		}
+#else
+		for (size_t g = 0; g < groups; g++)
+		{
+			const float *group = &packed[g * 16];
+			for (int lane = 0; lane < 4; lane++)
+			{
+				float dx = std::max(std::max(bounds.minX[c] - group[lane], 0.0f), group[lane] - bounds.maxX[c]);
+				float dy = std::max(std::max(bounds.minY[c] - group[4 + lane], 0.0f), group[4 + lane] - bounds.maxY[c]);
+				float dz = std::max(std::max(bounds.minZ[c] - group[8 + lane], 0.0f), group[8 + lane] - bounds.maxZ[c]);
+				if (dx * dx + dy * dy + dz * dz <= group[12 + lane])
+					out.push_back((GLuint)ids[g * 4 + lane]);
+			}
+		}
+#endif
+		clusterCounts[c] = (GLuint)(out.size() - before);
+	}
+}
+
+void ClusteredLights::bind() const
+{
+	if (!ring || lightBytes == 0)
+		return;
+	glBindBufferRange(GL_SHADER_STORAGE_BUFFER, LIGHT_BINDING, ring->getBuffer(), lightOffset, lightBytes);
+	glBindBufferRange(GL_SHADER_STORAGE_BUFFER, CLUSTER_BINDING, ring->getBuffer(), clusterOffset, clusterBytes);
+	glBindBufferRange(GL_SHADER_STORAGE_BUFFER, INDEX_BINDING, ring->getBuffer(), indexOffset, indexBytes);
+}
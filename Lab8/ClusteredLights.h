@@ -0,0 +1,111 @@
+#pragma once
+#ifndef CLUSTEREDLIGHTS_H
+#define CLUSTEREDLIGHTS_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <memory>
+#include <vector>
+
+#include "RingBuffer.h"
+
+// point light as the shaders read it (std430: two vec4)
+struct PointLight
+{
+	glm::vec3 position;                 // world space
+	float radius;                       // no light beyond this distance
+	glm::vec3 colour;
+	float intensity;
+};
+
+// Clustered light assignment for forward shading. The view frustum is cut into a grid of clusters: screen
+// tiles times depth slices, the slices exponential in depth beyond SLICE_NEAR. Every frame each slice (one
+// job each) collects the lights whose spheres reach its depth range, tests them against its clusters four
+// lights per SSE sphere-box test, and every cluster gets a compact list of the lights touching it. A fragment then loops over the list
+// of its own cluster only, so the shading cost follows the lights per cluster, not the lights in the scene.
+//
+// Three storage blocks, written through a ring buffer and bound at these points:
+//   LIGHT_BINDING    PointLight lights[]
+//   CLUSTER_BINDING  uvec2 clusters[]      (first index, count), x + TILES_X * (y + TILES_Y * slice)
+//   INDEX_BINDING    uint indices[]
+// Shaders/terrainLighting.glsl has the lookup; the per-frame block gets what it needs from the getters below.
+class ClusteredLights
+{
+public:
+	static const int TILES_X = 16;
+	static const int TILES_Y = 9;
+	static const int SLICES = 24;
+	static const int CLUSTER_COUNT = TILES_X * TILES_Y * SLICES;
+	static const GLuint LIGHT_BINDING = 3;
+	static const GLuint CLUSTER_BINDING = 4;
+	static const GLuint INDEX_BINDING = 5;
+	// slice 0 covers everything closer than this, the exponential slices start here
+	static const float SLICE_NEAR;
+
+	struct Stats
+	{
+		size_t lights;
+		size_t indices;                 // light references over all clusters
+		size_t busyClusters;            // clusters with at least one light
+		size_t maxPerCluster;
+		double binMilliseconds;         // CPU time of the assignment
+		bool overflow;                  // the index list was full, some clusters lost lights
+	};
+
+	ClusteredLights();
+	~ClusteredLights();
+	ClusteredLights(const ClusteredLights&) = delete;
+	ClusteredLights &operator=(const ClusteredLights&) = delete;
+
+	// maxIndices bounds the light references per frame over all clusters
+	bool create(size_t maxLights = 1024, size_t maxIndices = CLUSTER_COUNT * 32);
+	void release();
+
+	// bins the lights for this camera, once per frame before the draws; fovY in radians
+	void update(const std::vector<PointLight> &lights, const glm::mat4 &view, float fovY, float aspect, float zNear, float zFar);
+	// binds the three blocks of the last update
+	void bind() const;
+
+	// (scale, bias, SLICE_NEAR): a view depth d beyond SLICE_NEAR is in slice 1 + int(log(d) * scale - bias)
+	glm::vec3 getSliceParams() const;
+	bool isCreated() const { return ring != nullptr; }
+	size_t getMaxLights() const { return maxLights; }
+	const Stats &getStats() const { return stats; }
+
+private:
+	// view-space boxes of the clusters
+	struct Bounds
+	{
+		std::vector<float> minX, minY, minZ, maxX, maxY, maxZ;
+	};
+
+	std::unique_ptr<RingBuffer> ring;
+	bool frameOpen;
+	size_t maxLights;
+	size_t maxIndices;
+	Bounds bounds;
+	float fovY, aspect, zNear, zFar;    // what the bounds were built for
+	float sliceDepth[SLICES + 1];
+	// per frame: lights in view space, then the lights and clusters each slice found
+	std::vector<glm::vec4> viewLights;
+	// spans in the frame arena: the lights reaching the slice, and the same packed in groups of four,
+	// x[4] y[4] z[4] radius^2[4]
+	struct SliceLights
+	{
+		int *ids;
+		size_t count;
+		float *packed;
+	};
+	SliceLights sliceLights[SLICES];
+	std::vector<std::vector<GLuint>> sliceIndices;
+	std::vector<GLuint> clusterCounts;
+	GLintptr lightOffset, clusterOffset, indexOffset;
+	GLsizeiptr lightBytes, clusterBytes, indexBytes;
+	Stats stats;
+
+	void buildBounds(float fovY, float aspect, float zNear, float zFar);
+	void binSlice(int slice);
+};
+
+#endif
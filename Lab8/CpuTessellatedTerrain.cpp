@@ -0,0 +1,244 @@
+#include "CpuTessellatedTerrain.h"
+#include "JobSystem.h"
+#include "FrameArena.h"
+#include "RenderState.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+#include <iostream>
+
+namespace
+{
+	// alignment padding of the two allocations per frame
+	const GLsizeiptr RING_SLACK = 1024;
+
+	bool sameLevels(const TessLevels &a, const TessLevels &b)
+	{
+		return a.outer[0] == b.outer[0] && a.outer[1] == b.outer[1] && a.outer[2] == b.outer[2] && a.inner[0] == b.inner[0];
+	}
+}
+
+CpuTessellatedTerrain::CpuTessellatedTerrain()
+{
+	field = nullptr;
+	VAO = 0;
+	levelScale = 1.0f;
+	frameOpen = false;
+	indexOffset = 0;
+	indexCount = 0;
+	stats = Stats();
+}
+
+CpuTessellatedTerrain::~CpuTessellatedTerrain()
+{
+	release();
+}
+
+float CpuTessellatedTerrain::tessLevel(float distance0, float distance1)
+{
+	float average = (distance0 + distance1) / 2.0f;
+	if (average < 80)
+		return 66;
+	else if (average < 120)
+		return 55;
+	else if (average < 150)
+		return 45;
+	else if (average < 180)
+		return 36;
+	else if (average < 200)
+		return 28;
+	else if (average < 250)
+		return 21;
+	else if (average < 300)
+		return 15;
+	else if (average < 350)
+		return 10;
+	else if (average < 400)
+		return 6;
+	return 3;
+}
+
+bool CpuTessellatedTerrain::build(const std::vector<float> &patchVertices, const HeightField &fieldIn, GLsizeiptr frameBytes)
+{
+	release();
+	const size_t floatsPerPatch = 3 * 5;
+	if (fieldIn.empty() || patchVertices.size() < floatsPerPatch)
+	{
+		std::cout << "ERROR::CPUTESSELLATION:: needs the terrain patches and a loaded height field" << std::endl;
+		return false;
+	}
+	field = &fieldIn;
+
+	// the GPU clamps the levels of the control shader to its own maximum, the patterns have to do the same
+	GLint maxLevel = 0;
+	glGetIntegerv(GL_MAX_TESS_GEN_LEVEL, &maxLevel);
+	tessellator.reset(new CpuTessellator(TessDomain::Triangles, TessSpacing::Equal, maxLevel > 0 ? maxLevel : 64));
+
+	patches.resize(patchVertices.size() / floatsPerPatch);
+	for (size_t p = 0; p < patches.size(); p++)
+	{
+		Patch &patch = patches[p];
+		const float *vertex = &patchVertices[p * floatsPerPatch];
+		for (int i = 0; i < 3; i++, vertex += 5)
+		{
+			patch.position[i] = glm::vec3(vertex[0], vertex[1], vertex[2]);
+			patch.uv[i] = glm::vec2(vertex[3], vertex[4]);
+		}
+		patch.levels = TessLevels();
+		patch.levels.outer[0] = -1.0f;
+	}
+
+	ring.reset(new RingBuffer(frameBytes));
+	glCreateVertexArrays(1, &VAO);
+	glEnableVertexArrayAttrib(VAO, 0);
+	glVertexArrayAttribFormat(VAO, 0, 3, GL_FLOAT, GL_FALSE, offsetof(Vertex, position));
+	glVertexArrayAttribBinding(VAO, 0, 0);
+	glEnableVertexArrayAttrib(VAO, 1);
+	glVertexArrayAttribFormat(VAO, 1, 3, GL_FLOAT, GL_FALSE, offsetof(Vertex, normal));
+	glVertexArrayAttribBinding(VAO, 1, 0);
+	glEnableVertexArrayAttrib(VAO, 2);
+	glVertexArrayAttribFormat(VAO, 2, 2, GL_FLOAT, GL_FALSE, offsetof(Vertex, uv));
+	glVertexArrayAttribBinding(VAO, 2, 0);
+	glVertexArrayElementBuffer(VAO, ring->getBuffer());
+	return true;
+}
+
+void CpuTessellatedTerrain::evaluate(Patch &patch) const
+{
+	// tessEvaluationShader.tes: interpolate the corners, height from the map, normal from the texels around it
+	const std::vector<glm::vec3> &coords = patch.pattern->coords;
+	const glm::vec2 texel = field->getTexelSize();
+	patch.vertices.resize(coords.size());
+	for (size_t i = 0; i < coords.size(); i++)
+	{
+		const glm::vec3 &c = coords[i];
+		Vertex &vertex = patch.vertices[i];
+		glm::vec3 position = patch.position[0] * c.x + patch.position[1] * c.y + patch.position[2] * c.z;
+		vertex.uv = patch.uv[0] * c.x + patch.uv[1] * c.y + patch.uv[2] * c.z;
+		position.y = field->getHeight(position.x, position.z);
+		float right = field->getHeight(position.x + texel.x, position.z);
+		float left = field->getHeight(position.x - texel.x, position.z);
+		float up = field->getHeight(position.x, position.z + texel.y);
+		float down = field->getHeight(position.x, position.z - texel.y);
+		vertex.normal = glm::normalize(glm::vec3(left - right, 1.0f, up - down));
+		vertex.position = position;
+	}
+}
+
+void CpuTessellatedTerrain::update(const glm::vec3 &camPos)
+{
+	if (patches.empty() || !ring)
+		return;
+	// fences the region the previous frame drew from; every draw of that frame has been issued by now
+	if (frameOpen)
+		ring->endFrame();
+	ring->beginFrame();
+	frameOpen = true;
+
+	// levels like the control shader, from the undisplaced corners; only patches whose levels changed
+	// are tessellated and displaced again
+	std::atomic<size_t> evaluated(0);
+	JobSystem::instance().parallelFor(0, (int)patches.size(), 64, [&](int first, int last)
+	{
+		for (int p = first; p < last; p++)
+		{
+			Patch &patch = patches[p];
+			float distance[3];
+			for (int i = 0; i < 3; i++)
+				distance[i] = glm::distance(camPos, patch.position[i]);
+			// equal spacing rounds the levels up, so comparing the rounded ones keeps the cache valid
+			// while the scale drifts by less than a segment
+			TessLevels levels = TessLevels();
+			levels.outer[0] = std::ceil(std::max(tessLevel(distance[1], distance[2]) * levelScale, 1.0f));
+			levels.outer[1] = std::ceil(std::max(tessLevel(distance[2], distance[0]) * levelScale, 1.0f));
+			levels.outer[2] = std::ceil(std::max(tessLevel(distance[0], distance[1]) * levelScale, 1.0f));
+			levels.inner[0] = levels.outer[2];
+			if (patch.pattern && sameLevels(levels, patch.levels))
+				continue;
+			patch.levels = levels;
+			patch.pattern = tessellator->getPattern(levels);
+			evaluate(patch);
+			evaluated++;
+		}
+	});
+
+	// placement in the region; when it is full the remaining patches are skipped for this frame
+	stats.overflow = false;
+	Placement *placements = static_cast<Placement*>(FrameArena::get().current().allocate(patches.size() * sizeof(Placement), alignof(Placement)));
+	size_t vertexTotal = 0, indexTotal = 0, drawn = 0;
+	for (const Patch &patch : patches)
+	{
+		size_t vertices = patch.vertices.size();
+		size_t indices = patch.pattern->indices.size();
+		GLsizeiptr bytes = (GLsizeiptr)((vertexTotal + vertices) * sizeof(Vertex) + (indexTotal + indices) * sizeof(GLuint));
+		if (bytes + RING_SLACK > ring->getFrameSize())
+		{
+			stats.overflow = true;
+			break;
+		}
+		placements[drawn].firstVertex = (GLuint)vertexTotal;
+		placements[drawn].firstIndex = (GLuint)indexTotal;
+		vertexTotal += vertices;
+		indexTotal += indices;
+		drawn++;
+	}
+	RingBuffer::Allocation vertexBlock = ring->allocate((GLsizeiptr)(vertexTotal * sizeof(Vertex)));
+	RingBuffer::Allocation indexBlock = ring->allocate((GLsizeiptr)(indexTotal * sizeof(GLuint)));
+	indexCount = 0;
+	if (!vertexBlock.data || !indexBlock.data)
+		return;
+
+	// every patch copies into its own range, indices rebased onto the patch's first vertex
+	Vertex *vertexOut = static_cast<Vertex*>(vertexBlock.data);
+	GLuint *indexOut = static_cast<GLuint*>(indexBlock.data);
+	JobSystem::instance().parallelFor(0, (int)drawn, 64, [&](int first, int last)
+	{
+		for (int p = first; p < last; p++)
+		{
+			const Patch &patch = patches[p];
+			const Placement &placement = placements[p];
+			if (!patch.vertices.empty())
+				std::memcpy(vertexOut + placement.firstVertex, patch.vertices.data(), patch.vertices.size() * sizeof(Vertex));
+			const std::vector<uint32_t> &indices = patch.pattern->indices;
+			GLuint *out = indexOut + placement.firstIndex;
+			for (size_t i = 0; i < indices.size(); i++)
+				out[i] = placement.firstVertex + indices[i];
+		}
+	});
+	glVertexArrayVertexBuffer(VAO, 0, ring->getBuffer(), vertexBlock.offset, sizeof(Vertex));
+	indexOffset = indexBlock.offset;
+	indexCount = (GLsizei)indexTotal;
+
+	stats.patches = drawn;
+	stats.evaluated = evaluated.load();
+	stats.triangles = indexTotal / 3;
+	stats.vertices = vertexTotal;
+}
+
+void CpuTessellatedTerrain::draw() const
+{
+	if (indexCount == 0)
+		return;
+	RenderState::get().bindVertexArray(VAO);
+	glDrawElements(GL_TRIANGLES, indexCount, GL_UNSIGNED_INT, (const void*)indexOffset);
+}
+
+void CpuTessellatedTerrain::release()
+{
+	if (VAO)
+	{
+		RenderState::get().forgetVertexArray(VAO);
+		glDeleteVertexArrays(1, &VAO);
+		VAO = 0;
+	}
+	ring.reset();
+	tessellator.reset();
+	patches.clear();
+	field = nullptr;
+	frameOpen = false;
+	indexCount = 0;
+	stats = Stats();
+}
@@ -0,0 +1,95 @@
+#pragma once
+#ifndef CPUTESSELLATEDTERRAIN_H
+#define CPUTESSELLATEDTERRAIN_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <memory>
+#include <vector>
+
+#include "CpuTessellator.h"
+#include "HeightField.h"
+#include "RingBuffer.h"
+
+// The tessellated terrain without the tessellation stages, for software rasterizers and drivers that run
+// them slowly. Every frame the patch levels are computed like tessControlShader.tcs, patches whose levels
+// changed are re-tessellated and displaced like tessEvaluationShader.tes on the job system, and the whole
+// mesh is copied into a persistently mapped ring buffer and drawn as plain triangles.
+// The evaluated vertices of a patch stay cached until its levels change, the domain patterns are shared.
+//
+// Draw with Shaders/terrainCpuVert.vs: attribute 0 position, 1 normal, 2 texture coordinates.
+class CpuTessellatedTerrain
+{
+public:
+	struct Stats
+	{
+		size_t patches;                 // drawn this frame
+		size_t evaluated;               // of those, re-tessellated this frame
+		size_t triangles;
+		size_t vertices;
+		bool overflow;                  // the ring region was too small, the remaining patches were skipped
+	};
+
+	CpuTessellatedTerrain();
+	~CpuTessellatedTerrain();
+	CpuTessellatedTerrain(const CpuTessellatedTerrain&) = delete;
+	CpuTessellatedTerrain& operator=(const CpuTessellatedTerrain&) = delete;
+
+	// patchVertices: x y z u v per vertex, three vertices per patch (Terrain::getVertexData);
+	// heights come from the field, which must match the heightMap texture the GPU path samples.
+	// frameBytes is the ring region per frame, vertices and indices together
+	bool build(const std::vector<float> &patchVertices, const HeightField &field, GLsizeiptr frameBytes = 48 * 1024 * 1024);
+	// levels and re-tessellation for this camera, then streams the mesh; once per frame before draw
+	void update(const glm::vec3 &camPos);
+	// draws what the last update streamed, may be called several times per frame (depth pre-pass)
+	void draw() const;
+	void release();
+
+	// tessControlShader.tcs GetTessLevel before tessScale, keep the two in sync
+	static float tessLevel(float distance0, float distance1);
+	// tessScale of the control shader
+	void setLevelScale(float scale) { levelScale = scale; }
+
+	bool empty() const { return patches.empty(); }
+	const Stats &getStats() const { return stats; }
+	size_t getPatternCount() const { return tessellator ? tessellator->getPatternCount() : 0; }
+
+private:
+	struct Vertex
+	{
+		glm::vec3 position;
+		glm::vec3 normal;
+		glm::vec2 uv;
+	};
+
+	struct Patch
+	{
+		glm::vec3 position[3];
+		glm::vec2 uv[3];
+		TessLevels levels;              // what vertices were evaluated for, outer[0] < 0 before the first update
+		std::shared_ptr<const TessPattern> pattern;
+		std::vector<Vertex> vertices;
+	};
+	// where a patch goes in this frame's region, in the frame arena
+	struct Placement
+	{
+		GLuint firstVertex;
+		GLuint firstIndex;
+	};
+
+	std::vector<Patch> patches;
+	const HeightField *field;
+	std::unique_ptr<CpuTessellator> tessellator;
+	std::unique_ptr<RingBuffer> ring;
+	GLuint VAO;
+	float levelScale;
+	bool frameOpen;
+	GLintptr indexOffset;               // this frame's index data in the ring
+	GLsizei indexCount;
+	Stats stats;
+
+	void evaluate(Patch &patch) const;
+};
+
+#endif
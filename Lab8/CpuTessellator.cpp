@@ -0,0 +1,370 @@
+#include "CpuTessellator.h"
+
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
+namespace
+{
+	// an inner level of one next to outer levels above one is treated as 1 + epsilon
+	const float ONE_PLUS_EPSILON = 1.0f + 1.0e-3f;
+	// fractional levels are keyed with this resolution
+	const float KEY_STEPS = 256.0f;
+
+	// one side of a ring: point indices from its start corner to its end corner
+	struct Edge
+	{
+		std::vector<uint32_t> index;
+		std::vector<float> t;           // position of each point along the side, 0..1
+	};
+
+	float clampLevel(TessSpacing spacing, int maxLevel, float level)
+	{
+		switch (spacing)
+		{
+		case TessSpacing::FractionalOdd:
+			return std::min(std::max(level, 1.0f), (float)(maxLevel - 1));
+		case TessSpacing::FractionalEven:
+			return std::min(std::max(level, 2.0f), (float)maxLevel);
+		default:
+			return std::min(std::max(level, 1.0f), (float)maxLevel);
+		}
+	}
+
+	uint32_t addPoint(TessPattern &out, const glm::vec3 &point)
+	{
+		out.coords.push_back(point);
+		return (uint32_t)out.coords.size() - 1;
+	}
+
+	void addTriangle(TessPattern &out, uint32_t a, uint32_t b, uint32_t c)
+	{
+		out.indices.push_back(a);
+		out.indices.push_back(b);
+		out.indices.push_back(c);
+	}
+
+	// side from corner a to corner b through new points at t; a single t when both corners are the same point
+	void makeEdge(TessPattern &out, uint32_t a, uint32_t b, const std::vector<float> &t, Edge &edge)
+	{
+		// copies, addPoint may reallocate
+		const glm::vec3 from = out.coords[a];
+		const glm::vec3 to = out.coords[b];
+		edge.t = t;
+		edge.index.resize(t.size());
+		edge.index[0] = a;
+		for (size_t i = 1; i + 1 < t.size(); i++)
+			edge.index[i] = addPoint(out, from + (to - from) * t[i]);
+		if (t.size() > 1)
+			edge.index.back() = b;
+	}
+
+	Edge reversed(const Edge &edge)
+	{
+		Edge result;
+		result.index.assign(edge.index.rbegin(), edge.index.rend());
+		for (std::vector<float>::const_reverse_iterator t = edge.t.rbegin(); t != edge.t.rend(); ++t)
+			result.t.push_back(1.0f - *t);
+		return result;
+	}
+
+	// fills the band between a ring side and the parallel side of the next ring inside it, always advancing
+	// along the side that is behind; every segment of both sides gets one triangle
+	void stitch(TessPattern &out, const Edge &outer, const Edge &inner)
+	{
+		const size_t outerLast = outer.index.size() - 1;
+		const size_t innerLast = inner.index.size() - 1;
+		size_t i = 0, j = 0;
+		while (i < outerLast || j < innerLast)
+		{
+			bool advanceOuter = j == innerLast ||
+				(i < outerLast && outer.t[i] + outer.t[i + 1] <= inner.t[j] + inner.t[j + 1]);
+			if (advanceOuter)
+			{
+				addTriangle(out, outer.index[i], outer.index[i + 1], inner.index[j]);
+				i++;
+			}
+			else
+			{
+				addTriangle(out, outer.index[i], inner.index[j + 1], inner.index[j]);
+				j++;
+			}
+		}
+	}
+
+	// positions along the sides of inner ring k, relative to the ring's own corners
+	void ringPositions(const std::vector<float> &p, int k, std::vector<float> &t)
+	{
+		const int n = (int)p.size() - 1;
+		const int m = n - 2 * k;
+		t.resize(m + 1);
+		t[0] = 0.0f;
+		for (int j = 1; j <= m; j++)
+			t[j] = (p[k + j] - p[k]) / (p[n - k] - p[k]);
+	}
+
+	void generateTriangles(TessSpacing spacing, int maxLevel, const TessLevels &levels, TessPattern &out)
+	{
+		const glm::vec3 corner[3] = { glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f) };
+		// side e runs from corner e to corner e + 1, along the domain edge where the third coordinate is 0:
+		// u->v is w = 0 (outer 2), v->w is u = 0 (outer 0), w->u is v = 0 (outer 1)
+		const int outerOf[3] = { 2, 0, 1 };
+
+		bool outerAboveOne = false;
+		for (int e = 0; e < 3; e++)
+			outerAboveOne |= clampLevel(spacing, maxLevel, levels.outer[e]) > 1.0f;
+		float inner = levels.inner[0];
+		uint32_t c[3];
+		if (clampLevel(spacing, maxLevel, inner) <= 1.0f)
+		{
+			if (!outerAboveOne)
+			{
+				for (int i = 0; i < 3; i++)
+					c[i] = addPoint(out, corner[i]);
+				addTriangle(out, c[0], c[1], c[2]);
+				return;
+			}
+			inner = ONE_PLUS_EPSILON;
+		}
+
+		std::vector<float> p, t;
+		CpuTessellator::edgePositions(spacing, maxLevel, inner, p);
+		const int n = (int)p.size() - 1;
+
+		Edge outerEdges[3], innerEdges[3];
+		for (int i = 0; i < 3; i++)
+			c[i] = addPoint(out, corner[i]);
+		for (int e = 0; e < 3; e++)
+		{
+			CpuTessellator::edgePositions(spacing, maxLevel, levels.outer[outerOf[e]], t);
+			makeEdge(out, c[e], c[(e + 1) % 3], t, outerEdges[e]);
+		}
+
+		// concentric triangles with n - 2k segments per side, down to a single triangle or the centre point
+		const glm::vec3 centre(1.0f / 3.0f);
+		for (int k = 1; ; k++)
+		{
+			const int m = n - 2 * k;
+			const float scale = p[n - k] - p[k];
+			for (int i = 0; i < 3; i++)
+				c[i] = (m == 0 && i > 0) ? c[0] : addPoint(out, m == 0 ? centre : centre + (corner[i] - centre) * scale);
+			ringPositions(p, k, t);
+			for (int e = 0; e < 3; e++)
+			{
+				makeEdge(out, c[e], c[(e + 1) % 3], t, innerEdges[e]);
+				stitch(out, outerEdges[e], innerEdges[e]);
+			}
+			if (m <= 1)
+			{
+				if (m == 1)
+					addTriangle(out, c[0], c[1], c[2]);
+				break;
+			}
+			for (int e = 0; e < 3; e++)
+				std::swap(outerEdges[e], innerEdges[e]);
+		}
+	}
+
+	void generateQuads(TessSpacing spacing, int maxLevel, const TessLevels &levels, TessPattern &out)
+	{
+		const glm::vec3 corner[4] = { glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(1.0f, 0.0f, 0.0f),
+			glm::vec3(1.0f, 1.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f) };
+		// side e runs from corner e to corner e + 1: v = 0 (outer 1), u = 1 (outer 2), v = 1 (outer 3), u = 0 (outer 0)
+		const int outerOf[4] = { 1, 2, 3, 0 };
+
+		bool outerAboveOne = false;
+		for (int e = 0; e < 4; e++)
+			outerAboveOne |= clampLevel(spacing, maxLevel, levels.outer[e]) > 1.0f;
+		float inner[2] = { levels.inner[0], levels.inner[1] };
+		bool innerOne[2];
+		for (int i = 0; i < 2; i++)
+			innerOne[i] = clampLevel(spacing, maxLevel, inner[i]) <= 1.0f;
+		uint32_t c[4];
+		if (innerOne[0] && innerOne[1] && !outerAboveOne)
+		{
+			for (int i = 0; i < 4; i++)
+				c[i] = addPoint(out, corner[i]);
+			addTriangle(out, c[0], c[1], c[2]);
+			addTriangle(out, c[0], c[2], c[3]);
+			return;
+		}
+		for (int i = 0; i < 2; i++)
+			if (innerOne[i])
+				inner[i] = ONE_PLUS_EPSILON;
+
+		std::vector<float> pu, pv, tu, tv, t;
+		CpuTessellator::edgePositions(spacing, maxLevel, inner[0], pu);
+		CpuTessellator::edgePositions(spacing, maxLevel, inner[1], pv);
+		const int n0 = (int)pu.size() - 1;
+		const int n1 = (int)pv.size() - 1;
+
+		Edge outerEdges[4], innerEdges[4];
+		for (int i = 0; i < 4; i++)
+			c[i] = addPoint(out, corner[i]);
+		for (int e = 0; e < 4; e++)
+		{
+			CpuTessellator::edgePositions(spacing, maxLevel, levels.outer[outerOf[e]], t);
+			makeEdge(out, c[e], c[(e + 1) % 4], t, outerEdges[e]);
+		}
+
+		// concentric rectangles with (n0 - 2k) x (n1 - 2k) segments; once a direction has no segments left
+		// the ring collapses to a line or a point and shares the coinciding corners
+		for (int k = 1; ; k++)
+		{
+			const int m0 = n0 - 2 * k;
+			const int m1 = n1 - 2 * k;
+			const float u0 = pu[k], u1 = pu[n0 - k];
+			const float v0 = pv[k], v1 = pv[n1 - k];
+			c[0] = addPoint(out, glm::vec3(u0, v0, 0.0f));
+			c[1] = m0 > 0 ? addPoint(out, glm::vec3(u1, v0, 0.0f)) : c[0];
+			c[3] = m1 > 0 ? addPoint(out, glm::vec3(u0, v1, 0.0f)) : c[0];
+			c[2] = m0 > 0 && m1 > 0 ? addPoint(out, glm::vec3(u1, v1, 0.0f)) : (m0 > 0 ? c[1] : c[3]);
+			ringPositions(pu, k, tu);
+			ringPositions(pv, k, tv);
+			for (int e = 0; e < 4; e++)
+			{
+				// a collapsed ring's far side is its near side walked backwards, same points
+				if (e >= 2 && (e % 2 ? m0 : m1) == 0)
+					innerEdges[e] = reversed(innerEdges[e - 2]);
+				else
+					makeEdge(out, c[e], c[(e + 1) % 4], e % 2 ? tv : tu, innerEdges[e]);
+				stitch(out, outerEdges[e], innerEdges[e]);
+			}
+			if (m0 <= 1 || m1 <= 1)
+			{
+				// a strip one segment wide is left: zip its two long sides
+				if (m0 >= 1 && m1 >= 1)
+				{
+					if (m1 == 1)
+						stitch(out, innerEdges[0], reversed(innerEdges[2]));
+					else
+						stitch(out, innerEdges[1], reversed(innerEdges[3]));
+				}
+				break;
+			}
+			for (int e = 0; e < 4; e++)
+				std::swap(outerEdges[e], innerEdges[e]);
+		}
+	}
+}
+
+CpuTessellator::CpuTessellator(TessDomain domainIn, TessSpacing spacingIn, int maxLevelIn)
+{
+	domain = domainIn;
+	spacing = spacingIn;
+	maxLevel = std::max(maxLevelIn, 2);
+}
+
+int CpuTessellator::segmentCount(TessSpacing spacing, int maxLevel, float level)
+{
+	const int n = (int)std::ceil(clampLevel(spacing, maxLevel, level));
+	switch (spacing)
+	{
+	case TessSpacing::FractionalOdd:
+		return n % 2 ? n : n + 1;
+	case TessSpacing::FractionalEven:
+		return n % 2 ? n + 1 : n;
+	default:
+		return n;
+	}
+}
+
+void CpuTessellator::edgePositions(TessSpacing spacing, int maxLevel, float level, std::vector<float> &out)
+{
+	const int n = segmentCount(spacing, maxLevel, level);
+	out.resize(n + 1);
+	out[0] = 0.0f;
+	const float f = clampLevel(spacing, maxLevel, level);
+	if (spacing == TessSpacing::Equal || n < 2 || (float)n == f)
+	{
+		for (int i = 1; i < n; i++)
+			out[i] = (float)i / n;
+		out[n] = 1.0f;
+		return;
+	}
+	// fractional: n - 2 segments of length one and two shorter ones of equal length, placed symmetrically
+	// next to the middle; their length grows with the fraction until the next level splits them
+	const float shortLength = (f - (n - 2)) * 0.5f;
+	const int shortA = n % 2 ? (n - 1) / 2 - 1 : n / 2 - 1;
+	const int shortB = n - 1 - shortA;
+	float x = 0.0f;
+	for (int i = 0; i < n - 1; i++)
+	{
+		x += (i == shortA || i == shortB) ? shortLength : 1.0f;
+		out[i + 1] = x / f;
+	}
+	out[n] = 1.0f;
+}
+
+void CpuTessellator::generate(TessDomain domain, TessSpacing spacing, int maxLevel, const TessLevels &levels, TessPattern &out)
+{
+	out.coords.clear();
+	out.indices.clear();
+	// an outer level of zero or NaN discards the patch
+	const int outerCount = domain == TessDomain::Triangles ? 3 : 4;
+	for (int e = 0; e < outerCount; e++)
+		if (!(levels.outer[e] > 0.0f))
+			return;
+	if (domain == TessDomain::Triangles)
+		generateTriangles(spacing, maxLevel, levels, out);
+	else
+		generateQuads(spacing, maxLevel, levels, out);
+}
+
+CpuTessellator::Key CpuTessellator::makeKey(const TessLevels &levels) const
+{
+	Key key = {};
+	const int outerCount = domain == TessDomain::Triangles ? 3 : 4;
+	const int innerCount = domain == TessDomain::Triangles ? 1 : 2;
+	for (int i = 0; i < outerCount + innerCount; i++)
+	{
+		float level = i < outerCount ? levels.outer[i] : levels.inner[i - outerCount];
+		if (i < outerCount && !(level > 0.0f))
+		{
+			key.fill(-1);
+			return key;
+		}
+		// with equal spacing only the segment count matters
+		if (spacing == TessSpacing::Equal)
+			key[i] = segmentCount(spacing, maxLevel, level);
+		else
+			key[i] = (int)std::lround(clampLevel(spacing, maxLevel, level) * KEY_STEPS);
+	}
+	return key;
+}
+
+size_t CpuTessellator::KeyHash::operator()(const Key &key) const
+{
+	size_t hash = 0;
+	for (int value : key)
+		hash = hash * 31 + (size_t)value;
+	return hash;
+}
+
+std::shared_ptr<const TessPattern> CpuTessellator::getPattern(const TessLevels &levels)
+{
+	const Key key = makeKey(levels);
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		auto found = patterns.find(key);
+		if (found != patterns.end())
+			return found->second;
+	}
+	// built outside the lock; when two threads race for the same levels the first one to insert wins
+	std::shared_ptr<TessPattern> pattern = std::make_shared<TessPattern>();
+	generate(domain, spacing, maxLevel, levels, *pattern);
+	std::lock_guard<std::mutex> lock(mutex);
+	return patterns.emplace(key, pattern).first->second;
+}
+
+size_t CpuTessellator::getPatternCount() const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return patterns.size();
+}
+
+void CpuTessellator::clear()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	patterns.clear();
+}
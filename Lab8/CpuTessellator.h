@@ -0,0 +1,82 @@
+#pragma once
+#ifndef CPUTESSELLATOR_H
+#define CPUTESSELLATOR_H
+
+#include <glm/glm.hpp>
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+// layout(triangles) / layout(quads) of the evaluation shader
+enum class TessDomain { Triangles, Quads };
+// equal_spacing, fractional_even_spacing, fractional_odd_spacing
+enum class TessSpacing { Equal, FractionalEven, FractionalOdd };
+
+// gl_TessLevelOuter / gl_TessLevelInner as the control shader writes them.
+// Triangles use outer[0..2] and inner[0], quads all of them
+struct TessLevels
+{
+	float outer[4];
+	float inner[2];
+};
+
+// What the primitive generator emits for one set of levels: the domain points and the triangles over them.
+// The points are gl_TessCoord, barycentric (u, v, w) for triangles and (u, v, 0) for quads.
+// Triangles are wound like the patch corners (ccw in the evaluation shader's layout)
+struct TessPattern
+{
+	std::vector<glm::vec3> coords;
+	std::vector<uint32_t> indices;
+	size_t triangleCount() const { return indices.size() / 3; }
+};
+
+// The fixed-function tessellator on the CPU, for drivers where the tessellation stages are slow or missing.
+// Levels are clamped and rounded the way the GL spec describes for each spacing, edge i of the domain uses
+// outer level i with the spec's edge numbering, and the inner levels make concentric rings stitched to the
+// outer edges. Points on the outer edges are exactly where the GPU puts them, so CPU and GPU patches can be
+// mixed without cracks; the triangulation between rings is implementation-defined, but the triangle count
+// matches the GPU's (GL_PRIMITIVES_GENERATED).
+//
+// The output depends only on the levels, so patterns are built once and shared. getPattern is thread-safe.
+class CpuTessellator
+{
+public:
+	// maxLevel is GL_MAX_TESS_GEN_LEVEL of the GPU path being mirrored
+	CpuTessellator(TessDomain domain, TessSpacing spacing, int maxLevel = 64);
+
+	std::shared_ptr<const TessPattern> getPattern(const TessLevels &levels);
+	// builds a pattern without the cache
+	static void generate(TessDomain domain, TessSpacing spacing, int maxLevel, const TessLevels &levels, TessPattern &out);
+	// segment end points along an edge with this level, in [0, 1]; symmetric, so the direction does not matter
+	static void edgePositions(TessSpacing spacing, int maxLevel, float level, std::vector<float> &out);
+	// number of segments the level turns into after clamping and rounding
+	static int segmentCount(TessSpacing spacing, int maxLevel, float level);
+
+	TessDomain getDomain() const { return domain; }
+	TessSpacing getSpacing() const { return spacing; }
+	int getMaxLevel() const { return maxLevel; }
+	size_t getPatternCount() const;
+	void clear();
+
+private:
+	typedef std::array<int, 6> Key;
+	struct KeyHash
+	{
+		size_t operator()(const Key &key) const;
+	};
+
+	TessDomain domain;
+	TessSpacing spacing;
+	int maxLevel;
+	mutable std::mutex mutex;
+	std::unordered_map<Key, std::shared_ptr<const TessPattern>, KeyHash> patterns;
+
+	// levels that produce the same pattern get the same key
+	Key makeKey(const TessLevels &levels) const;
+};
+
+#endif
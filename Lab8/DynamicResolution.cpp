@@ -0,0 +1,69 @@
+#include "DynamicResolution.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+	const float DAMPING = 0.25f;
+	const int SIZE_STEP = 8;
+}
+
+DynamicResolution::DynamicResolution(int maxWidthIn, int maxHeightIn)
+	: control(DAMPING, 0.5f, 1.0f)
+{
+	maxWidth = maxWidthIn;
+	maxHeight = maxHeightIn;
+	enabled = false;
+	timeBudget = 8.0;
+	reset();
+}
+
+void DynamicResolution::setEnabled(bool enabledIn)
+{
+	enabled = enabledIn;
+	reset();
+}
+
+void DynamicResolution::setLimits(float minScaleIn, float maxScaleIn)
+{
+	// above 1 there is nothing to render into
+	float maxScale = std::min(std::max(maxScaleIn, 0.1f), 1.0f);
+	control.setLimits(std::min(std::max(minScaleIn, 0.1f), maxScale), maxScale);
+}
+
+void DynamicResolution::reset()
+{
+	control.reset(control.getMaxScale());
+	smoothedTime.reset();
+}
+
+float DynamicResolution::addSample(double gpuMilliseconds)
+{
+	smoothedTime.add(gpuMilliseconds);
+	if (!enabled)
+		return getScale();
+	// the pixel count, and with it most of the frame, goes with the square of the scale
+	return control.update(smoothedTime.get(), timeBudget);
+}
+
+int DynamicResolution::scaled(int size) const
+{
+	int pixels = (int)std::lround(size * getScale() / SIZE_STEP) * SIZE_STEP;
+	return std::min(std::max(pixels, SIZE_STEP), size);
+}
+
+int DynamicResolution::getWidth() const
+{
+	return scaled(maxWidth);
+}
+
+int DynamicResolution::getHeight() const
+{
+	return scaled(maxHeight);
+}
+
+glm::vec2 DynamicResolution::getUvScale() const
+{
+	return glm::vec2((float)getWidth() / maxWidth, (float)getHeight() / maxHeight);
+}
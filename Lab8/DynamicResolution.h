@@ -0,0 +1,49 @@
+#pragma once
+#ifndef DYNAMICRESOLUTION_H
+#define DYNAMICRESOLUTION_H
+
+#include <glm/glm.hpp>
+
+#include "BudgetController.h"
+
+// Picks the resolution the scene is rendered at from the measured GPU frame time.
+// The scene target keeps its full size; only the viewport inside it shrinks, so a new resolution never
+// reallocates anything, and the upscale pass samples the rendered corner (getUvScale).
+// Like the tessellation controller it works on query results a few frames old, through a BudgetController.
+// Sizes are multiples of 8 pixels, which also keeps the resolution from changing on every frame.
+class DynamicResolution
+{
+public:
+	DynamicResolution(int maxWidth, int maxHeight);
+
+	void setEnabled(bool enabledIn);
+	void setTimeBudget(double milliseconds) { timeBudget = milliseconds; }
+	// fraction of the full size per axis
+	void setLimits(float minScaleIn, float maxScaleIn);
+
+	// one GPU frame time measurement; returns the scale to render at from now on
+	float addSample(double gpuMilliseconds);
+	void reset();
+
+	bool isEnabled() const { return enabled; }
+	float getScale() const { return enabled ? control.getScale() : 1.0f; }
+	int getWidth() const;
+	int getHeight() const;
+	// rendered size over the full target size, for texture coordinates into the scene target
+	glm::vec2 getUvScale() const;
+	int getMaxWidth() const { return maxWidth; }
+	int getMaxHeight() const { return maxHeight; }
+	double getTimeBudget() const { return timeBudget; }
+	double getSmoothedTime() const { return smoothedTime.get(); }
+
+private:
+	int maxWidth, maxHeight;
+	bool enabled;
+	BudgetController control;
+	double timeBudget;
+	SmoothedValue smoothedTime;
+
+	int scaled(int size) const;
+};
+
+#endif
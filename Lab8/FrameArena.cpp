@@ -0,0 +1,137 @@
+#include "FrameArena.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+LinearArena::LinearArena(size_t capacityIn)
+{
+	capacity = capacityIn;
+	base = static_cast<unsigned char*>(std::malloc(capacity));
+	offset = 0;
+	used = 0;
+	peak = 0;
+	overflowCount = 0;
+	overflow = nullptr;
+}
+
+LinearArena::~LinearArena()
+{
+	reset();
+	std::free(base);
+}
+
+void *LinearArena::allocate(size_t size, size_t alignment)
+{
+	// padding from the address itself: the blocks come from malloc, which only aligns to max_align_t
+	if (base)
+	{
+		size_t padding = (size_t)(0 - (uintptr_t)(base + offset)) & (alignment - 1);
+		if (offset + padding + size <= capacity)
+		{
+			used += padding + size;
+			offset += padding + size;
+			return base + offset - size;
+		}
+	}
+
+	// does not fit: a separate block until the next reset, which grows the arena
+	unsigned char *block = static_cast<unsigned char*>(std::malloc(sizeof(Overflow) + alignment - 1 + size));
+	if (!block)
+		throw std::bad_alloc();
+	Overflow *node = reinterpret_cast<Overflow*>(block);
+	node->next = overflow;
+	overflow = node;
+	overflowCount++;
+	unsigned char *first = block + sizeof(Overflow);
+	size_t padding = (size_t)(0 - (uintptr_t)first) & (alignment - 1);
+	used += padding + size;
+	return first + padding;
+}
+
+void LinearArena::reset()
+{
+	peak = std::max(peak, used);
+	while (overflow)
+	{
+		Overflow *next = overflow->next;
+		std::free(overflow);
+		overflow = next;
+	}
+	if (overflowCount > 0)
+	{
+		// grow to the peak plus some headroom, so the same load fits next time
+		capacity = peak + peak / 4;
+		std::free(base);
+		base = static_cast<unsigned char*>(std::malloc(capacity));
+	}
+	overflowCount = 0;
+	offset = 0;
+	used = 0;
+}
+
+FrameArena::FrameArena(size_t capacity) : arenas{ { capacity }, { capacity } }
+{
+	frame = 0;
+}
+
+void FrameArena::nextFrame()
+{
+	frame++;
+	current().reset();
+}
+
+FrameArena &FrameArena::get()
+{
+	static FrameArena arena;
+	return arena;
+}
+
+#ifdef _DEBUG
+// counts every global heap allocation, so the frame loop can check it does not allocate
+static std::atomic<size_t> allocationCount(0);
+
+size_t heapAllocationCount()
+{
+	return allocationCount.load(std::memory_order_relaxed);
+}
+
+void *operator new(size_t size)
+{
+	allocationCount.fetch_add(1, std::memory_order_relaxed);
+	if (void *p = std::malloc(size ? size : 1))
+		return p;
+	throw std::bad_alloc();
+}
+
+void *operator new[](size_t size)
+{
+	return operator new(size);
+}
+
+void operator delete(void *p) noexcept
+{
+	std::free(p);
+}
+
+void operator delete[](void *p) noexcept
+{
+	std::free(p);
+}
+
+void operator delete(void *p, size_t) noexcept
+{
+	std::free(p);
+}
+
+void operator delete[](void *p, size_t) noexcept
+{
+	std::free(p);
+}
+#else
+size_t heapAllocationCount()
+{
+	return 0;
+}
+#endif
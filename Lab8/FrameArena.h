@@ -0,0 +1,97 @@
+#pragma once
+#ifndef FRAMEARENA_H
+#define FRAMEARENA_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Bump allocator: allocation is a pointer increment, nothing is freed individually, reset() drops everything.
+// When a frame needs more than the block, the extra goes to overflow blocks and the next reset() grows the
+// main block to the peak, so a steady-state frame ends up with no heap traffic at all.
+class LinearArena
+{
+public:
+	LinearArena(size_t capacity = 64u << 10);
+	~LinearArena();
+	LinearArena(const LinearArena&) = delete;
+	LinearArena& operator=(const LinearArena&) = delete;
+
+	// alignment is a power of two, larger than alignof(std::max_align_t) too
+	void *allocate(size_t size, size_t alignment = alignof(std::max_align_t));
+	void reset();
+
+	size_t getCapacity() const { return capacity; }
+	size_t getUsed() const { return used; }
+	size_t getPeak() const { return peak; }
+	size_t getOverflowCount() const { return overflowCount; }
+
+private:
+	struct Overflow
+	{
+		Overflow *next;
+	};
+
+	unsigned char *base;
+	size_t capacity;
+	size_t offset;
+	size_t used;            // bytes handed out this cycle, overflow included
+	size_t peak;
+	size_t overflowCount;   // overflow blocks since the last reset
+	Overflow *overflow;
+};
+
+// Two arenas used on alternate frames: memory allocated during frame N stays valid through frame N + 1,
+// so results can be handed to the next frame without copying. Render thread only.
+class FrameArena
+{
+public:
+	explicit FrameArena(size_t capacity = 64u << 10);
+
+	// call once per frame, after the buffer swap; recycles the arena of two frames ago
+	void nextFrame();
+	LinearArena &current() { return arenas[frame & 1]; }
+	LinearArena &previous() { return arenas[(frame + 1) & 1]; }
+	uint64_t getFrameIndex() const { return frame; }
+
+	// arena for the frame being recorded
+	static FrameArena &get();
+
+private:
+	LinearArena arenas[2];
+	uint64_t frame;
+};
+
+// STL adapter, deallocate is a no-op: the arena frees everything at once
+template<typename T>
+class ArenaAllocator
+{
+public:
+	typedef T value_type;
+
+	ArenaAllocator() : arena(&FrameArena::get().current()) {}
+	explicit ArenaAllocator(LinearArena &arenaIn) : arena(&arenaIn) {}
+	template<typename U>
+	ArenaAllocator(const ArenaAllocator<U> &other) : arena(other.arena) {}
+
+	T *allocate(size_t n) { return static_cast<T*>(arena->allocate(n * sizeof(T), alignof(T))); }
+	void deallocate(T*, size_t) {}
+
+	template<typename U>
+	bool operator==(const ArenaAllocator<U> &other) const { return arena == other.arena; }
+	template<typename U>
+	bool operator!=(const ArenaAllocator<U> &other) const { return arena != other.arena; }
+
+	LinearArena *arena;
+};
+
+// transient containers: default-constructed ones allocate from the current frame and must not outlive the next frame
+typedef std::basic_string<char, std::char_traits<char>, ArenaAllocator<char> > FrameString;
+template<typename T>
+using FrameVector = std::vector<T, ArenaAllocator<T> >;
+
+// number of global operator new calls so far; only counted in _DEBUG builds, 0 otherwise
+size_t heapAllocationCount();
+
+#endif
@@ -0,0 +1,40 @@
+#pragma once
+#ifndef FRAMEUNIFORMS_H
+#define FRAMEUNIFORMS_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+// FrameBlock of Shaders/frameBlock.glsl in std140 layout: vec3 members are padded to 16 bytes, which the
+// vec4s of the light and the scalars packed after the vec3s take care of.
+// Written once a frame into a RingBuffer and bound at FRAME_BINDING, every terrain, shadow and deferred
+// program reads it from there instead of taking the same uniforms one by one.
+struct FrameUniforms
+{
+	static const GLuint FRAME_BINDING = 0;
+
+	glm::mat4 view;
+	glm::mat4 projection;
+	glm::mat4 inverseViewProjection;
+	glm::mat4 lightSpaceMatrix;
+	glm::vec3 camPos;
+	float tessScale;
+	glm::vec3 sky;
+	GLint scale;
+	// DirLight, xyz used
+	glm::vec4 dirLightDirection;
+	glm::vec4 dirLightAmbient;
+	glm::vec4 dirLightDiffuse;
+	glm::vec4 dirLightSpecular;
+	glm::vec2 clusterTileScale;
+	glm::vec2 renderSize;
+	glm::vec3 clusterSlices;
+	GLint pointLightCount;
+	GLint shadowMode;
+	GLint showShadow;
+	GLint padding[2];
+};
+
+static_assert(sizeof(FrameUniforms) == 400, "FrameUniforms has to match the std140 layout of FrameBlock");
+
+#endif
@@ -0,0 +1,31 @@
+#pragma once
+#ifndef FRUSTUM_H
+#define FRUSTUM_H
+
+#include <glm/glm.hpp>
+
+// The six clip planes of a view-projection matrix, for culling bounding volumes on the CPU.
+// Works for perspective and orthographic projections alike, so it serves the camera and the shadow light.
+class Frustum
+{
+public:
+	// prefixed, windows.h defines NEAR and FAR
+	enum Plane { PLANE_LEFT, PLANE_RIGHT, PLANE_BOTTOM, PLANE_TOP, PLANE_NEAR, PLANE_FAR, PLANE_COUNT };
+
+	Frustum();
+	explicit Frustum(const glm::mat4 &viewProjection);
+
+	void update(const glm::mat4 &viewProjection);
+
+	// conservative: false only when the box is completely outside one plane
+	bool intersects(const glm::vec3 &boxMin, const glm::vec3 &boxMax) const;
+	bool intersects(const glm::vec3 &centre, float radius) const;
+
+	// plane as (normal, distance); a point p is inside when dot(normal, p) + distance >= 0
+	const glm::vec4 &getPlane(int plane) const { return planes[plane]; }
+
+private:
+	glm::vec4 planes[PLANE_COUNT];
+};
+
+#endif
@@ -0,0 +1,364 @@
+#include "HeightField.h"
+#include "stb_image.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+
+HeightField::HeightField()
+{
+	width = 0;
+	height = 0;
+	worldSize = glm::vec2(0.0f);
+	texel = glm::vec2(0.0f);
+}
+
+void HeightField::build(const unsigned char *pixels, int w, int h, int channels, float heightScale, glm::vec2 worldSizeIn)
+{
+	std::vector<float> values((size_t)w * h);
+	for (size_t i = 0; i < values.size(); i++)
+		values[i] = pixels[i * channels] / 255.0f * heightScale;
+	build(values.data(), w, h, worldSizeIn);
+}
+
+void HeightField::build(const float *heightsIn, int w, int h, glm::vec2 worldSizeIn)
+{
+	width = w;
+	height = h;
+	worldSize = worldSizeIn;
+	texel = worldSize / glm::vec2((float)w, (float)h);
+	heights.assign(heightsIn, heightsIn + (size_t)w * h);
+	buildPyramid();
+}
+
+bool HeightField::loadFromFile(const char *path, float heightScale, glm::vec2 worldSizeIn)
+{
+	int w, h, nrComponents;
+	unsigned char *data = stbi_load(path, &w, &h, &nrComponents, 0);
+	if (!data || w < 2 || h < 2)
+	{
+		std::cout << "Height field failed to load at path: " << path << std::endl;
+		stbi_image_free(data);
+		return false;
+	}
+	build(data, w, h, nrComponents, heightScale, worldSizeIn);
+	stbi_image_free(data);
+	std::cout << "Loaded height field at path: " << path << " " << w << "x" << h << " levels " << pyramid.size() << std::endl;
+	return true;
+}
+
+bool HeightField::empty() const
+{
+	return heights.empty();
+}
+
+float HeightField::sample(int i, int j) const
+{
+	// GL_REPEAT
+	i %= width;
+	j %= height;
+	if (i < 0) i += width;
+	if (j < 0) j += height;
+	return heights[(size_t)j * width + i];
+}
+
+float HeightField::getHeight(float x, float z) const
+{
+	if (heights.empty())
+		return 0.0f;
+	// same texel space as GL_LINEAR: u * size - 0.5
+	float s = x / texel.x - 0.5f;
+	float r = z / texel.y - 0.5f;
+	float fs = std::floor(s);
+	float fr = std::floor(r);
+	int i = (int)fs;
+	int j = (int)fr;
+	s -= fs;
+	r -= fr;
+
+	float h00 = sample(i, j);
+	float h10 = sample(i + 1, j);
+	float h01 = sample(i, j + 1);
+	float h11 = sample(i + 1, j + 1);
+	float h0 = h00 + (h10 - h00) * s;
+	float h1 = h01 + (h11 - h01) * s;
+	return h0 + (h1 - h0) * r;
+}
+
+glm::vec3 HeightField::getNormal(float x, float z) const
+{
+	if (heights.empty())
+		return glm::vec3(0.0f, 1.0f, 0.0f);
+	float left = getHeight(x - texel.x, z);
+	float right = getHeight(x + texel.x, z);
+	float down = getHeight(x, z - texel.y);
+	float up = getHeight(x, z + texel.y);
+	return glm::normalize(glm::vec3((left - right) / (2.0f * texel.x), 1.0f, (down - up) / (2.0f * texel.y)));
+}
+
+void HeightField::getHeights(const glm::vec2 *points, float *out, size_t count) const
+{
+	for (size_t i = 0; i < count; i++)
+		out[i] = getHeight(points[i].x, points[i].y);
+}
+
+void HeightField::getNormals(const glm::vec2 *points, glm::vec3 *out, size_t count) const
+{
+	for (size_t i = 0; i < count; i++)
+		out[i] = getNormal(points[i].x, points[i].y);
+}
+
+float HeightField::minHeight() const
+{
+	return pyramid.empty() ? 0.0f : pyramid.back().range[0].x;
+}
+
+float HeightField::maxHeight() const
+{
+	return pyramid.empty() ? 0.0f : pyramid.back().range[0].y;
+}
+
+// level 0 holds one node per cell between four texel centres, every next level halves the resolution
+void HeightField::buildPyramid()
+{
+	pyramid.clear();
+	Level base;
+	base.w = width - 1;
+	base.h = height - 1;
+	base.range.resize((size_t)base.w * base.h);
+	for (int j = 0; j < base.h; j++)
+	{
+		for (int i = 0; i < base.w; i++)
+		{
+			float h00 = heights[(size_t)j * width + i];
+			float h10 = heights[(size_t)j * width + i + 1];
+			float h01 = heights[(size_t)(j + 1) * width + i];
+			float h11 = heights[(size_t)(j + 1) * width + i + 1];
+			base.range[(size_t)j * base.w + i] = glm::vec2(std::min(std::min(h00, h10), std::min(h01, h11)),
+				std::max(std::max(h00, h10), std::max(h01, h11)));
+		}
+	}
+	pyramid.push_back(base);
+
+	while (pyramid.back().w > 1 || pyramid.back().h > 1)
+	{
+		const Level &prev = pyramid.back();
+		Level next;
+		next.w = (prev.w + 1) / 2;
+		next.h = (prev.h + 1) / 2;
+		next.range.resize((size_t)next.w * next.h);
+		for (int j = 0; j < next.h; j++)
+		{
+			for (int i = 0; i < next.w; i++)
+			{
+				glm::vec2 r(1e30f, -1e30f);
+				for (int c = 0; c < 4; c++)
+				{
+					int ci = i * 2 + (c & 1);
+					int cj = j * 2 + (c >> 1);
+					if (ci >= prev.w || cj >= prev.h)
+						continue;
+					const glm::vec2 &child = prev.range[(size_t)cj * prev.w + ci];
+					r.x = std::min(r.x, child.x);
+					r.y = std::max(r.y, child.y);
+				}
+				next.range[(size_t)j * next.w + i] = r;
+			}
+		}
+		pyramid.push_back(next);
+	}
+}
+
+void HeightField::getRange(float x0, float z0, float x1, float z1, float &minH, float &maxH) const
+{
+	minH = 0.0f;
+	maxH = 0.0f;
+	if (pyramid.empty())
+		return;
+	const int cw = pyramid[0].w;
+	const int ch = pyramid[0].h;
+	// cell i spans texel centres i and i + 1
+	int i0 = std::clamp((int)std::floor(x0 / texel.x - 0.5f), 0, cw - 1);
+	int i1 = std::clamp((int)std::floor(x1 / texel.x - 0.5f), 0, cw - 1);
+	int j0 = std::clamp((int)std::floor(z0 / texel.y - 0.5f), 0, ch - 1);
+	int j1 = std::clamp((int)std::floor(z1 / texel.y - 0.5f), 0, ch - 1);
+
+	// pick the level where the rectangle touches at most 2x2 nodes
+	size_t level = 0;
+	while (level + 1 < pyramid.size() && ((i1 >> level) - (i0 >> level) > 1 || (j1 >> level) - (j0 >> level) > 1))
+		level++;
+
+	const Level &l = pyramid[level];
+	minH = 1e30f;
+	maxH = -1e30f;
+	for (int j = j0 >> level; j <= (j1 >> level); j++)
+	{
+		for (int i = i0 >> level; i <= (i1 >> level); i++)
+		{
+			const glm::vec2 &r = l.range[(size_t)j * l.w + i];
+			minH = std::min(minH, r.x);
+			maxH = std::max(maxH, r.y);
+		}
+	}
+}
+
+// slab test, NaNs from zero direction components fall through the comparisons
+static bool rayBox(const glm::vec3 &origin, const glm::vec3 &invDir, const glm::vec3 &bmin, const glm::vec3 &bmax, float &t0, float &t1)
+{
+	for (int a = 0; a < 3; a++)
+	{
+		float tn = (bmin[a] - origin[a]) * invDir[a];
+		float tf = (bmax[a] - origin[a]) * invDir[a];
+		if (tn > tf)
+			std::swap(tn, tf);
+		if (tn > t0)
+			t0 = tn;
+		if (tf < t1)
+			t1 = tf;
+		if (t0 > t1)
+			return false;
+	}
+	return true;
+}
+
+// exact intersection with the bilinear patch of one cell: along the ray, surface height minus ray height is quadratic in t
+bool HeightField::intersectCell(int i, int j, const glm::vec3 &origin, const glm::vec3 &dir, float tMin, float tMax, float &tHit) const
+{
+	double h00 = heights[(size_t)j * width + i];
+	double h10 = heights[(size_t)j * width + i + 1];
+	double h01 = heights[(size_t)(j + 1) * width + i];
+	double h11 = heights[(size_t)(j + 1) * width + i + 1];
+
+	double s0 = (origin.x - (i + 0.5) * texel.x) / texel.x;
+	double r0 = (origin.z - (j + 0.5) * texel.y) / texel.y;
+	double sd = dir.x / texel.x;
+	double rd = dir.z / texel.y;
+
+	double a = h10 - h00;
+	double b = h01 - h00;
+	double c = h00 - h10 - h01 + h11;
+	double A = c * sd * rd;
+	double B = a * sd + b * rd + c * (s0 * rd + r0 * sd) - dir.y;
+	double C = h00 + a * s0 + b * r0 + c * s0 * r0 - origin.y;
+
+	// already below the surface where the ray enters the cell
+	if ((A * tMin + B) * tMin + C >= 0.0)
+	{
+		tHit = tMin;
+		return true;
+	}
+
+	double roots[2];
+	int n = 0;
+	if (std::abs(A) < 1e-12)
+	{
+		if (std::abs(B) > 1e-12)
+			roots[n++] = -C / B;
+	}
+	else
+	{
+		double disc = B * B - 4.0 * A * C;
+		if (disc < 0.0)
+			return false;
+		double sq = std::sqrt(disc);
+		// numerically stable form
+		double q = -0.5 * (B + (B < 0.0 ? -sq : sq));
+		roots[n++] = q / A;
+		if (q != 0.0)
+			roots[n++] = C / q;
+		if (n == 2 && roots[1] < roots[0])
+			std::swap(roots[0], roots[1]);
+	}
+	for (int k = 0; k < n; k++)
+	{
+		if (roots[k] >= tMin && roots[k] <= tMax)
+		{
+			tHit = (float)roots[k];
+			return true;
+		}
+	}
+	return false;
+}
+
+bool HeightField::raycast(const glm::vec3 &origin, const glm::vec3 &dir, float maxDist, float &tHit) const
+{
+	if (pyramid.empty())
+		return false;
+
+	struct Node
+	{
+		int level, i, j;
+		float tEnter, tExit;
+	};
+
+	const glm::vec3 invDir(1.0f / dir.x, 1.0f / dir.y, 1.0f / dir.z);
+	const int cw = pyramid[0].w;
+	const int ch = pyramid[0].h;
+	auto nodeBox = [&](int level, int i, int j, glm::vec3 &bmin, glm::vec3 &bmax)
+	{
+		const glm::vec2 &r = pyramid[level].range[(size_t)j * pyramid[level].w + i];
+		int ci0 = i << level, ci1 = std::min((i + 1) << level, cw);
+		int cj0 = j << level, cj1 = std::min((j + 1) << level, ch);
+		bmin = glm::vec3((ci0 + 0.5f) * texel.x, r.x, (cj0 + 0.5f) * texel.y);
+		bmax = glm::vec3((ci1 + 0.5f) * texel.x, r.y, (cj1 + 0.5f) * texel.y);
+	};
+
+	float best = maxDist;
+	bool hit = false;
+
+	// depth-first, nearest child first, so the first leaf hit usually ends the search
+	Node stack[64];
+	int top = 0;
+	{
+		glm::vec3 bmin, bmax;
+		int level = (int)pyramid.size() - 1;
+		nodeBox(level, 0, 0, bmin, bmax);
+		float t0 = 0.0f, t1 = best;
+		if (!rayBox(origin, invDir, bmin, bmax, t0, t1))
+			return false;
+		stack[top++] = { level, 0, 0, t0, t1 };
+	}
+
+	while (top > 0)
+	{
+		Node node = stack[--top];
+		if (node.tEnter > best)
+			continue;
+
+		if (node.level == 0)
+		{
+			float t;
+			if (intersectCell(node.i, node.j, origin, dir, node.tEnter, std::min(node.tExit, best), t) && t <= best)
+			{
+				best = t;
+				hit = true;
+			}
+			continue;
+		}
+
+		const Level &child = pyramid[node.level - 1];
+		Node children[4];
+		int count = 0;
+		for (int c = 0; c < 4; c++)
+		{
+			int ci = node.i * 2 + (c & 1);
+			int cj = node.j * 2 + (c >> 1);
+			if (ci >= child.w || cj >= child.h)
+				continue;
+			glm::vec3 bmin, bmax;
+			nodeBox(node.level - 1, ci, cj, bmin, bmax);
+			float t0 = 0.0f, t1 = best;
+			if (rayBox(origin, invDir, bmin, bmax, t0, t1))
+				children[count++] = { node.level - 1, ci, cj, t0, t1 };
+		}
+		// push farthest first
+		std::sort(children, children + count, [](const Node &a, const Node &b) { return a.tEnter > b.tEnter; });
+		for (int c = 0; c < count; c++)
+			stack[top++] = children[c];
+	}
+
+	if (hit)
+		tHit = best;
+	return hit;
+}
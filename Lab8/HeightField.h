@@ -0,0 +1,64 @@
+#pragma once
+#ifndef HEIGHTFIELD_H
+#define HEIGHTFIELD_H
+
+#include <glm/glm.hpp>
+
+#include <vector>
+#include <cstddef>
+
+// CPU copy of the terrain height map.
+// Heights are reconstructed exactly like the tessellation evaluation shader samples heightMap:
+// bilinear filtering between texel centres with repeat wrapping, value * heightScale.
+// A min/max pyramid over the texel cells accelerates ray casts (a quadtree over the heightfield).
+class HeightField
+{
+public:
+	HeightField();
+
+	// builds the field from image data, only the first channel is used (like .r in the shaders)
+	void build(const unsigned char *pixels, int w, int h, int channels, float heightScale, glm::vec2 worldSize);
+	// builds the field from heights that are already in world units
+	void build(const float *heightsIn, int w, int h, glm::vec2 worldSize);
+	// loads an image with stb_image and builds the field from it
+	bool loadFromFile(const char *path, float heightScale, glm::vec2 worldSize);
+	bool empty() const;
+
+	// bilinear height at world position (x, z)
+	float getHeight(float x, float z) const;
+	// surface normal at world position (x, z), from central differences one texel apart
+	glm::vec3 getNormal(float x, float z) const;
+	// batched versions of the above, points are world (x, z) pairs
+	void getHeights(const glm::vec2 *points, float *out, size_t count) const;
+	void getNormals(const glm::vec2 *points, glm::vec3 *out, size_t count) const;
+	// intersects a ray with the surface, returns the distance along dir (dir does not need to be normalized)
+	bool raycast(const glm::vec3 &origin, const glm::vec3 &dir, float maxDist, float &tHit) const;
+	// conservative height range of the surface over the world rectangle [x0,x1] x [z0,z1]
+	void getRange(float x0, float z0, float x1, float z1, float &minH, float &maxH) const;
+
+	float minHeight() const;
+	float maxHeight() const;
+	int getWidth() const { return width; }
+	int getHeightSamples() const { return height; }
+	glm::vec2 getWorldSize() const { return worldSize; }
+	glm::vec2 getTexelSize() const { return texel; }
+	// raw sample at texel (i, j), wrapped
+	float sample(int i, int j) const;
+
+private:
+	struct Level
+	{
+		int w, h;
+		std::vector<glm::vec2> range;   // (min, max) per node
+	};
+
+	std::vector<float> heights;
+	std::vector<Level> pyramid;
+	int width, height;
+	glm::vec2 worldSize;
+	glm::vec2 texel;    // world size of one texel
+
+	void buildPyramid();
+	bool intersectCell(int i, int j, const glm::vec3 &origin, const glm::vec3 &dir, float tMin, float tMax, float &tHit) const;
+};
+#endif
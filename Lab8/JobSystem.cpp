@@ -0,0 +1,214 @@
+#include "JobSystem.h"
+
+#include <algorithm>
+
+// which system and worker the current thread belongs to
+static thread_local const JobSystem *tlsSystem = nullptr;
+static thread_local int tlsWorker = -1;
+
+JobSystem::JobSystem(int workerCount)
+{
+	if (workerCount < 1)
+		workerCount = std::max(1, (int)std::thread::hardware_concurrency() - 1);
+	queued = 0;
+	nextQueue = 0;
+	running = true;
+	external.jobsRun = 0;
+	external.steals = 0;
+	external.busyNs = 0;
+	statsStart = std::chrono::steady_clock::now();
+
+	for (int i = 0; i < workerCount; i++)
+	{
+		workers.emplace_back(new Worker());
+		workers.back()->jobsRun = 0;
+		workers.back()->steals = 0;
+		workers.back()->busyNs = 0;
+	}
+	// start the threads only once every deque exists, they steal from each other right away
+	for (int i = 0; i < workerCount; i++)
+		workers[i]->thread = std::thread(&JobSystem::workerLoop, this, i);
+}
+
+JobSystem::~JobSystem()
+{
+	{
+		std::lock_guard<std::mutex> lock(sleepMutex);
+		running = false;
+	}
+	wake.notify_all();
+	for (auto &worker : workers)
+		worker->thread.join();
+}
+
+JobSystem &JobSystem::instance()
+{
+	static JobSystem system;
+	return system;
+}
+
+int JobSystem::currentWorker() const
+{
+	return tlsSystem == this ? tlsWorker : -1;
+}
+
+void JobSystem::submit(std::function<void()> function, JobCounter *counter)
+{
+	if (counter)
+		counter->pending.fetch_add(1, std::memory_order_relaxed);
+
+	// workers keep their children local, other threads spread work round robin
+	int self = currentWorker();
+	int target = self >= 0 ? self : (int)(nextQueue++ % workers.size());
+	{
+		std::lock_guard<std::mutex> lock(workers[target]->mutex);
+		workers[target]->jobs.push_back({ std::move(function), counter });
+	}
+	queued++;
+	// the lock orders this against a worker that just found nothing and is about to sleep
+	{
+		std::lock_guard<std::mutex> lock(sleepMutex);
+	}
+	wake.notify_one();
+}
+
+bool JobSystem::findJob(int self, Job &job, bool &stolen)
+{
+	if (queued.load(std::memory_order_acquire) == 0)
+		return false;
+
+	if (self >= 0)
+	{
+		Worker &own = *workers[self];
+		std::lock_guard<std::mutex> lock(own.mutex);
+		if (!own.jobs.empty())
+		{
+			job = std::move(own.jobs.back());
+			own.jobs.pop_back();
+			queued--;
+			stolen = false;
+			return true;
+		}
+	}
+
+	// steal the oldest job, starting after ourselves so thieves spread over the victims
+	const int count = (int)workers.size();
+	const int start = self >= 0 ? self + 1 : (int)(nextQueue.load(std::memory_order_relaxed) % count);
+	for (int i = 0; i < count; i++)
+	{
+		int victim = (start + i) % count;
+		if (victim == self)
+			continue;
+		Worker &other = *workers[victim];
+		std::lock_guard<std::mutex> lock(other.mutex);
+		if (!other.jobs.empty())
+		{
+			job = std::move(other.jobs.front());
+			other.jobs.pop_front();
+			queued--;
+			stolen = self >= 0;
+			return true;
+		}
+	}
+	return false;
+}
+
+void JobSystem::execute(Job &job, int self, bool stolen)
+{
+	Worker &stats = self >= 0 ? *workers[self] : external;
+	auto start = std::chrono::steady_clock::now();
+	job.function();
+	auto end = std::chrono::steady_clock::now();
+
+	stats.jobsRun.fetch_add(1, std::memory_order_relaxed);
+	if (stolen)
+		stats.steals.fetch_add(1, std::memory_order_relaxed);
+	stats.busyNs.fetch_add((uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count(), std::memory_order_relaxed);
+
+	// the counter is released last: waiters may destroy it as soon as it reaches zero
+	if (job.counter)
+		job.counter->pending.fetch_sub(1, std::memory_order_release);
+}
+
+void JobSystem::workerLoop(int index)
+{
+	tlsSystem = this;
+	tlsWorker = index;
+	while (true)
+	{
+		Job job;
+		bool stolen;
+		if (findJob(index, job, stolen))
+		{
+			execute(job, index, stolen);
+			continue;
+		}
+		std::unique_lock<std::mutex> lock(sleepMutex);
+		wake.wait(lock, [this]() { return !running || queued.load() > 0; });
+		if (!running)
+			return;
+	}
+}
+
+void JobSystem::wait(JobCounter &counter)
+{
+	const int self = currentWorker();
+	while (!counter.done())
+	{
+		Job job;
+		bool stolen;
+		if (findJob(self, job, stolen))
+			execute(job, self, stolen);
+		else
+			// whatever is left is already running on other threads
+			std::this_thread::yield();
+	}
+}
+
+void JobSystem::parallelFor(int begin, int end, int grain, const std::function<void(int, int)> &body)
+{
+	if (end <= begin)
+		return;
+	grain = std::max(grain, 1);
+	JobCounter counter;
+	for (int first = begin; first < end; first += grain)
+	{
+		int last = std::min(end, first + grain);
+		submit([&body, first, last]() { body(first, last); }, &counter);
+	}
+	wait(counter);
+}
+
+FrameVector<JobSystem::WorkerStats> JobSystem::getStats() const
+{
+	double elapsedMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - statsStart).count();
+	FrameVector<WorkerStats> stats;
+	stats.reserve(workers.size() + 1);
+	auto add = [&](const Worker &worker)
+	{
+		WorkerStats s;
+		s.jobs = worker.jobsRun.load();
+		s.steals = worker.steals.load();
+		s.busyMs = worker.busyNs.load() / 1.0e6;
+		s.utilization = elapsedMs > 0.0 ? s.busyMs / elapsedMs : 0.0;
+		stats.push_back(s);
+	};
+	for (const auto &worker : workers)
+		add(*worker);
+	add(external);
+	return stats;
+}
+
+void JobSystem::resetStats()
+{
+	for (auto &worker : workers)
+	{
+		worker->jobsRun = 0;
+		worker->steals = 0;
+		worker->busyNs = 0;
+	}
+	external.jobsRun = 0;
+	external.steals = 0;
+	external.busyNs = 0;
+	statsStart = std::chrono::steady_clock::now();
+}
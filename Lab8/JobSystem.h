@@ -0,0 +1,105 @@
+#pragma once
+#ifndef JOBSYSTEM_H
+#define JOBSYSTEM_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "FrameArena.h"
+
+// Counts unfinished jobs. A job may submit children against the counter it was submitted with:
+// the counter only reaches zero once the parent and all of its children are done.
+class JobCounter
+{
+public:
+	JobCounter() : pending(0) {}
+	JobCounter(const JobCounter&) = delete;
+	JobCounter& operator=(const JobCounter&) = delete;
+
+	bool done() const { return pending.load(std::memory_order_acquire) == 0; }
+
+private:
+	friend class JobSystem;
+	std::atomic<int> pending;
+};
+
+// Work-stealing job system.
+// Every worker owns a deque: it pushes and pops its own jobs at the back (newest first, cache-warm),
+// idle workers steal from the front of the others (oldest, usually the biggest pieces of work).
+// Threads that wait on a counter run jobs themselves instead of blocking, so waiting inside a job is fine.
+class JobSystem
+{
+public:
+	struct WorkerStats
+	{
+		uint64_t jobs;          // jobs run by this worker
+		uint64_t steals;        // of those, taken from another worker's deque
+		double busyMs;          // time spent inside jobs
+		double utilization;     // busyMs over the time since the last resetStats
+	};
+
+	// workerCount < 1 - one worker per hardware thread, minus the thread that submits and waits
+	explicit JobSystem(int workerCount = 0);
+	~JobSystem();
+	JobSystem(const JobSystem&) = delete;
+	JobSystem& operator=(const JobSystem&) = delete;
+
+	// shared instance for engine code (terrain, noise, asset loading)
+	static JobSystem &instance();
+
+	// thread-safe; counter may be null for fire-and-forget jobs
+	void submit(std::function<void()> job, JobCounter *counter = nullptr);
+	// runs queued jobs on the calling thread until the counter reaches zero
+	void wait(JobCounter &counter);
+	// splits [begin, end) into chunks of at most grain items, body(first, last) runs for each chunk;
+	// returns when all chunks are done
+	void parallelFor(int begin, int end, int grain, const std::function<void(int, int)> &body);
+
+	int getWorkerCount() const { return (int)workers.size(); }
+	// index of the calling worker, -1 on threads that do not belong to this system
+	int currentWorker() const;
+	// one entry per worker, plus a last entry for jobs run by waiting external threads;
+	// the list is a transient of the current frame, so render thread only
+	FrameVector<WorkerStats> getStats() const;
+	void resetStats();
+
+private:
+	struct Job
+	{
+		std::function<void()> function;
+		JobCounter *counter;
+	};
+	struct alignas(64) Worker
+	{
+		std::mutex mutex;
+		std::deque<Job> jobs;
+		std::thread thread;
+		std::atomic<uint64_t> jobsRun;
+		std::atomic<uint64_t> steals;
+		std::atomic<uint64_t> busyNs;
+	};
+
+	std::vector<std::unique_ptr<Worker> > workers;
+	Worker external;                    // stats for jobs run by non-worker threads while they wait
+	std::atomic<int> queued;
+	std::atomic<unsigned> nextQueue;
+	std::atomic<bool> running;
+	std::mutex sleepMutex;
+	std::condition_variable wake;
+	std::chrono::steady_clock::time_point statsStart;
+
+	void workerLoop(int index);
+	// pops own work first, then steals; returns false when every deque is empty
+	bool findJob(int self, Job &job, bool &stolen);
+	void execute(Job &job, int self, bool stolen);
+};
+
+#endif
@@ -1,71 +1,181 @@
 #include "Mesh.h"
+#include "RenderState.h"
 
 
-Mesh::Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures)
+Mesh::Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures, StagingUploader *uploader, bool keepCpuData)
 {
-	this->vertices = vertices;
-	this->indices = indices;
-	this->textures = textures;
+	this->vertices = std::move(vertices);
+	this->indices = std::move(indices);
+	this->textures = std::move(textures);
+	indexCount = (GLsizei)this->indices.size();
 
 	// now that we have all the required data, set the vertex buffers and its attribute pointers.
-	setupMesh();
+	setupMesh(uploader, keepCpuData);
 }
 
+Mesh::Mesh(Mesh &&other) noexcept
+	: vertices(std::move(other.vertices)), indices(std::move(other.indices)), textures(std::move(other.textures))
+{
+	VAO = other.VAO;
+	VBO = other.VBO;
+	EBO = other.EBO;
+	indexCount = other.indexCount;
+	programBindings = std::move(other.programBindings);
+	other.VAO = other.VBO = other.EBO = 0;
+	other.indexCount = 0;
+}
 
-void Mesh::Draw(Shader shader)
+Mesh &Mesh::operator=(Mesh &&other) noexcept
 {
-	// bind appropriate textures
-	unsigned int diffuseNr = 1;
-	unsigned int specularNr = 1;
-	unsigned int normalNr = 1;
-	unsigned int heightNr = 1;
-	for (unsigned int i = 0; i < textures.size(); i++)
+	if (this != &other)
+	{
+		release();
+		vertices = std::move(other.vertices);
+		indices = std::move(other.indices);
+		textures = std::move(other.textures);
+		VAO = other.VAO;
+		VBO = other.VBO;
+		EBO = other.EBO;
+		indexCount = other.indexCount;
+		programBindings = std::move(other.programBindings);
+		other.VAO = other.VBO = other.EBO = 0;
+		other.indexCount = 0;
+	}
+	return *this;
+}
+
+Mesh::~Mesh()
+{
+	release();
+}
+
+// textures belong to the model that loaded them, the mesh only deletes its own buffers
+void Mesh::release()
+{
+	if (VAO)
+	{
+		RenderState::get().forgetVertexArray(VAO);
+		glDeleteVertexArrays(1, &VAO);
+	}
+	if (VBO)
+		glDeleteBuffers(1, &VBO);
+	if (EBO)
+		glDeleteBuffers(1, &EBO);
+	VAO = VBO = EBO = 0;
+}
+
+
+const char *textureTypeName(TextureType type)
+{
+	switch (type)
+	{
+	case TextureType::Diffuse: return "texture_diffuse";
+	case TextureType::Specular: return "texture_specular";
+	case TextureType::Normal: return "texture_normal";
+	case TextureType::Height: return "texture_height";
+	default: return "";
+	}
+}
+
+const ProgramBindings *Mesh::findBindings(GLuint program) const
+{
+	for (const ProgramBindings &table : programBindings)
+		if (table.program == program)
+			return &table;
+	return nullptr;
+}
+
+void Mesh::prepare(const Shader &shader)
+{
+	if (findBindings(shader.ID))
+		return;
+	const GLuint program = shader.ID;
+	programBindings.push_back(ProgramBindings());
+	programBindings.back().program = program;
+	vector<TextureBinding> &bindings = programBindings.back().bindings;
+	unsigned int counts[(int)TextureType::Count] = {};
+	for (const Texture &texture : textures)
 	{
-		glActiveTexture(GL_TEXTURE0 + i); // active proper texture unit before binding
 		// retrieve texture number (the N in diffuse_textureN)
-		string number;
-		string name = textures[i].type;
-		if (name == "texture_diffuse")
-			number = std::to_string(diffuseNr++);
-		else if (name == "texture_specular")
-			number = std::to_string(specularNr++); // transfer unsigned int to stream
-		else if (name == "texture_normal")
-			number = std::to_string(normalNr++); // transfer unsigned int to stream
-		else if (name == "texture_height")
-			number = std::to_string(heightNr++); // transfer unsigned int to stream
-
-												 // now set the sampler to the correct texture unit
-		glUniform1i(glGetUniformLocation(shader.ID, (name + number).c_str()), i);
-		// and finally bind the texture
-		glBindTexture(GL_TEXTURE_2D, textures[i].id);
+		unsigned int n = counts[(int)texture.type]++;
+		if (n >= TEXTURE_UNITS_PER_TYPE)
+			continue;
+		string name = textureTypeName(texture.type) + std::to_string(n + 1);
+		TextureBinding binding;
+		binding.location = glGetUniformLocation(program, name.c_str());
+		// samplers the program does not use cost nothing at draw time
+		if (binding.location < 0)
+			continue;
+		binding.unit = (GLuint)texture.type * TEXTURE_UNITS_PER_TYPE + n;
+		binding.texture = texture.id;
+		// the sampler keeps its unit in the program, Draw never sets it again
+		glProgramUniform1i(program, binding.location, binding.unit);
+		bindings.push_back(binding);
+	}
+}
+
+void Mesh::Draw(const Shader &shader)
+{
+	const ProgramBindings *table = findBindings(shader.ID);
+	if (!table)
+	{
+		// reported once: the empty table stands in for it from now on and the mesh draws untextured
+		std::cout << "ERROR::MESH::PROGRAM_NOT_PREPARED " << shader.ID << std::endl;
+		programBindings.push_back(ProgramBindings());
+		programBindings.back().program = shader.ID;
+		table = &programBindings.back();
 	}
 
-	// draw mesh
-	glBindVertexArray(VAO);
-	glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
-	glBindVertexArray(0);
+	// bind appropriate textures
+	for (const TextureBinding &binding : table->bindings)
+		RenderState::get().bindTexture(binding.unit, binding.texture);
 
-	// always good practice to set everything back to defaults once configured.
-	glActiveTexture(GL_TEXTURE0);
+	// draw mesh
+	RenderState::get().bindVertexArray(VAO);
+	glDrawElements(GL_TRIANGLES, indexCount, GL_UNSIGNED_INT, 0);
 }
 
-void Mesh::setupMesh()
+void Mesh::setupMesh(StagingUploader *uploader, bool keepCpuData)
 {
 	// create buffers/arrays
 	glGenVertexArrays(1, &VAO);
-	glGenBuffers(1, &VBO);
-	glGenBuffers(1, &EBO);
+	glCreateBuffers(1, &VBO);
+	glCreateBuffers(1, &EBO);
 
-	glBindVertexArray(VAO);
-	// load data into vertex buffers
-	glBindBuffer(GL_ARRAY_BUFFER, VBO);
 	// A great thing about structs is that their memory layout is sequential for all its items.
 	// The effect is that we can simply pass a pointer to the struct and it translates perfectly to a glm::vec3/2 array which
 	// again translates to 3/2 floats which translates to a byte array.
-	glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), &vertices[0], GL_STATIC_DRAW);
+	if (uploader)
+	{
+		// allocate only, the copies are streamed in by the uploader
+		glNamedBufferStorage(VBO, vertices.size() * sizeof(Vertex), nullptr, 0);
+		glNamedBufferStorage(EBO, indices.size() * sizeof(unsigned int), nullptr, 0);
+		// without a CPU copy to keep, the arrays themselves become the upload data
+		if (keepCpuData)
+		{
+			uploader->queueBuffer(VBO, vector<Vertex>(vertices));
+			uploader->queueBuffer(EBO, vector<unsigned int>(indices));
+		}
+		else
+		{
+			uploader->queueBuffer(VBO, std::move(vertices));
+			uploader->queueBuffer(EBO, std::move(indices));
+		}
+	}
+	else
+	{
+		glNamedBufferStorage(VBO, vertices.size() * sizeof(Vertex), vertices.data(), 0);
+		glNamedBufferStorage(EBO, indices.size() * sizeof(unsigned int), indices.data(), 0);
+	}
+	if (!keepCpuData)
+	{
+		vector<Vertex>().swap(vertices);
+		vector<unsigned int>().swap(indices);
+	}
 
+	RenderState::get().bindVertexArray(VAO);
+	glBindBuffer(GL_ARRAY_BUFFER, VBO);
 	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
 
 	// set the vertex attribute pointers
 	// vertex Positions
@@ -84,5 +194,5 @@ void Mesh::setupMesh()
 	glEnableVertexAttribArray(4);
 	glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Bitangent));
 
-	glBindVertexArray(0);
+	RenderState::get().bindVertexArray(0);
 }
\ No newline at end of file
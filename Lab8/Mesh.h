@@ -8,6 +8,7 @@
 #include <glm/gtc/matrix_transform.hpp>
 
 #include "Shader.h"
+#include "StagingUploader.h"
 
 #include <string>
 #include <fstream>
@@ -25,18 +26,49 @@ struct Vertex {
 
 };
 
+// sampler names follow the texture_diffuseN convention, N counting from 1 per type
+enum class TextureType {
+	Diffuse,
+	Specular,
+	Normal,
+	Height,
+	Count
+};
+const char *textureTypeName(TextureType type);
+
 struct Texture {
 	unsigned int id;
-	string type;
+	TextureType type;
 	string path;
 };
 
+// one sampler of a mesh resolved against one program: the unit is fixed per (type, N),
+// so every mesh drawn with the program agrees on the sampler uniform values
+struct TextureBinding {
+	GLint location;
+	GLuint unit;
+	GLuint texture;
+};
+const GLuint TEXTURE_UNITS_PER_TYPE = 4;
+
+// the binding table of a mesh for one program
+struct ProgramBindings {
+	GLuint program;
+	vector<TextureBinding> bindings;
+};
+
 class Mesh {
 
 private:
 	unsigned int VBO, EBO;
-	// initializes all the buffer objects/arrays
-	void setupMesh();
+	GLsizei indexCount;
+	// initializes all the buffer objects/arrays, the data goes through the uploader when there is one
+	void setupMesh(StagingUploader *uploader, bool keepCpuData);
+	void release();
+
+	// material binding tables, one per program the mesh was prepared for; a handful, searched linearly
+	vector<ProgramBindings> programBindings;
+	const ProgramBindings *findBindings(GLuint program) const;
 
 public:
 	/*  Mesh Data  */
@@ -44,7 +76,18 @@ public:
 	vector<unsigned int> indices;
 	vector<Texture> textures;
 	unsigned int VAO;
-	Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures);
-	void Draw(Shader shader);
+	// the arrays are moved in; with keepCpuData false vertices and indices are freed once they are uploaded
+	// (or handed over to the uploader), only textures stay on the CPU
+	Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures, StagingUploader *uploader = nullptr, bool keepCpuData = true);
+	// owns its GL objects: move-only, deleted with the mesh
+	Mesh(Mesh &&other) noexcept;
+	Mesh &operator=(Mesh &&other) noexcept;
+	Mesh(const Mesh&) = delete;
+	Mesh &operator=(const Mesh&) = delete;
+	~Mesh();
+	// resolves the material against a program once, at load; Draw with that program then only binds units
+	void prepare(const Shader &shader);
+	void Draw(const Shader &shader);
+	GLsizei getIndexCount() const { return indexCount; }
 };
 #endif#pragma once
@@ -1,15 +1,62 @@
 #include "Model.h"
+#include "RenderState.h"
 
-Model::Model(string const &path)
+#include <chrono>
+
+Model::Model(string const &path, StagingUploader *uploader, bool keepCpuData)
 {
+	this->uploader = uploader;
+	this->keepCpuData = keepCpuData;
 	loadModel(path);
 }
 
+Model::~Model()
+{
+	// decode jobs still hold a pointer to the counter
+	waitForTextures();
+	for (const Texture &texture : textures_loaded)
+	{
+		RenderState::get().forgetTexture(texture.id);
+		glDeleteTextures(1, &texture.id);
+	}
+}
+
+void Model::waitForTextures()
+{
+	JobSystem::instance().wait(pendingLoads);
+}
+
+
+void Model::setTransform(const glm::mat4 &transform)
+{
+	if (nodes.size() > 0)
+		nodes.setLocal(0, transform);
+}
+
+SceneGraph::NodeId Model::findNode(const string &name) const
+{
+	for (size_t i = 0; i < nodeNames.size(); i++)
+		if (nodeNames[i] == name)
+			return (SceneGraph::NodeId)i;
+	return SceneGraph::NO_PARENT;
+}
+
+void Model::prepare(const Shader &shader)
+{
+	for (Mesh &mesh : meshes)
+		mesh.prepare(shader);
+}
 
-void Model::Draw(Shader shader)
+void Model::Draw(const Shader &shader)
 {
+	// only the subtrees moved since the last draw are recomputed
+	nodes.update();
+	GLint modelLocation = glGetUniformLocation(shader.ID, "model");
 	for (unsigned int i = 0; i < meshes.size(); i++)
+	{
+		glUniformMatrix4fv(modelLocation, 1, GL_FALSE, &nodes.getWorld(meshNodes[i])[0][0]);
 		meshes[i].Draw(shader);
+	}
 }
 
 void Model::loadModel(string const &path)
@@ -26,35 +73,67 @@ void Model::loadModel(string const &path)
 	// retrieve the directory path of the filepath
 	directory = path.substr(0, path.find_last_of('\\'));
 	std::cout << directory << std::endl;
-	// process ASSIMP's root node recursively
-	processNode(scene->mRootNode, scene);
+	// process ASSIMP's root node recursively, collecting the meshes in node order
+	vector<aiMesh*> order;
+	nodes.clear();
+	nodeNames.clear();
+	meshNodes.clear();
+	nodes.addNode(SceneGraph::NO_PARENT, glm::mat4(1.0f));
+	nodeNames.push_back("");
+	processNode(scene->mRootNode, scene, order, 0);
+
+	auto start = std::chrono::steady_clock::now();
+	// 1. CPU stage: every aiMesh becomes final vertex and index arrays on the job system
+	vector<vector<Vertex> > vertices(order.size());
+	vector<vector<unsigned int> > indices(order.size());
+	JobSystem::instance().parallelFor(0, (int)order.size(), 1, [&](int first, int last)
+	{
+		for (int i = first; i < last; i++)
+			processMesh(order[i], vertices[i], indices[i]);
+	});
+	auto converted = std::chrono::steady_clock::now();
+
+	// 2. GL stage: materials and buffer objects, arrays are moved into the meshes
+	meshes.reserve(order.size());
+	for (size_t i = 0; i < order.size(); i++)
+		meshes.emplace_back(std::move(vertices[i]), std::move(indices[i]), processMaterial(order[i], scene), uploader, keepCpuData);
+	auto uploaded = std::chrono::steady_clock::now();
+	std::cout << order.size() << " meshes converted in " << std::chrono::duration<double, std::milli>(converted - start).count()
+		<< " ms, set up in " << std::chrono::duration<double, std::milli>(uploaded - converted).count() << " ms" << std::endl;
 }
 
-void Model::processNode(aiNode *node, const aiScene *scene)
+void Model::processNode(aiNode *node, const aiScene *scene, vector<aiMesh*> &order, SceneGraph::NodeId parent)
 {
+	// keep the node's transform; aiMatrix4x4 is row major, glm is column major
+	const aiMatrix4x4 &m = node->mTransformation;
+	glm::mat4 local(m.a1, m.b1, m.c1, m.d1,
+		m.a2, m.b2, m.c2, m.d2,
+		m.a3, m.b3, m.c3, m.d3,
+		m.a4, m.b4, m.c4, m.d4);
+	SceneGraph::NodeId id = nodes.addNode(parent, local);
+	nodeNames.push_back(node->mName.C_Str());
+
 	// process each mesh located at the current node
 	for (unsigned int i = 0; i < node->mNumMeshes; i++)
 	{
 		// the node object only contains indices to index the actual objects in the scene. 
 		// the scene contains all the data, node is just to keep stuff organized (like relations between nodes).
-		aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
-		meshes.push_back(processMesh(mesh, scene));
+		order.push_back(scene->mMeshes[node->mMeshes[i]]);
+		meshNodes.push_back(id);
 	}
 	// after we've processed all of the meshes (if any) we then recursively process each of the children nodes
 	for (unsigned int i = 0; i < node->mNumChildren; i++)
 	{
-		processNode(node->mChildren[i], scene);
+		processNode(node->mChildren[i], scene, order, id);
 	}
 
 }
 
 
-Mesh Model::processMesh(aiMesh *mesh, const aiScene *scene)
+void Model::processMesh(const aiMesh *mesh, vector<Vertex> &vertices, vector<unsigned int> &indices)
 {
-	// data to fill
-	vector<Vertex> vertices;
-	vector<unsigned int> indices;
-	vector<Texture> textures;
+	vertices.reserve(mesh->mNumVertices);
+	indices.reserve(mesh->mNumFaces * 3);
 
 	// Walk through each of the mesh's vertices
 	for (unsigned int i = 0; i < mesh->mNumVertices; i++)
@@ -98,12 +177,16 @@ Mesh Model::processMesh(aiMesh *mesh, const aiScene *scene)
 	// now wak through each of the mesh's faces (a face is a mesh its triangle) and retrieve the corresponding vertex indices.
 	for (unsigned int i = 0; i < mesh->mNumFaces; i++)
 	{
-		aiFace face = mesh->mFaces[i];
+		const aiFace &face = mesh->mFaces[i];
 		// retrieve all indices of the face and store them in the indices vector
 		for (unsigned int j = 0; j < face.mNumIndices; j++)
 			indices.push_back(face.mIndices[j]);
 	}
-	// process materials
+}
+
+vector<Texture> Model::processMaterial(const aiMesh *mesh, const aiScene *scene)
+{
+	vector<Texture> textures;
 	aiMaterial* material = scene->mMaterials[mesh->mMaterialIndex];
 	// we assume a convention for sampler names in the shaders. Each diffuse texture should be named
 	// as 'texture_diffuseN' where N is a sequential number ranging from 1 to MAX_SAMPLER_NUMBER. 
@@ -113,24 +196,23 @@ Mesh Model::processMesh(aiMesh *mesh, const aiScene *scene)
 	// normal: texture_normalN
 
 	// 1. diffuse maps
-	vector<Texture> diffuseMaps = loadMaterialTextures(material, aiTextureType_DIFFUSE, "texture_diffuse");
+	vector<Texture> diffuseMaps = loadMaterialTextures(material, aiTextureType_DIFFUSE, TextureType::Diffuse);
 	textures.insert(textures.end(), diffuseMaps.begin(), diffuseMaps.end());
 	// 2. specular maps
-	vector<Texture> specularMaps = loadMaterialTextures(material, aiTextureType_SPECULAR, "texture_specular");
+	vector<Texture> specularMaps = loadMaterialTextures(material, aiTextureType_SPECULAR, TextureType::Specular);
 	textures.insert(textures.end(), specularMaps.begin(), specularMaps.end());
 	// 3. normal maps
-	std::vector<Texture> normalMaps = loadMaterialTextures(material, aiTextureType_HEIGHT, "texture_normal");
+	std::vector<Texture> normalMaps = loadMaterialTextures(material, aiTextureType_HEIGHT, TextureType::Normal);
 	textures.insert(textures.end(), normalMaps.begin(), normalMaps.end());
 	// 4. height maps
-	std::vector<Texture> heightMaps = loadMaterialTextures(material, aiTextureType_AMBIENT, "texture_height");
+	std::vector<Texture> heightMaps = loadMaterialTextures(material, aiTextureType_AMBIENT, TextureType::Height);
 	textures.insert(textures.end(), heightMaps.begin(), heightMaps.end());
 
-	// return a mesh object created from the extracted mesh data
-	return Mesh(vertices, indices, textures);
+	return textures;
 }
 
 
-vector<Texture> Model::loadMaterialTextures(aiMaterial *mat, aiTextureType type, string typeName)
+vector<Texture> Model::loadMaterialTextures(aiMaterial *mat, aiTextureType type, TextureType textureType)
 {
 	vector<Texture> textures;
 	for (unsigned int i = 0; i < mat->GetTextureCount(type); i++)
@@ -152,7 +234,7 @@ vector<Texture> Model::loadMaterialTextures(aiMaterial *mat, aiTextureType type,
 		{   // if texture hasn't been loaded already, load it
 			Texture texture;
 			texture.id = TextureFromFile(str.C_Str(), this->directory);
-			texture.type = typeName;
+			texture.type = textureType;
 			texture.path = str.C_Str();
 			textures.push_back(texture);
 			textures_loaded.push_back(texture);  // store it as texture loaded for entire model, to ensure we won't unnecesery load duplicate textures.
@@ -168,6 +250,28 @@ unsigned int Model::TextureFromFile(const char *path, const string &directory)
 	filename = directory + '/' + filename;
 
 	unsigned int textureID;
+
+	if (uploader)
+	{
+		// decoded on a worker thread, the pixels go from there straight into the upload queue
+		glCreateTextures(GL_TEXTURE_2D, 1, &textureID);
+		glTextureParameteri(textureID, GL_TEXTURE_WRAP_S, GL_REPEAT);
+		glTextureParameteri(textureID, GL_TEXTURE_WRAP_T, GL_REPEAT);
+		glTextureParameteri(textureID, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+		glTextureParameteri(textureID, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		StagingUploader *target = uploader;
+		JobSystem::instance().submit([filename, textureID, target]()
+		{
+			int width, height, nrComponents;
+			unsigned char *data = stbi_load(filename.c_str(), &width, &height, &nrComponents, 0);
+			if (data)
+				target->queueImage(textureID, std::shared_ptr<const unsigned char>(data, stbi_image_free), width, height, nrComponents);
+			else
+				std::cout << "Texture failed to load at path: " << filename << std::endl;
+		}, &pendingLoads);
+		return textureID;
+	}
+
 	glGenTextures(1, &textureID);
 
 	int width, height, nrComponents;
@@ -190,6 +294,8 @@ unsigned int Model::TextureFromFile(const char *path, const string &directory)
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		// bound through the active unit, behind the state cache's back
+		RenderState::get().invalidate();
 
 		stbi_image_free(data);
 	}
@@ -13,6 +13,8 @@
 
 #include "Mesh.h"
 #include "Shader.h"
+#include "JobSystem.h"
+#include "SceneGraph.h"
 
 #include <string>
 #include <fstream>
@@ -31,23 +33,47 @@ private:
 	// loads a model with supported ASSIMP extensions from file and stores the resulting meshes in the meshes vector.
 	void loadModel(string const &path);
 	// processes a node in a recursive fashion. Processes each individual mesh located at the node and repeats this process on its children nodes (if any).
-	void processNode(aiNode *node, const aiScene *scene);
-	Mesh processMesh(aiMesh *mesh, const aiScene *scene);
+	void processNode(aiNode *node, const aiScene *scene, vector<aiMesh*> &order, SceneGraph::NodeId parent);
+	// converts one aiMesh to final vertex and index arrays; no GL and no shared state, runs on worker threads
+	static void processMesh(const aiMesh *mesh, vector<Vertex> &vertices, vector<unsigned int> &indices);
+	// loads the textures of the mesh's material, GL thread only
+	vector<Texture> processMaterial(const aiMesh *mesh, const aiScene *scene);
 	// checks all material textures of a given type and loads the textures if they're not loaded yet.
-	vector<Texture> loadMaterialTextures(aiMaterial *mat, aiTextureType type, string typeName);
+	vector<Texture> loadMaterialTextures(aiMaterial *mat, aiTextureType type, TextureType textureType);
 	//load texture
 	unsigned int TextureFromFile(const char *path, const string &directory);
 
+	StagingUploader *uploader;
+	bool keepCpuData;
+	JobCounter pendingLoads;	// texture decodes still running on the job system
+
 public:
 
 	vector<Texture> textures_loaded;	// stores all the textures loaded so far, optimization to make sure textures aren't loaded more than once.
 	vector<Mesh> meshes;
 	string directory;
+	// node hierarchy of the file: node 0 is the model transform, the Assimp root hangs below it
+	SceneGraph nodes;
+	vector<string> nodeNames;
+	vector<SceneGraph::NodeId> meshNodes;	// node of each mesh
 
-	// constructor, expects a filepath to a 3D model.
-	Model(string const &path);
-	// draws the model, and thus all its meshes
-	void Draw(Shader shader);
+	// constructor, expects a filepath to a 3D model. With an uploader, buffers and textures are streamed in over the next frames.
+	// keepCpuData false frees each mesh's vertex and index arrays once they are uploaded.
+	Model(string const &path, StagingUploader *uploader = nullptr, bool keepCpuData = true);
+	// owns its meshes and textures
+	Model(const Model&) = delete;
+	Model &operator=(const Model&) = delete;
+	~Model();
+	// blocks until every texture is decoded and queued on the uploader; flush the uploader afterwards to have them on the GPU
+	void waitForTextures();
+	// places the whole model, only dirties the root
+	void setTransform(const glm::mat4 &transform);
+	// node with the given name, for moving parts of the model; SceneGraph::NO_PARENT when there is none
+	SceneGraph::NodeId findNode(const string &name) const;
+	// resolves every mesh's material against a program the model will be drawn with, once after loading
+	void prepare(const Shader &shader);
+	// draws the model, and thus all its meshes, each with its node's world transform in the "model" uniform
+	void Draw(const Shader &shader);
 };
 
 
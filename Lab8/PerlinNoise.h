@@ -14,11 +14,13 @@ public:
 	PerlinNoise(unsigned int seed);
 	void setSeed(unsigned int seed);
 	// Get a noise value, for 2D images z can have any value
-	double noise(double x, double y, double z);
+	double noise(double x, double y, double z) const;
+	// Sum of numOctaves octaves, each with double the frequency and half the amplitude, normalized to [0,1]
+	double octaveNoise(double x, double y, int numOctaves, double frequency) const;
 private:
-	double fade(double t);
-	double lerp(double t, double a, double b);
-	double grad(int hash, double x, double y, double z);
+	double fade(double t) const;
+	double lerp(double t, double a, double b) const;
+	double grad(int hash, double x, double y, double z) const;
 };
 
 #endif
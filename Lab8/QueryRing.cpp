@@ -0,0 +1,93 @@
+#include "QueryRing.h"
+
+#include <algorithm>
+#include <cstring>
+
+QueryRing::QueryRing(GLenum targetIn, int depthIn)
+{
+	target = targetIn;
+	depth = std::max(1, std::min(depthIn, MAX_DEPTH));
+	glCreateQueries(target, timestamps() ? depth * 2 : depth, queries);
+	for (int i = 0; i < depth; i++)
+		pending[i] = false;
+	head = 0;
+	tail = 0;
+	active = false;
+	latest = 0;
+	resultCount = 0;
+}
+
+QueryRing::~QueryRing()
+{
+	glDeleteQueries(timestamps() ? depth * 2 : depth, queries);
+}
+
+void QueryRing::begin()
+{
+	poll();
+	// every slot still in flight: drop this measurement instead of waiting for the GPU
+	if (pending[head])
+		return;
+	if (timestamps())
+		glQueryCounter(queries[head * 2], GL_TIMESTAMP);
+	else
+		glBeginQuery(target, queries[head]);
+	active = true;
+}
+
+void QueryRing::end()
+{
+	if (!active)
+		return;
+	if (timestamps())
+		glQueryCounter(queries[head * 2 + 1], GL_TIMESTAMP);
+	else
+		glEndQuery(target);
+	active = false;
+	pending[head] = true;
+	head = (head + 1) % depth;
+}
+
+bool QueryRing::poll()
+{
+	bool updated = false;
+	// results arrive in submission order, stop at the first one that is not ready
+	while (pending[tail])
+	{
+		// the end timestamp is written last, once it is there the start is too
+		GLuint query = timestamps() ? queries[tail * 2 + 1] : queries[tail];
+		GLint available = 0;
+		glGetQueryObjectiv(query, GL_QUERY_RESULT_AVAILABLE, &available);
+		if (!available)
+			break;
+		GLuint64 value = 0;
+		glGetQueryObjectui64v(query, GL_QUERY_RESULT, &value);
+		if (timestamps())
+		{
+			GLuint64 start = 0;
+			glGetQueryObjectui64v(queries[tail * 2], GL_QUERY_RESULT, &start);
+			value -= start;
+		}
+		latest = value;
+		resultCount++;
+		updated = true;
+		pending[tail] = false;
+		tail = (tail + 1) % depth;
+	}
+	return updated;
+}
+
+bool QueryRing::pipelineStatisticsSupported()
+{
+	if (GLVersion.major > 4 || (GLVersion.major == 4 && GLVersion.minor >= 6))
+		return true;
+	GLint count = 0;
+	glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+	for (GLint i = 0; i < count; i++)
+	{
+		const char *name = (const char*)glGetStringi(GL_EXTENSIONS, i);
+		if (name && std::strcmp(name, "GL_ARB_pipeline_statistics_query") == 0)
+			return true;
+	}
+	return false;
+}
@@ -0,0 +1,58 @@
+#pragma once
+#ifndef QUERYRING_H
+#define QUERYRING_H
+
+#include <glad/glad.h>
+
+#include <cstdint>
+
+// not in the 4.5 loader; core in 4.6, GL_ARB_pipeline_statistics_query before that
+#ifndef GL_FRAGMENT_SHADER_INVOCATIONS
+#define GL_FRAGMENT_SHADER_INVOCATIONS 0x82F4
+#endif
+
+// A few query objects of one target used round-robin, so results are read back frames later when the GPU
+// has them instead of stalling on the one just issued. A slot whose result has not arrived yet is skipped
+// rather than waited for. Render thread only.
+// With GL_TIMESTAMP, begin() and end() each write a timestamp and the result is the time between them;
+// unlike GL_TIME_ELAPSED these can enclose other timer queries.
+class QueryRing
+{
+public:
+	explicit QueryRing(GLenum target, int depth = 4);
+	~QueryRing();
+	QueryRing(const QueryRing&) = delete;
+	QueryRing &operator=(const QueryRing&) = delete;
+
+	void begin();
+	void end();
+	// collects the finished results, true when a newer one arrived
+	bool poll();
+
+	// most recent result, in the unit of the query (ns for GL_TIME_ELAPSED and GL_TIMESTAMP)
+	uint64_t getLatest() const { return latest; }
+	bool hasResult() const { return resultCount > 0; }
+	// results collected so far; a changed count means getLatest is a new measurement
+	uint64_t getResultCount() const { return resultCount; }
+	GLenum getTarget() const { return target; }
+
+	// pipeline statistics queries need 4.6 or GL_ARB_pipeline_statistics_query
+	static bool pipelineStatisticsSupported();
+
+	static const int MAX_DEPTH = 8;
+
+private:
+	GLenum target;
+	int depth;
+	GLuint queries[MAX_DEPTH * 2];      // GL_TIMESTAMP: start and end per slot
+	bool pending[MAX_DEPTH];
+	int head;                   // slot of the next begin()
+	int tail;                   // oldest pending slot
+	bool active;                // begin() issued a query that end() has to close
+	uint64_t latest;
+	uint64_t resultCount;
+
+	bool timestamps() const { return target == GL_TIMESTAMP; }
+};
+
+#endif
@@ -0,0 +1,323 @@
+#include "RenderGraph.h"
+#include "RenderState.h"
+
+#include <algorithm>
+#include <iostream>
+
+RenderGraph::Handle RenderGraph::Builder::create(const char *name, const RenderTargetDesc &desc, const glm::vec4 &clearColour)
+{
+	Resource resource;
+	resource.name = name;
+	resource.desc = desc;
+	resource.imported = false;
+	resource.fbo = 0;
+	resource.clearColour = clearColour;
+	resource.firstUse = resource.lastUse = resource.firstWrite = -1;
+	resource.target = nullptr;
+	graph.resources.push_back(resource);
+	Handle handle = graph.addVersion((int)graph.resources.size() - 1, pass, INVALID);
+	graph.passes[pass].writes.push_back(handle);
+	return handle;
+}
+
+RenderGraph::Handle RenderGraph::Builder::read(Handle handle)
+{
+	if (handle == INVALID)
+		return INVALID;
+	graph.passes[pass].reads.push_back(handle);
+	return handle;
+}
+
+RenderGraph::Handle RenderGraph::Builder::write(Handle handle)
+{
+	if (handle == INVALID)
+		return INVALID;
+	Handle next = graph.addVersion(graph.versions[handle].resource, pass, handle);
+	graph.passes[pass].writes.push_back(next);
+	return next;
+}
+
+void RenderGraph::Builder::sideEffect()
+{
+	graph.passes[pass].sideEffect = true;
+}
+
+void RenderGraph::Resources::bind(Handle handle) const
+{
+	const Resource &resource = graph.resourceOf(handle);
+	if (resource.imported)
+	{
+		RenderState::get().bindFramebuffer(resource.fbo);
+		RenderState::get().viewport(0, 0, resource.desc.width, resource.desc.height);
+	}
+	else
+		resource.target->bind();
+}
+
+RenderTarget *RenderGraph::Resources::getTarget(Handle handle) const
+{
+	return graph.resourceOf(handle).target;
+}
+
+GLuint RenderGraph::Resources::getColour(Handle handle, int index) const
+{
+	RenderTarget *target = getTarget(handle);
+	return target ? target->getColour(index) : 0;
+}
+
+GLuint RenderGraph::Resources::getDepth(Handle handle) const
+{
+	RenderTarget *target = getTarget(handle);
+	return target ? target->getDepth() : 0;
+}
+
+RenderGraph::RenderGraph()
+{
+	compiled = false;
+}
+
+RenderGraph::Handle RenderGraph::addVersion(int resource, int producer, Handle previous)
+{
+	versions.push_back({ resource, producer, previous });
+	compiled = false;
+	return (Handle)versions.size() - 1;
+}
+
+RenderGraph::Handle RenderGraph::importFramebuffer(const char *name, GLuint fbo, int width, int height,
+	const glm::vec4 &clearColour)
+{
+	Resource resource;
+	resource.name = name;
+	resource.desc.width = width;
+	resource.desc.height = height;
+	resource.imported = true;
+	resource.fbo = fbo;
+	resource.clearColour = clearColour;
+	resource.firstUse = resource.lastUse = resource.firstWrite = -1;
+	resource.target = nullptr;
+	resources.push_back(resource);
+	return addVersion((int)resources.size() - 1, -1, INVALID);
+}
+
+void RenderGraph::addPass(const char *name, const SetupFunc &setup, const ExecuteFunc &execute)
+{
+	Pass pass;
+	pass.name = name;
+	pass.execute = execute;
+	pass.sideEffect = false;
+	pass.alive = false;
+	passes.push_back(pass);
+	Builder builder(*this, (int)passes.size() - 1);
+	setup(builder);
+	compiled = false;
+}
+
+bool RenderGraph::compile()
+{
+	const int passCount = (int)passes.size();
+
+	// culling: start from the passes with visible results and walk back to everything they depend on
+	std::vector<int> stack;
+	for (int p = 0; p < passCount; p++)
+	{
+		Pass &pass = passes[p];
+		pass.alive = pass.sideEffect;
+		for (Handle handle : pass.writes)
+			if (resourceOf(handle).imported)
+				pass.alive = true;
+		if (pass.alive)
+			stack.push_back(p);
+	}
+	while (!stack.empty())
+	{
+		Pass &pass = passes[stack.back()];
+		stack.pop_back();
+		std::vector<Handle> inputs = pass.reads;
+		for (Handle handle : pass.writes)
+			if (versions[handle].previous != INVALID)
+				inputs.push_back(versions[handle].previous);
+		for (Handle handle : inputs)
+		{
+			int producer = versions[handle].producer;
+			if (producer >= 0 && !passes[producer].alive)
+			{
+				passes[producer].alive = true;
+				stack.push_back(producer);
+			}
+		}
+	}
+
+	// dependencies: a pass runs after the writers of what it reads, and a write runs after the writer
+	// and the readers of the version it replaces
+	std::vector<std::vector<int>> readers(versions.size());
+	for (int p = 0; p < passCount; p++)
+		if (passes[p].alive)
+			for (Handle handle : passes[p].reads)
+				readers[handle].push_back(p);
+
+	std::vector<std::vector<int>> dependents(passCount);
+	std::vector<int> waiting(passCount, 0);
+	auto addEdge = [&](int from, int to)
+	{
+		if (from < 0 || from == to || !passes[from].alive)
+			return;
+		dependents[from].push_back(to);
+		waiting[to]++;
+	};
+	for (int p = 0; p < passCount; p++)
+	{
+		if (!passes[p].alive)
+			continue;
+		for (Handle handle : passes[p].reads)
+			addEdge(versions[handle].producer, p);
+		for (Handle handle : passes[p].writes)
+		{
+			Handle previous = versions[handle].previous;
+			if (previous == INVALID)
+				continue;
+			addEdge(versions[previous].producer, p);
+			for (int reader : readers[previous])
+				addEdge(reader, p);
+		}
+	}
+
+	// topological order; among ready passes the one declared first goes first, so the order stays stable
+	order.clear();
+	std::vector<int> ready;
+	for (int p = 0; p < passCount; p++)
+		if (passes[p].alive && waiting[p] == 0)
+			ready.push_back(p);
+	while (!ready.empty())
+	{
+		std::vector<int>::iterator first = std::min_element(ready.begin(), ready.end());
+		int p = *first;
+		ready.erase(first);
+		order.push_back(p);
+		for (int next : dependents[p])
+			if (--waiting[next] == 0)
+				ready.push_back(next);
+	}
+	size_t aliveCount = std::count_if(passes.begin(), passes.end(), [](const Pass &pass) { return pass.alive; });
+	if (order.size() != aliveCount)
+	{
+		std::cout << "ERROR::RENDERGRAPH:: dependency cycle between passes" << std::endl;
+		order.clear();
+		return false;
+	}
+
+	// lifetimes
+	for (Resource &resource : resources)
+		resource.firstUse = resource.lastUse = resource.firstWrite = -1;
+	for (int i = 0; i < (int)order.size(); i++)
+	{
+		const Pass &pass = passes[order[i]];
+		for (Handle handle : pass.reads)
+		{
+			Resource &resource = resources[versions[handle].resource];
+			if (resource.firstUse < 0)
+				resource.firstUse = i;
+			resource.lastUse = i;
+		}
+		for (Handle handle : pass.writes)
+		{
+			Resource &resource = resources[versions[handle].resource];
+			if (resource.firstUse < 0)
+				resource.firstUse = i;
+			if (resource.firstWrite < 0)
+				resource.firstWrite = i;
+			resource.lastUse = i;
+		}
+	}
+	acquireAt.assign(order.size(), std::vector<int>());
+	releaseAt.assign(order.size(), std::vector<int>());
+	for (int r = 0; r < (int)resources.size(); r++)
+	{
+		const Resource &resource = resources[r];
+		if (resource.imported || resource.firstUse < 0)
+			continue;
+		acquireAt[resource.firstUse].push_back(r);
+		releaseAt[resource.lastUse].push_back(r);
+	}
+
+	compiled = true;
+	return true;
+}
+
+void RenderGraph::clearResource(const Resource &resource) const
+{
+	// clears obey the write masks
+	RenderState &state = RenderState::get();
+	state.colorMask(true);
+	state.depthMask(true);
+	state.disable(GL_SCISSOR_TEST);
+
+	GLuint fbo = resource.imported ? resource.fbo : resource.target->getFramebuffer();
+	size_t colourCount = resource.imported ? 1 : resource.desc.colour.size();
+	for (size_t i = 0; i < colourCount; i++)
+		glClearNamedFramebufferfv(fbo, GL_COLOR, (GLint)i, &resource.clearColour[0]);
+
+	GLenum depthFormat = resource.desc.depth.internalFormat;
+	if (depthFormat == GL_DEPTH24_STENCIL8 || depthFormat == GL_DEPTH32F_STENCIL8)
+		glClearNamedFramebufferfi(fbo, GL_DEPTH_STENCIL, 0, 1.0f, 0);
+	else if (depthFormat != GL_NONE || resource.imported)
+	{
+		const float depth = 1.0f;
+		glClearNamedFramebufferfv(fbo, GL_DEPTH, 0, &depth);
+	}
+}
+
+void RenderGraph::execute(RenderTargetPool &pool)
+{
+	if (!compiled && !compile())
+		return;
+
+	Resources view(*this);
+	for (size_t i = 0; i < order.size(); i++)
+	{
+		for (int r : acquireAt[i])
+			resources[r].target = pool.acquire(resources[r].desc);
+
+		const Pass &pass = passes[order[i]];
+		bool missing = false;
+		for (Handle handle : pass.writes)
+		{
+			Resource &resource = resources[versions[handle].resource];
+			if (!resource.imported && !resource.target)
+				missing = true;
+			else if (resource.firstWrite == (int)i)
+				clearResource(resource);
+		}
+		if (!missing)
+			pass.execute(view);
+
+		for (int r : releaseAt[i])
+		{
+			if (resources[r].target)
+				pool.release(resources[r].target);
+			resources[r].target = nullptr;
+		}
+	}
+}
+
+void RenderGraph::clear()
+{
+	resources.clear();
+	versions.clear();
+	passes.clear();
+	order.clear();
+	acquireAt.clear();
+	releaseAt.clear();
+	compiled = false;
+}
+
+void RenderGraph::printOrder() const
+{
+	for (size_t i = 0; i < order.size(); i++)
+		std::cout << i << ": " << passes[order[i]].name << std::endl;
+	for (const Pass &pass : passes)
+		if (!pass.alive)
+			std::cout << "culled: " << pass.name << std::endl;
+	for (const Resource &resource : resources)
+		if (!resource.imported && resource.firstUse >= 0)
+			std::cout << resource.name << " lives " << resource.firstUse << ".." << resource.lastUse << std::endl;
+}
@@ -0,0 +1,127 @@
+#pragma once
+#ifndef RENDERGRAPH_H
+#define RENDERGRAPH_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "RenderTarget.h"
+
+// Frame described as passes that read and write named resources instead of a hand-written sequence.
+// compile() drops the passes whose output nobody uses, orders the rest by their dependencies and works out
+// how long every transient target lives. execute() takes each transient target from the pool right before its
+// first use and gives it back right after its last use, so passes with disjoint lifetimes share one target
+// whenever their descriptions match. A transient is cleared once, by its first writer.
+//
+// Resources are versioned: write() returns a new handle, and a pass reading that handle runs after the writer.
+// Build and compile once; execute() every frame makes no allocations.
+class RenderGraph
+{
+public:
+	typedef int Handle;                     // one version of a resource
+	static const Handle INVALID = -1;
+
+	class Builder
+	{
+	public:
+		// new transient target written by this pass, its first writer clears the colour attachments to
+		// clearColour and the depth to 1
+		Handle create(const char *name, const RenderTargetDesc &desc, const glm::vec4 &clearColour = glm::vec4(0.0f));
+		Handle read(Handle handle);
+		Handle write(Handle handle);
+		// keeps the pass even when nothing reads what it writes
+		void sideEffect();
+
+	private:
+		friend class RenderGraph;
+		Builder(RenderGraph &graph, int pass) : graph(graph), pass(pass) {}
+		RenderGraph &graph;
+		int pass;
+	};
+
+	// what a pass sees while it executes
+	class Resources
+	{
+	public:
+		// binds the framebuffer of the resource and sets the viewport to it
+		void bind(Handle handle) const;
+		RenderTarget *getTarget(Handle handle) const;
+		GLuint getColour(Handle handle, int index = 0) const;
+		GLuint getDepth(Handle handle) const;
+
+	private:
+		friend class RenderGraph;
+		explicit Resources(const RenderGraph &graph) : graph(graph) {}
+		const RenderGraph &graph;
+	};
+
+	typedef std::function<void(Builder&)> SetupFunc;
+	typedef std::function<void(const Resources&)> ExecuteFunc;
+
+	RenderGraph();
+
+	// a framebuffer that lives outside the graph, 0 for the default one; writing it keeps the pass alive.
+	// The first pass writing it in a frame clears it to clearColour
+	Handle importFramebuffer(const char *name, GLuint fbo, int width, int height,
+		const glm::vec4 &clearColour = glm::vec4(0.0f));
+	void addPass(const char *name, const SetupFunc &setup, const ExecuteFunc &execute);
+
+	// false when the dependencies have a cycle
+	bool compile();
+	void execute(RenderTargetPool &pool);
+	void clear();
+
+	// passes in execution order after culling
+	size_t getPassCount() const { return passes.size(); }
+	size_t getExecutedCount() const { return order.size(); }
+	const std::string &getPassName(int pass) const { return passes[pass].name; }
+	void printOrder() const;
+
+private:
+	struct Resource
+	{
+		std::string name;
+		RenderTargetDesc desc;
+		bool imported;
+		GLuint fbo;                         // imported only
+		glm::vec4 clearColour;
+		int firstUse, lastUse;              // positions in order, -1 when unused
+		int firstWrite;                     // position of the pass that clears it
+		RenderTarget *target;               // transient only, valid while executing
+	};
+
+	struct Version
+	{
+		int resource;
+		int producer;                       // pass that wrote this version, -1 for imports
+		Handle previous;                    // version this one overwrote, INVALID for the first one
+	};
+
+	struct Pass
+	{
+		std::string name;
+		ExecuteFunc execute;
+		std::vector<Handle> reads;
+		std::vector<Handle> writes;
+		bool sideEffect;
+		bool alive;
+	};
+
+	std::vector<Resource> resources;
+	std::vector<Version> versions;
+	std::vector<Pass> passes;
+	std::vector<int> order;
+	// per position in order: transients to acquire before and release after the pass
+	std::vector<std::vector<int>> acquireAt, releaseAt;
+	bool compiled;
+
+	Handle addVersion(int resource, int producer, Handle previous);
+	const Resource &resourceOf(Handle handle) const { return resources[versions[handle].resource]; }
+	void clearResource(const Resource &resource) const;
+};
+
+#endif
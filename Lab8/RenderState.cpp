@@ -0,0 +1,205 @@
+#include "RenderState.h"
+
+RenderState::RenderState()
+{
+	issued = 0;
+	skipped = 0;
+	invalidate();
+}
+
+RenderState &RenderState::get()
+{
+	static RenderState state;
+	return state;
+}
+
+void RenderState::invalidate()
+{
+	program = UNKNOWN;
+	vao = UNKNOWN;
+	framebuffer = UNKNOWN;
+	for (int i = 0; i < MAX_TEXTURE_UNITS; i++)
+	{
+		textures[i] = UNKNOWN;
+		samplers[i] = UNKNOWN;
+	}
+	for (int i = 0; i < CAP_COUNT; i++)
+		caps[i] = UNKNOWN;
+	polygon = UNKNOWN;
+	depth = UNKNOWN;
+	depthWrite = UNKNOWN;
+	colorWrite = UNKNOWN;
+	cull = UNKNOWN;
+	blendSrc = UNKNOWN;
+	blendDst = UNKNOWN;
+	viewKnown = false;
+}
+
+void RenderState::forgetVertexArray(GLuint value)
+{
+	if (vao == value)
+		vao = UNKNOWN;
+}
+
+void RenderState::forgetTexture(GLuint texture)
+{
+	for (int i = 0; i < MAX_TEXTURE_UNITS; i++)
+		if (textures[i] == texture)
+			textures[i] = UNKNOWN;
+}
+
+void RenderState::forgetFramebuffer(GLuint fbo)
+{
+	if (framebuffer == fbo)
+		framebuffer = UNKNOWN;
+}
+
+bool RenderState::change(GLuint &cached, GLuint value)
+{
+	if (cached == value)
+	{
+		skipped++;
+		return false;
+	}
+	cached = value;
+	issued++;
+	return true;
+}
+
+int RenderState::capIndex(GLenum cap)
+{
+	switch (cap)
+	{
+	case GL_DEPTH_TEST: return CAP_DEPTH_TEST;
+	case GL_CULL_FACE: return CAP_CULL_FACE;
+	case GL_BLEND: return CAP_BLEND;
+	case GL_SCISSOR_TEST: return CAP_SCISSOR_TEST;
+	case GL_STENCIL_TEST: return CAP_STENCIL_TEST;
+	case GL_POLYGON_OFFSET_FILL: return CAP_POLYGON_OFFSET_FILL;
+	case GL_FRAMEBUFFER_SRGB: return CAP_FRAMEBUFFER_SRGB;
+	default: return CAP_UNTRACKED;
+	}
+}
+
+void RenderState::useProgram(GLuint value)
+{
+	if (change(program, value))
+		glUseProgram(value);
+}
+
+void RenderState::bindVertexArray(GLuint value)
+{
+	if (change(vao, value))
+		glBindVertexArray(value);
+}
+
+void RenderState::bindTexture(GLuint unit, GLuint texture)
+{
+	if (unit >= MAX_TEXTURE_UNITS)
+	{
+		issued++;
+		glBindTextureUnit(unit, texture);
+	}
+	else if (change(textures[unit], texture))
+		glBindTextureUnit(unit, texture);
+}
+
+void RenderState::bindSampler(GLuint unit, GLuint sampler)
+{
+	if (unit >= MAX_TEXTURE_UNITS)
+	{
+		issued++;
+		glBindSampler(unit, sampler);
+	}
+	else if (change(samplers[unit], sampler))
+		glBindSampler(unit, sampler);
+}
+
+void RenderState::bindFramebuffer(GLuint value)
+{
+	if (change(framebuffer, value))
+		glBindFramebuffer(GL_FRAMEBUFFER, value);
+}
+
+void RenderState::setEnabled(GLenum cap, bool enabled)
+{
+	int index = capIndex(cap);
+	if (index == CAP_UNTRACKED)
+		issued++;
+	else if (!change(caps[index], enabled ? 1 : 0))
+		return;
+	if (enabled)
+		glEnable(cap);
+	else
+		glDisable(cap);
+}
+
+void RenderState::enable(GLenum cap)
+{
+	setEnabled(cap, true);
+}
+
+void RenderState::disable(GLenum cap)
+{
+	setEnabled(cap, false);
+}
+
+void RenderState::polygonMode(GLenum mode)
+{
+	if (change(polygon, mode))
+		glPolygonMode(GL_FRONT_AND_BACK, mode);
+}
+
+void RenderState::depthFunc(GLenum func)
+{
+	if (change(depth, func))
+		glDepthFunc(func);
+}
+
+void RenderState::depthMask(bool write)
+{
+	if (change(depthWrite, write ? 1 : 0))
+		glDepthMask(write ? GL_TRUE : GL_FALSE);
+}
+
+void RenderState::colorMask(bool write)
+{
+	GLboolean value = write ? GL_TRUE : GL_FALSE;
+	if (change(colorWrite, write ? 1 : 0))
+		glColorMask(value, value, value, value);
+}
+
+void RenderState::cullFace(GLenum face)
+{
+	if (change(cull, face))
+		glCullFace(face);
+}
+
+void RenderState::blendFunc(GLenum src, GLenum dst)
+{
+	if (blendSrc == src && blendDst == dst)
+	{
+		skipped++;
+		return;
+	}
+	blendSrc = src;
+	blendDst = dst;
+	issued++;
+	glBlendFunc(src, dst);
+}
+
+void RenderState::viewport(GLint x, GLint y, GLsizei width, GLsizei height)
+{
+	if (viewKnown && view[0] == x && view[1] == y && view[2] == width && view[3] == height)
+	{
+		skipped++;
+		return;
+	}
+	view[0] = x;
+	view[1] = y;
+	view[2] = width;
+	view[3] = height;
+	viewKnown = true;
+	issued++;
+	glViewport(x, y, width, height);
+}
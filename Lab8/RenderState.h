@@ -0,0 +1,79 @@
+#pragma once
+#ifndef RENDERSTATE_H
+#define RENDERSTATE_H
+
+#include <glad/glad.h>
+
+#include <cstdint>
+
+// Shadow copy of the GL state the renderer touches. Every setter compares against the last value it issued
+// and skips the driver call when nothing would change.
+// Code that changes the same state with raw GL calls has to call invalidate() afterwards, otherwise the
+// cache would skip calls that are actually needed. Render thread only.
+class RenderState
+{
+public:
+	static RenderState &get();
+
+	void useProgram(GLuint program);
+	void bindVertexArray(GLuint vao);
+	// DSA binding, no active-unit juggling: glBindTextureUnit
+	void bindTexture(GLuint unit, GLuint texture);
+	void bindSampler(GLuint unit, GLuint sampler);
+	void bindFramebuffer(GLuint fbo);
+	void enable(GLenum cap);
+	void disable(GLenum cap);
+	void setEnabled(GLenum cap, bool enabled);
+	void polygonMode(GLenum mode);              // GL_FRONT_AND_BACK
+	void depthFunc(GLenum func);
+	void depthMask(bool write);
+	void colorMask(bool write);
+	void cullFace(GLenum face);
+	void blendFunc(GLenum src, GLenum dst);
+	void viewport(GLint x, GLint y, GLsizei width, GLsizei height);
+
+	// forget everything, the next call of every setter goes to the driver
+	void invalidate();
+	// call before deleting an object: GL unbinds deleted objects, and the name may come back from glGen*
+	void forgetVertexArray(GLuint vao);
+	void forgetTexture(GLuint texture);
+	void forgetFramebuffer(GLuint fbo);
+
+	uint64_t getIssued() const { return issued; }
+	uint64_t getSkipped() const { return skipped; }
+	void resetStats() { issued = 0; skipped = 0; }
+
+	static const int MAX_TEXTURE_UNITS = 32;
+
+private:
+	RenderState();
+
+	enum Cap { CAP_DEPTH_TEST, CAP_CULL_FACE, CAP_BLEND, CAP_SCISSOR_TEST, CAP_STENCIL_TEST, CAP_POLYGON_OFFSET_FILL,
+		CAP_FRAMEBUFFER_SRGB, CAP_COUNT, CAP_UNTRACKED = CAP_COUNT };
+	static int capIndex(GLenum cap);
+
+	// UNKNOWN never matches a real value, so the first call after invalidate() is always issued
+	static const GLuint UNKNOWN = 0xFFFFFFFFu;
+	GLuint program;
+	GLuint vao;
+	GLuint framebuffer;
+	GLuint textures[MAX_TEXTURE_UNITS];
+	GLuint samplers[MAX_TEXTURE_UNITS];
+	GLuint caps[CAP_COUNT];                     // 0, 1 or UNKNOWN
+	GLuint polygon;
+	GLuint depth;
+	GLuint depthWrite;
+	GLuint colorWrite;
+	GLuint cull;
+	GLuint blendSrc, blendDst;
+	GLint view[4];
+	bool viewKnown;
+
+	uint64_t issued;
+	uint64_t skipped;
+
+	// true when the call has to be issued, and counts it either way
+	bool change(GLuint &cached, GLuint value);
+};
+
+#endif
@@ -0,0 +1,222 @@
+#include "RenderTarget.h"
+#include "RenderState.h"
+
+#include <iostream>
+
+bool AttachmentDesc::operator==(const AttachmentDesc &other) const
+{
+	return internalFormat == other.internalFormat && sampled == other.sampled && filter == other.filter
+		&& wrap == other.wrap && border == other.border;
+}
+
+bool RenderTargetDesc::operator==(const RenderTargetDesc &other) const
+{
+	return width == other.width && height == other.height && colour == other.colour && depth == other.depth;
+}
+
+RenderTarget::RenderTarget()
+{
+	fbo = 0;
+	depth = 0;
+}
+
+RenderTarget::RenderTarget(const RenderTargetDesc &desc)
+{
+	fbo = 0;
+	depth = 0;
+	create(desc);
+}
+
+RenderTarget::~RenderTarget()
+{
+	release();
+}
+
+RenderTarget::RenderTarget(RenderTarget &&other) noexcept
+	: desc(std::move(other.desc)), colour(std::move(other.colour))
+{
+	fbo = other.fbo;
+	depth = other.depth;
+	other.fbo = 0;
+	other.depth = 0;
+	other.colour.clear();
+}
+
+RenderTarget &RenderTarget::operator=(RenderTarget &&other) noexcept
+{
+	if (this != &other)
+	{
+		release();
+		desc = std::move(other.desc);
+		colour = std::move(other.colour);
+		fbo = other.fbo;
+		depth = other.depth;
+		other.fbo = 0;
+		other.depth = 0;
+		other.colour.clear();
+	}
+	return *this;
+}
+
+GLuint RenderTarget::createAttachment(const AttachmentDesc &attachment, GLenum point)
+{
+	GLuint name;
+	if (attachment.sampled)
+	{
+		glCreateTextures(GL_TEXTURE_2D, 1, &name);
+		glTextureStorage2D(name, 1, attachment.internalFormat, desc.width, desc.height);
+		glTextureParameteri(name, GL_TEXTURE_MIN_FILTER, attachment.filter);
+		glTextureParameteri(name, GL_TEXTURE_MAG_FILTER, attachment.filter);
+		glTextureParameteri(name, GL_TEXTURE_WRAP_S, attachment.wrap);
+		glTextureParameteri(name, GL_TEXTURE_WRAP_T, attachment.wrap);
+		if (attachment.wrap == GL_CLAMP_TO_BORDER)
+			glTextureParameterfv(name, GL_TEXTURE_BORDER_COLOR, &attachment.border[0]);
+		glNamedFramebufferTexture(fbo, point, name, 0);
+	}
+	else
+	{
+		glCreateRenderbuffers(1, &name);
+		glNamedRenderbufferStorage(name, attachment.internalFormat, desc.width, desc.height);
+		glNamedFramebufferRenderbuffer(fbo, point, GL_RENDERBUFFER, name);
+	}
+	return name;
+}
+
+void RenderTarget::deleteAttachment(const AttachmentDesc &attachment, GLuint name)
+{
+	if (!name)
+		return;
+	if (attachment.sampled)
+	{
+		RenderState::get().forgetTexture(name);
+		glDeleteTextures(1, &name);
+	}
+	else
+		glDeleteRenderbuffers(1, &name);
+}
+
+bool RenderTarget::create(const RenderTargetDesc &descIn)
+{
+	release();
+	desc = descIn;
+	glCreateFramebuffers(1, &fbo);
+
+	std::vector<GLenum> drawBuffers;
+	for (size_t i = 0; i < desc.colour.size(); i++)
+	{
+		colour.push_back(createAttachment(desc.colour[i], GL_COLOR_ATTACHMENT0 + (GLenum)i));
+		drawBuffers.push_back(GL_COLOR_ATTACHMENT0 + (GLenum)i);
+	}
+	if (desc.depth.internalFormat != GL_NONE)
+	{
+		bool hasStencil = desc.depth.internalFormat == GL_DEPTH24_STENCIL8 || desc.depth.internalFormat == GL_DEPTH32F_STENCIL8;
+		depth = createAttachment(desc.depth, hasStencil ? GL_DEPTH_STENCIL_ATTACHMENT : GL_DEPTH_ATTACHMENT);
+	}
+
+	// depth-only targets read and write no colour
+	if (drawBuffers.empty())
+	{
+		glNamedFramebufferDrawBuffer(fbo, GL_NONE);
+		glNamedFramebufferReadBuffer(fbo, GL_NONE);
+	}
+	else
+		glNamedFramebufferDrawBuffers(fbo, (GLsizei)drawBuffers.size(), drawBuffers.data());
+
+	GLenum status = glCheckNamedFramebufferStatus(fbo, GL_FRAMEBUFFER);
+	if (status != GL_FRAMEBUFFER_COMPLETE)
+	{
+		std::cout << "ERROR::FRAMEBUFFER:: Framebuffer is not complete! status 0x" << std::hex << status << std::dec
+			<< " (" << desc.width << "x" << desc.height << ")" << std::endl;
+		release();
+		return false;
+	}
+	return true;
+}
+
+bool RenderTarget::resize(int width, int height)
+{
+	if (width == desc.width && height == desc.height && fbo)
+		return true;
+	RenderTargetDesc resized = desc;
+	resized.width = width;
+	resized.height = height;
+	return create(resized);
+}
+
+void RenderTarget::release()
+{
+	for (size_t i = 0; i < colour.size(); i++)
+		deleteAttachment(desc.colour[i], colour[i]);
+	colour.clear();
+	deleteAttachment(desc.depth, depth);
+	depth = 0;
+	if (fbo)
+	{
+		RenderState::get().forgetFramebuffer(fbo);
+		glDeleteFramebuffers(1, &fbo);
+		fbo = 0;
+	}
+}
+
+void RenderTarget::bind() const
+{
+	RenderState::get().bindFramebuffer(fbo);
+	RenderState::get().viewport(0, 0, desc.width, desc.height);
+}
+
+RenderTargetPool::RenderTargetPool(int framesToKeepIn)
+{
+	framesToKeep = framesToKeepIn;
+	created = 0;
+}
+
+RenderTarget *RenderTargetPool::acquire(const RenderTargetDesc &desc)
+{
+	for (Entry &entry : entries)
+	{
+		if (!entry.inUse && entry.target->getDesc() == desc)
+		{
+			entry.inUse = true;
+			entry.idleFrames = 0;
+			return entry.target.get();
+		}
+	}
+	std::unique_ptr<RenderTarget> target(new RenderTarget(desc));
+	if (!target->isValid())
+		return nullptr;
+	created++;
+	entries.push_back({ std::move(target), true, 0 });
+	return entries.back().target.get();
+}
+
+void RenderTargetPool::release(RenderTarget *target)
+{
+	for (Entry &entry : entries)
+	{
+		if (entry.target.get() == target)
+		{
+			entry.inUse = false;
+			return;
+		}
+	}
+}
+
+void RenderTargetPool::endFrame()
+{
+	for (size_t i = 0; i < entries.size();)
+	{
+		Entry &entry = entries[i];
+		if (!entry.inUse && ++entry.idleFrames > framesToKeep)
+		{
+			entries[i] = std::move(entries.back());
+			entries.pop_back();
+		}
+		else
+			i++;
+	}
+}
+
+void RenderTargetPool::clear()
+{
+	entries.clear();
+}
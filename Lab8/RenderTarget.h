@@ -0,0 +1,101 @@
+#pragma once
+#ifndef RENDERTARGET_H
+#define RENDERTARGET_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <memory>
+#include <vector>
+
+// one attachment of a render target; a sampled attachment is a texture, otherwise a renderbuffer
+struct AttachmentDesc
+{
+	GLenum internalFormat = GL_NONE;        // GL_NONE - no attachment
+	bool sampled = true;
+	GLenum filter = GL_LINEAR;
+	GLenum wrap = GL_CLAMP_TO_EDGE;
+	glm::vec4 border = glm::vec4(0.0f);     // used with GL_CLAMP_TO_BORDER
+
+	bool operator==(const AttachmentDesc &other) const;
+};
+
+struct RenderTargetDesc
+{
+	int width = 0;
+	int height = 0;
+	std::vector<AttachmentDesc> colour;
+	AttachmentDesc depth;                   // depth or depth-stencil format
+
+	bool operator==(const RenderTargetDesc &other) const;
+};
+
+// Framebuffer that owns its attachments; move-only, deletes everything it created
+class RenderTarget
+{
+public:
+	RenderTarget();
+	explicit RenderTarget(const RenderTargetDesc &desc);
+	~RenderTarget();
+	RenderTarget(RenderTarget &&other) noexcept;
+	RenderTarget &operator=(RenderTarget &&other) noexcept;
+	RenderTarget(const RenderTarget&) = delete;
+	RenderTarget &operator=(const RenderTarget&) = delete;
+
+	// (re)creates the framebuffer and its attachments, false when it is not complete
+	bool create(const RenderTargetDesc &desc);
+	// recreates the attachments at the new size, a no-op when the size is unchanged
+	bool resize(int width, int height);
+	void release();
+
+	// binds the framebuffer and sets the viewport to the whole target
+	void bind() const;
+
+	bool isValid() const { return fbo != 0; }
+	GLuint getFramebuffer() const { return fbo; }
+	GLuint getColour(int index = 0) const { return colour[index]; }
+	GLuint getDepth() const { return depth; }
+	int getWidth() const { return desc.width; }
+	int getHeight() const { return desc.height; }
+	const RenderTargetDesc &getDesc() const { return desc; }
+
+private:
+	RenderTargetDesc desc;
+	GLuint fbo;
+	std::vector<GLuint> colour;
+	GLuint depth;
+
+	GLuint createAttachment(const AttachmentDesc &attachment, GLenum point);
+	void deleteAttachment(const AttachmentDesc &attachment, GLuint name);
+};
+
+// Hands out render targets by description and recycles them: a pass that needs a target with the same
+// shape as one released earlier gets that one back instead of a new allocation.
+// Targets nobody asked for during framesToKeep frames are deleted.
+class RenderTargetPool
+{
+public:
+	explicit RenderTargetPool(int framesToKeep = 3);
+
+	RenderTarget *acquire(const RenderTargetDesc &desc);
+	void release(RenderTarget *target);
+	// once per frame: ages the free targets and deletes the stale ones
+	void endFrame();
+	void clear();
+
+	size_t getTargetCount() const { return entries.size(); }
+	size_t getCreatedCount() const { return created; }
+
+private:
+	struct Entry
+	{
+		std::unique_ptr<RenderTarget> target;
+		bool inUse;
+		int idleFrames;
+	};
+	std::vector<Entry> entries;
+	int framesToKeep;
+	size_t created;
+};
+
+#endif
@@ -0,0 +1,67 @@
+#pragma once
+#ifndef RINGBUFFER_H
+#define RINGBUFFER_H
+
+#include <glad/glad.h>
+
+#include <cstddef>
+
+// One persistently mapped, coherent buffer split into a region per frame in flight.
+// Per-frame data (uniform blocks, streamed vertices and indices) is written straight into the
+// mapping: no glMap/glUnmap, no orphaning. Every region gets a fence when its frame is submitted and is
+// reused only once that fence has signalled, so the CPU never overwrites data the GPU still reads.
+// Sub-allocations are aligned for glBindBufferRange on uniform and shader storage buffers.
+class RingBuffer
+{
+public:
+	struct Allocation
+	{
+		void* data;         // CPU pointer into the mapping, nullptr when the frame's region is full
+		GLintptr offset;    // offset in the buffer, for glBindBufferRange or as a draw parameter
+		GLsizeiptr size;
+	};
+
+	RingBuffer(GLsizeiptr frameSize, int frames = 3);
+	~RingBuffer();
+	RingBuffer(const RingBuffer&) = delete;
+	RingBuffer& operator=(const RingBuffer&) = delete;
+
+	// starts writing into the next region, waiting for the GPU only if it is still reading it
+	void beginFrame();
+	// fences the region written this frame; call after the frame's last draw
+	void endFrame();
+
+	Allocation allocate(GLsizeiptr size);
+	template<typename T>
+	T* allocate(GLintptr& offset)
+	{
+		Allocation allocation = allocate(sizeof(T));
+		offset = allocation.offset;
+		return static_cast<T*>(allocation.data);
+	}
+	// copies and binds in one go, false when the region is full
+	bool bindRange(GLenum target, GLuint index, const void* data, GLsizeiptr size);
+
+	GLuint getBuffer() const { return buffer; }
+	GLsizeiptr getFrameSize() const { return frameSize; }
+	GLsizeiptr getUsed() const { return head - regionStart(); }
+	// frames in which beginFrame had to wait for the GPU
+	size_t getStallCount() const { return stalls; }
+
+	static const int MAX_FRAMES = 4;
+
+private:
+	GLuint buffer;
+	unsigned char* mapped;
+	GLsizeiptr frameSize;
+	GLsizeiptr alignment;
+	int frames;
+	int frame;              // region being written
+	GLintptr head;          // next free byte of that region
+	GLsync fences[MAX_FRAMES];
+	size_t stalls;
+
+	GLintptr regionStart() const { return (GLintptr)frame * frameSize; }
+};
+
+#endif
@@ -0,0 +1,102 @@
+#include "SceneGraph.h"
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define SCENEGRAPH_SSE
+#include <xmmintrin.h>
+#endif
+
+void multiplyMat4(const glm::mat4 &a, const glm::mat4 &b, glm::mat4 &out)
+{
+#ifdef SCENEGRAPH_SSE
+	// every result column is a linear combination of the columns of a
+	const float *pa = &a[0][0];
+	const float *pb = &b[0][0];
+	float *po = &out[0][0];
+	__m128 a0 = _mm_loadu_ps(pa);
+	__m128 a1 = _mm_loadu_ps(pa + 4);
+	__m128 a2 = _mm_loadu_ps(pa + 8);
+	__m128 a3 = _mm_loadu_ps(pa + 12);
+	for (int c = 0; c < 4; c++)
+	{
+		const float *col = pb + c * 4;
+		__m128 r = _mm_mul_ps(a0, _mm_set1_ps(col[0]));
+		r = _mm_add_ps(r, _mm_mul_ps(a1, _mm_set1_ps(col[1])));
+		r = _mm_add_ps(r, _mm_mul_ps(a2, _mm_set1_ps(col[2])));
+		r = _mm_add_ps(r, _mm_mul_ps(a3, _mm_set1_ps(col[3])));
+		_mm_storeu_ps(po + c * 4, r);
+	}
+#else
+	out = a * b;
+#endif
+}
+
+SceneGraph::SceneGraph()
+{
+	firstDirty = 0;
+	updatedLastFrame = 0;
+}
+
+SceneGraph::NodeId SceneGraph::addNode(NodeId parent, const glm::mat4 &local)
+{
+	NodeId node = (NodeId)parents.size();
+	// parents always come first, that is what makes the single update pass correct
+	if (parent >= node)
+		parent = NO_PARENT;
+	parents.push_back(parent);
+	locals.push_back(local);
+	worlds.push_back(local);
+	dirty.push_back(1);
+	firstDirty = std::min(firstDirty, (size_t)node);
+	return node;
+}
+
+void SceneGraph::reserve(size_t count)
+{
+	parents.reserve(count);
+	locals.reserve(count);
+	worlds.reserve(count);
+	dirty.reserve(count);
+}
+
+void SceneGraph::clear()
+{
+	parents.clear();
+	locals.clear();
+	worlds.clear();
+	dirty.clear();
+	firstDirty = 0;
+}
+
+void SceneGraph::setLocal(NodeId node, const glm::mat4 &local)
+{
+	locals[node] = local;
+	dirty[node] = 1;
+	firstDirty = std::min(firstDirty, (size_t)node);
+}
+
+void SceneGraph::update()
+{
+	const size_t count = parents.size();
+	size_t updated = 0;
+	for (size_t i = firstDirty; i < count; i++)
+	{
+		NodeId parent = parents[i];
+		// the parent was visited already, so its flag says whether its world matrix changed this pass
+		if (parent != NO_PARENT)
+			dirty[i] |= dirty[parent];
+		if (!dirty[i])
+			continue;
+		if (parent == NO_PARENT)
+			worlds[i] = locals[i];
+		else
+			multiplyMat4(worlds[parent], locals[i], worlds[i]);
+		updated++;
+	}
+	if (firstDirty < count)
+		std::memset(dirty.data() + firstDirty, 0, count - firstDirty);
+	firstDirty = count;
+	updatedLastFrame = updated;
+}
@@ -0,0 +1,49 @@
+#pragma once
+#ifndef SCENEGRAPH_H
+#define SCENEGRAPH_H
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+// Transform hierarchy stored as structure of arrays.
+// A node can only be added under an existing node, so every parent sits before its children and one
+// front-to-back pass updates the whole graph: a node is recomputed when it or its parent was recomputed.
+// Only nodes from the first dirty one on are visited, and clean nodes cost a flag test.
+class SceneGraph
+{
+public:
+	typedef int NodeId;
+	static const NodeId NO_PARENT = -1;
+
+	SceneGraph();
+
+	NodeId addNode(NodeId parent, const glm::mat4 &local);
+	void reserve(size_t count);
+	void clear();
+
+	void setLocal(NodeId node, const glm::mat4 &local);
+	const glm::mat4 &getLocal(NodeId node) const { return locals[node]; }
+	// valid after update()
+	const glm::mat4 &getWorld(NodeId node) const { return worlds[node]; }
+	NodeId getParent(NodeId node) const { return parents[node]; }
+	size_t size() const { return parents.size(); }
+
+	// recomputes the world transforms of every changed subtree
+	void update();
+	size_t getUpdatedLastFrame() const { return updatedLastFrame; }
+
+private:
+	std::vector<NodeId> parents;
+	std::vector<glm::mat4> locals;
+	std::vector<glm::mat4> worlds;
+	std::vector<uint8_t> dirty;
+	size_t firstDirty;          // size() when nothing is dirty
+	size_t updatedLastFrame;
+};
+
+// out = a * b for column-major 4x4 matrices, SSE when available; out may not alias a or b
+void multiplyMat4(const glm::mat4 &a, const glm::mat4 &b, glm::mat4 &out);
+
+#endif
@@ -1,58 +1,70 @@
 #include "Shader.h"
+#include "RenderState.h"
+
+namespace
+{
+	// the file with every `#include "file"` line replaced by that file, looked up next to the including one.
+	// Shared GLSL (frameBlock.glsl, terrainLighting.glsl) is concatenated this way instead of pasted into
+	// every stage; #line keeps compile errors pointing at the right line, source string 0 being the
+	// stage's own file and 1, 2, ... the included ones in order. Throws std::ifstream::failure.
+	std::string readSource(const std::string &path, int &includes, int source = 0)
+	{
+		std::ifstream file;
+		file.exceptions(std::ifstream::failbit | std::ifstream::badbit);
+		file.open(path);
+		std::stringstream stream;
+		stream << file.rdbuf();
+		file.close();
+
+		const std::string directory = path.substr(0, path.find_last_of("\\/") + 1);
+		std::string code;
+		std::string line;
+		int lineNumber = 0;
+		while (std::getline(stream, line))
+		{
+			lineNumber++;
+			size_t directive = line.find_first_not_of(" \t");
+			size_t open = line.find('"');
+			size_t close = line.find('"', open + 1);
+			if (directive != std::string::npos && line.compare(directive, 8, "#include") == 0
+				&& open != std::string::npos && close != std::string::npos)
+			{
+				int included = ++includes;
+				code += "#line 1 " + std::to_string(included) + "\n";
+				code += readSource(directory + line.substr(open + 1, close - open - 1), includes, included);
+				code += "#line " + std::to_string(lineNumber + 1) + " " + std::to_string(source) + "\n";
+			}
+			else
+				code += line + "\n";
+		}
+		return code;
+	}
+}
 
 Shader::Shader(const char* vertexPath, const char* fragmentPath, const char* tessEvalPath, const char* tessControlPath)
 {
 	// 1. retrieve the vertex/fragment source code from filePath
 	std::string vertexCode;
 	std::string fragmentCode;
-	std::string geometryCode;
 	std::string tessEvalCode;
 	std::string tessControlCode;
 
-	std::ifstream vShaderFile;
-	std::ifstream fShaderFile;
-	std::ifstream eShaderFile;
-	std::ifstream cShaderFile;
-
-	// ensure ifstream objects can throw exceptions:
-	vShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-	fShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-	eShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-	cShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-
 	try
 	{
-		// open files
-		vShaderFile.open(vertexPath);
-		fShaderFile.open(fragmentPath);
-		std::stringstream vShaderStream, fShaderStream;
-		// read file's buffer contents into streams
-		vShaderStream << vShaderFile.rdbuf();
-		fShaderStream << fShaderFile.rdbuf();
-		// close file handlers
-		vShaderFile.close();
-		fShaderFile.close();
-		// convert stream into string
-		vertexCode = vShaderStream.str();
-		fragmentCode = fShaderStream.str();
-
+		int includes = 0;
+		vertexCode = readSource(vertexPath, includes);
+		includes = 0;
+		fragmentCode = readSource(fragmentPath, includes);
 		if (tessEvalPath != nullptr)
 		{
-			eShaderFile.open(tessEvalPath);
-			std::stringstream eShaderStream;
-			eShaderStream << eShaderFile.rdbuf();
-			eShaderFile.close();
-			tessEvalCode = eShaderStream.str();
+			includes = 0;
+			tessEvalCode = readSource(tessEvalPath, includes);
 		}
 		if (tessControlPath != nullptr)
 		{
-			cShaderFile.open(tessControlPath);
-			std::stringstream cShaderStream;
-			cShaderStream << cShaderFile.rdbuf();
-			cShaderFile.close();
-			tessControlCode = cShaderStream.str();
+			includes = 0;
+			tessControlCode = readSource(tessControlPath, includes);
 		}
-
 	}
 	catch (std::ifstream::failure e)
 	{
@@ -118,65 +130,66 @@ Shader::Shader(const char* vertexPath, const char* fragmentPath, const char* tes
 
 void Shader::use()
 {
-	glUseProgram(ID);
+	// skipped when the program is already current
+	RenderState::get().useProgram(ID);
 }
 
 // ------------------------------------------------------------------------
-void Shader::setBool(const std::string &name, bool value) const
+void Shader::setBool(const char *name, bool value) const
 {
-	glUniform1i(glGetUniformLocation(ID, name.c_str()), (int)value);
+	glUniform1i(glGetUniformLocation(ID, name), (int)value);
 }
 // ------------------------------------------------------------------------
-void Shader::setInt(const std::string &name, int value) const
+void Shader::setInt(const char *name, int value) const
 {
-	glUniform1i(glGetUniformLocation(ID, name.c_str()), value);
+	glUniform1i(glGetUniformLocation(ID, name), value);
 }
 // ------------------------------------------------------------------------
-void Shader::setFloat(const std::string &name, float value) const
+void Shader::setFloat(const char *name, float value) const
 {
-	glUniform1f(glGetUniformLocation(ID, name.c_str()), value);
+	glUniform1f(glGetUniformLocation(ID, name), value);
 }
 // ------------------------------------------------------------------------
-void Shader::setVec2(const std::string &name, const glm::vec2 &value) const
+void Shader::setVec2(const char *name, const glm::vec2 &value) const
 {
-	glUniform2fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+	glUniform2fv(glGetUniformLocation(ID, name), 1, &value[0]);
 }
-void Shader::setVec2(const std::string &name, float x, float y) const
+void Shader::setVec2(const char *name, float x, float y) const
 {
-	glUniform2f(glGetUniformLocation(ID, name.c_str()), x, y);
+	glUniform2f(glGetUniformLocation(ID, name), x, y);
 }
 // ------------------------------------------------------------------------
-void Shader::setVec3(const std::string &name, const glm::vec3 &value) const
+void Shader::setVec3(const char *name, const glm::vec3 &value) const
 {
-	glUniform3fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+	glUniform3fv(glGetUniformLocation(ID, name), 1, &value[0]);
 }
-void Shader::setVec3(const std::string &name, float x, float y, float z) const
+void Shader::setVec3(const char *name, float x, float y, float z) const
 {
-	glUniform3f(glGetUniformLocation(ID, name.c_str()), x, y, z);
+	glUniform3f(glGetUniformLocation(ID, name), x, y, z);
 }
 // ------------------------------------------------------------------------
-void Shader::setVec4(const std::string &name, const glm::vec4 &value) const
+void Shader::setVec4(const char *name, const glm::vec4 &value) const
 {
-	glUniform4fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+	glUniform4fv(glGetUniformLocation(ID, name), 1, &value[0]);
 }
-void Shader::setVec4(const std::string &name, float x, float y, float z, float w)
+void Shader::setVec4(const char *name, float x, float y, float z, float w)
 {
-	glUniform4f(glGetUniformLocation(ID, name.c_str()), x, y, z, w);
+	glUniform4f(glGetUniformLocation(ID, name), x, y, z, w);
 }
 // ------------------------------------------------------------------------
-void Shader::setMat2(const std::string &name, const glm::mat2 &mat) const
+void Shader::setMat2(const char *name, const glm::mat2 &mat) const
 {
-	glUniformMatrix2fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+	glUniformMatrix2fv(glGetUniformLocation(ID, name), 1, GL_FALSE, &mat[0][0]);
 }
 // ------------------------------------------------------------------------
-void Shader::setMat3(const std::string &name, const glm::mat3 &mat) const
+void Shader::setMat3(const char *name, const glm::mat3 &mat) const
 {
-	glUniformMatrix3fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+	glUniformMatrix3fv(glGetUniformLocation(ID, name), 1, GL_FALSE, &mat[0][0]);
 }
 // ------------------------------------------------------------------------
-void Shader::setMat4(const std::string &name, const glm::mat4 &mat) const
+void Shader::setMat4(const char *name, const glm::mat4 &mat) const
 {
-	glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+	glUniformMatrix4fv(glGetUniformLocation(ID, name), 1, GL_FALSE, &mat[0][0]);
 }
 
 
@@ -0,0 +1,24 @@
+#version 330 core
+out vec4 FragColor;
+
+in vec2 TextCoords;
+
+uniform sampler2D image;
+// (1, 0) for the horizontal pass, (0, 1) for the vertical one
+uniform vec2 direction;
+
+// 9-tap gaussian in 5 fetches: the outer taps sit between two texels and let the linear filter do the weighting
+const float offsets[3] = float[](0.0, 1.3846153846, 3.2307692308);
+const float weights[3] = float[](0.2270270270, 0.3162162162, 0.0702702703);
+
+void main()
+{
+	vec2 step = direction / vec2(textureSize(image, 0));
+	vec4 result = texture(image, TextCoords) * weights[0];
+	for (int i = 1; i < 3; i++)
+	{
+		result += texture(image, TextCoords + step * offsets[i]) * weights[i];
+		result += texture(image, TextCoords - step * offsets[i]) * weights[i];
+	}
+	FragColor = result;
+}
@@ -0,0 +1,39 @@
+#version 430 core
+// deferred shading, lighting pass: once per pixel of the rendered area, from the G-buffer of gbufferFrag.fs.
+// The lighting of plainFrag.fs, with the position rebuilt from depth
+#include "frameBlock.glsl"
+#include "terrainLighting.glsl"
+
+out vec4 FragColor;
+
+in vec2 TextCoords;
+
+layout(binding = 5) uniform sampler2D gAlbedo;
+layout(binding = 6) uniform sampler2D gNormal;
+layout(binding = 7) uniform sampler2D gDepth;
+
+vec3 decodeNormal(vec2 e)
+{
+	vec3 n = vec3(e.x, 1.0 - abs(e.x) - abs(e.y), e.y);
+	if (n.y < 0.0)
+		n.xz = (1.0 - abs(n.zx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.z >= 0.0 ? 1.0 : -1.0);
+	return normalize(n);
+}
+
+void main()
+{
+	ivec2 pixel = ivec2(gl_FragCoord.xy);
+	float depth = texelFetch(gDepth, pixel, 0).r;
+	// nothing drawn here, the fog has swallowed it already
+	if (depth >= 1.0)
+	{
+		FragColor = vec4(sky, 1.0);
+		return;
+	}
+	vec4 world = inverseViewProjection * vec4(gl_FragCoord.xy / renderSize * 2.0 - 1.0, depth * 2.0 - 1.0, 1.0);
+	vec3 position = world.xyz / world.w;
+	vec3 col = texelFetch(gAlbedo, pixel, 0).rgb;
+	vec3 norm = decodeNormal(texelFetch(gNormal, pixel, 0).rg * 2.0 - 1.0);
+
+	FragColor = shadeTerrain(position, norm, col, lightSpaceMatrix * vec4(position, 1.0), fogVisibility(position));
+}
@@ -0,0 +1,12 @@
+#version 330 core
+// variance shadow map: first two moments of the light-space depth
+out vec2 moments;
+
+void main()
+{
+	float depth = gl_FragCoord.z;
+	// the slope term keeps the variance from collapsing on surfaces tilted away from the light
+	float dx = dFdx(depth);
+	float dy = dFdy(depth);
+	moments = vec2(depth, depth * depth + 0.25 * (dx * dx + dy * dy));
+}
@@ -1,8 +1,8 @@
 
-#version 330 core
+#version 430 core
+#include "frameBlock.glsl"
 layout (location = 0) in vec3 aPos;
 
-uniform mat4 lightSpaceMatrix;
 uniform mat4 model;
 
 void main()
@@ -0,0 +1,43 @@
+// per-frame state shared by every terrain stage, written once a frame into a RingBuffer region
+// (FrameUniforms in FrameUniforms.h, std140, same order)
+struct DirLight {
+	vec3 direction;
+	vec3 ambient;
+	vec3 diffuse;
+	vec3 specular;
+};
+
+layout(std140, binding = 0) uniform FrameBlock
+{
+	mat4 view;
+	mat4 projection;
+	// inverse of the (jittered) projection * view, the deferred pass rebuilds positions with it
+	mat4 inverseViewProjection;
+	mat4 lightSpaceMatrix;
+	vec3 camPos;
+	// set by the frame-time controller, 1 keeps the levels of the control shader
+	float tessScale;
+	vec3 sky;
+	// height scale of the terrain
+	int scale;
+	DirLight dirLight;
+	// tiles per pixel of the rendered area, which dynamic resolution shrinks
+	vec2 clusterTileScale;
+	// pixels of the rendered area
+	vec2 renderSize;
+	// depth slices: scale, offset and the far end of the first slice
+	vec3 clusterSlices;
+	int pointLightCount;
+	// 0 - manual 3x3 PCF, 1 - hardware PCF, 2 - variance shadow map
+	int shadowMode;
+	int showShadow;
+};
+
+// fog: 1 near the camera, 0 where only the sky is left
+const float fogDensity = 0.0035;
+const float fogGradient = 3;
+
+float fogVisibility(vec3 position)
+{
+	return clamp(exp(-pow(distance(camPos, position) * fogDensity, fogGradient)), 0.0, 1.0);
+}
@@ -0,0 +1,28 @@
+#version 430 core
+// deferred shading, geometry pass: the terrain colour of terrainLighting.glsl and the normal, nothing lit.
+// Position comes back from the depth buffer, so the G-buffer is two thin targets:
+//   0 RGBA8  albedo
+//   1 RG16   normal, octahedral
+#include "frameBlock.glsl"
+#include "terrainLighting.glsl"
+
+layout (location = 0) out vec4 gAlbedo;
+layout (location = 1) out vec2 gNormal;
+
+in vec3 normES;
+in vec3 posES;
+
+// the unit vector folded onto the octahedron |x| + |y| + |z| = 1 and unfolded into [-1, 1]^2
+vec2 encodeNormal(vec3 n)
+{
+	n /= abs(n.x) + abs(n.y) + abs(n.z);
+	vec2 folded = n.y >= 0.0 ? n.xz : (1.0 - abs(n.zx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.z >= 0.0 ? 1.0 : -1.0);
+	return folded;
+}
+
+void main()
+{
+	gAlbedo = vec4(terrainColour(posES.y / scale), 1.0);
+	// y up is the common case on a terrain, so it is the axis that is never folded
+	gNormal = encodeNormal(normalize(normES)) * 0.5 + 0.5;
+}
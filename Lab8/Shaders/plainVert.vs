@@ -1,12 +1,10 @@
 
-#version 330 core
+#version 430 core
+#include "frameBlock.glsl"
 layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec2 aTextCoord;
 
 uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
-uniform mat4 lightSpaceMatrix;  // this is different - we're passing this to calculate shadow in frag shader
 
 out vec2 textCoord;
 out vec3 fragPos;
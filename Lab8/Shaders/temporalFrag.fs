@@ -0,0 +1,129 @@
+#version 330 core
+// temporal upsampling: this frame's jittered samples from the corner renderSize of the scene target,
+// blended with the history reprojected through the scene depth. The history is clipped to the colour
+// range around the pixel and loses confidence (alpha) by how far it had to be moved
+out vec4 FragColor;
+
+in vec2 TextCoords;
+
+uniform sampler2D scene;
+uniform sampler2D sceneDepth;
+uniform sampler2D history;
+uniform vec2 renderSize;
+uniform vec2 outputSize;
+// sub-pixel offset of this frame's projection, in render pixels
+uniform vec2 jitter;
+// current NDC to last frame's clip space
+uniform mat4 reprojection;
+uniform bool hasHistory;
+// samples the history holds at full confidence, the steady-state blend is about 1 / maxSamples
+uniform float maxSamples;
+
+// width of the neighbourhood box in standard deviations
+const float CLIP_GAMMA = 1.0;
+
+vec3 toYCoCg(vec3 c)
+{
+	return vec3(0.25 * c.r + 0.5 * c.g + 0.25 * c.b, 0.5 * c.r - 0.5 * c.b, -0.25 * c.r + 0.5 * c.g - 0.25 * c.b);
+}
+
+vec3 toRGB(vec3 c)
+{
+	return vec3(c.x + c.y - c.z, c.x + c.z, c.x - c.y - c.z);
+}
+
+// bicubic Catmull-Rom from five bilinear taps, keeps the history sharp while it is resampled
+vec4 sampleHistory(vec2 uv)
+{
+	vec2 position = uv * outputSize;
+	vec2 centre = floor(position - 0.5) + 0.5;
+	vec2 f = position - centre;
+	vec2 w0 = f * (-0.5 + f * (1.0 - 0.5 * f));
+	vec2 w1 = 1.0 + f * f * (-2.5 + 1.5 * f);
+	vec2 w2 = f * (0.5 + f * (2.0 - 1.5 * f));
+	vec2 w3 = f * f * (-0.5 + 0.5 * f);
+	vec2 w12 = w1 + w2;
+	vec2 uv0 = (centre - 1.0) / outputSize;
+	vec2 uv3 = (centre + 2.0) / outputSize;
+	vec2 uv12 = (centre + w2 / w12) / outputSize;
+
+	vec4 result = texture(history, vec2(uv12.x, uv0.y)) * w12.x * w0.y
+		+ texture(history, vec2(uv0.x, uv12.y)) * w0.x * w12.y
+		+ texture(history, uv12) * w12.x * w12.y
+		+ texture(history, vec2(uv3.x, uv12.y)) * w3.x * w12.y
+		+ texture(history, vec2(uv12.x, uv3.y)) * w12.x * w3.y;
+	float weight = w12.x * w0.y + w0.x * w12.y + w12.x * w12.y + w3.x * w12.y + w12.x * w3.y;
+	return result / weight;
+}
+
+void main()
+{
+	// this output pixel in render pixels; render texel t shows the point t + 0.5 - jitter
+	vec2 position = TextCoords * renderSize;
+	ivec2 base = ivec2(floor(position + jitter));
+	ivec2 last = ivec2(renderSize) - 1;
+
+	vec3 sum = vec3(0.0);
+	float weightSum = 0.0;
+	float nearest = 0.0;
+	vec3 moment1 = vec3(0.0);
+	vec3 moment2 = vec3(0.0);
+	vec3 low = vec3(1e9);
+	vec3 high = vec3(-1e9);
+	float closest = 1.0;
+	for (int y = -1; y <= 1; y++)
+	{
+		for (int x = -1; x <= 1; x++)
+		{
+			ivec2 texel = clamp(base + ivec2(x, y), ivec2(0), last);
+			vec3 colour = toYCoCg(texelFetch(scene, texel, 0).rgb);
+			closest = min(closest, texelFetch(sceneDepth, texel, 0).r);
+			// Blackman-Harris approximated by a gaussian, over the distance to this pixel
+			vec2 offset = vec2(texel) + 0.5 - jitter - position;
+			float weight = exp(-2.29 * dot(offset, offset));
+			sum += colour * weight;
+			weightSum += weight;
+			nearest = max(nearest, weight);
+			moment1 += colour;
+			moment2 += colour * colour;
+			low = min(low, colour);
+			high = max(high, colour);
+		}
+	}
+	vec3 current = sum / weightSum;
+	// 1 when a sample landed on this pixel, less between samples, which is most pixels when upscaling
+	float currentWeight = nearest;
+
+	// reprojected with the nearest depth around the pixel, so edges move with the foreground
+	vec4 previous = reprojection * vec4(TextCoords * 2.0 - 1.0, closest * 2.0 - 1.0, 1.0);
+	vec2 previousUv = previous.xy / previous.w * 0.5 + 0.5;
+	bool onScreen = previous.w > 0.0 && all(greaterThanEqual(previousUv, vec2(0.0))) && all(lessThanEqual(previousUv, vec2(1.0)));
+	if (!hasHistory || !onScreen)
+	{
+		FragColor = vec4(toRGB(current), currentWeight / maxSamples);
+		return;
+	}
+
+	vec4 stored = sampleHistory(previousUv);
+	vec3 previousColour = toYCoCg(max(stored.rgb, vec3(0.0)));
+	float historyWeight = clamp(stored.a, 0.0, 1.0) * maxSamples;
+
+	// clip towards the centre of the neighbourhood box, variance-tightened inside min/max
+	vec3 mean = moment1 / 9.0;
+	vec3 sigma = sqrt(max(moment2 / 9.0 - mean * mean, vec3(0.0)));
+	vec3 boxLow = max(low, mean - CLIP_GAMMA * sigma);
+	vec3 boxHigh = min(high, mean + CLIP_GAMMA * sigma);
+	vec3 boxCentre = 0.5 * (boxLow + boxHigh);
+	vec3 extent = 0.5 * (boxHigh - boxLow) + 1e-4;
+	vec3 toHistory = previousColour - boxCentre;
+	vec3 units = abs(toHistory / extent);
+	float outside = max(units.x, max(units.y, units.z));
+	vec3 clipped = outside > 1.0 ? boxCentre + toHistory / outside : previousColour;
+
+	// history that had to move far was a different surface, it keeps less of its weight
+	float rejection = clamp(distance(previousColour, clipped) / (2.0 * length(extent)), 0.0, 1.0);
+	historyWeight *= 1.0 - rejection;
+
+	vec3 result = (clipped * historyWeight + current * currentWeight) / (historyWeight + currentWeight);
+	FragColor = vec4(toRGB(result), min(historyWeight + currentWeight, maxSamples) / maxSamples);
+}
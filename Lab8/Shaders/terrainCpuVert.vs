@@ -0,0 +1,28 @@
+#version 430 core
+// the terrain tessellated on the CPU (CpuTessellatedTerrain) is already displaced; this produces what
+// tessEvaluationShader.tes does, so plainFrag.fs shades both the same way
+#include "frameBlock.glsl"
+
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec3 aNormal;
+layout (location = 2) in vec2 aTextCoord;
+
+// the depth pre-pass program links this same stage
+invariant gl_Position;
+
+out vec3 normES ;
+out vec2 textES;
+out vec3 posES ;
+out float visibility;
+out vec4 FragPosLightSpaceES ;
+
+void main()
+{
+   textES = aTextCoord;
+   posES = aPos;
+   normES = aNormal;
+   gl_Position = projection * view * vec4(posES, 1.0);
+   FragPosLightSpaceES = lightSpaceMatrix * vec4(posES, 1.0);
+
+   visibility = fogVisibility(posES);
+}
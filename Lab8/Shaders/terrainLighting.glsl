@@ -0,0 +1,140 @@
+// terrain colour and lighting shared by the forward (plainFrag.fs), G-buffer (gbufferFrag.fs) and deferred
+// (deferredFrag.fs) fragment stages; needs frameBlock.glsl included before it
+
+// point light: position and radius, colour and intensity (PointLight in ClusteredLights.h)
+struct PointLight {
+	vec4 positionRadius;
+	vec4 colourIntensity;
+};
+
+// lights, clusters (first index, count) and index lists, filled by ClusteredLights
+layout(std430, binding = 3) readonly buffer PointLights { PointLight pointLights[]; };
+layout(std430, binding = 4) readonly buffer LightClusters { uvec2 lightClusters[]; };
+layout(std430, binding = 5) readonly buffer LightIndices { uint lightIndices[]; };
+
+// the depth map raw for the manual PCF and with hardware comparison (GL_COMPARE_REF_TO_TEXTURE, linear filter),
+// and the blurred depth moments (d, d^2) for variance shadows
+layout(binding = 1) uniform sampler2D shadowMap;
+layout(binding = 2) uniform sampler2DShadow shadowMapCompare;
+layout(binding = 4) uniform sampler2D shadowMoments;
+
+// clusters: tiles in x, y and depth slices (ClusteredLights::TILES_X, TILES_Y, SLICES)
+const ivec3 clusterGrid = ivec3(16, 9, 24);
+
+// height bands: blue low, green in the middle, gray on the peaks
+vec3 terrainColour(float height)
+{
+	vec4 green = vec4(0.3, 0.35, 0.15, 0.0);
+	vec4 darkGreen = vec4(0.35, 0.55, 0.25, 0.0);
+	vec4 blue = vec4(0.2, 0.2, 0.7, 0.0);
+	vec4 gray = vec4(0.5, 0.4, 0.5, 0.0);
+	vec3 col = vec3(0.5);
+	if (height > 0.6)
+		col = mix(darkGreen, gray, smoothstep(0.6, 1.0, height)).rgb;
+	else if (height > 0.3)
+		col = mix(green, darkGreen, smoothstep(0.3, 0.6, height)).rgb;
+	else if (height < 0.3)
+		col = mix(blue, green, smoothstep(0.0, 0.3, height)).rgb;
+	return col;
+}
+
+float calcShadow(vec3 projCoords, float bias)
+{
+	vec2 texelSize = 1.0 / textureSize(shadowMap, 0);
+	float shadow = 0.0;
+	for (int i = -1; i < 2; i++)
+		for (int j = -1; j < 2; j++)
+			if (projCoords.z - bias > texture(shadowMap, projCoords.xy + vec2(i, j) * texelSize).r)
+				shadow += 1.0;
+	return shadow / 9.0 * .65;
+}
+
+// hardware PCF: every fetch compares 4 texels and blends them bilinearly,
+// so 4 fetches half a texel apart give a smoothed 3x3 texel kernel
+float calcShadowHardware(vec3 projCoords, float bias)
+{
+	vec2 texelSize = 1.0 / textureSize(shadowMapCompare, 0);
+	float reference = projCoords.z - bias;
+	float lit = texture(shadowMapCompare, vec3(projCoords.xy + vec2(-0.5, -0.5) * texelSize, reference))
+		+ texture(shadowMapCompare, vec3(projCoords.xy + vec2( 0.5, -0.5) * texelSize, reference))
+		+ texture(shadowMapCompare, vec3(projCoords.xy + vec2(-0.5,  0.5) * texelSize, reference))
+		+ texture(shadowMapCompare, vec3(projCoords.xy + vec2( 0.5,  0.5) * texelSize, reference));
+	return (1.0 - lit / 4.0) * .65;
+}
+
+// variance shadow map: one filtered fetch of the moments and Chebyshev's inequality
+float calcShadowVariance(vec3 projCoords)
+{
+	vec2 moments = texture(shadowMoments, projCoords.xy).rg;
+	if (projCoords.z <= moments.x)
+		return 0.0;
+	// a minimum variance instead of a depth bias
+	float variance = max(moments.y - moments.x * moments.x, 0.00002);
+	float d = projCoords.z - moments.x;
+	float pMax = variance / (variance + d * d);
+	// cuts the tail of the estimate, which is what bleeds light through the shadows
+	const float bleedReduction = 0.3;
+	pMax = clamp((pMax - bleedReduction) / (1.0 - bleedReduction), 0.0, 1.0);
+	return (1.0 - pMax) * .65;
+}
+
+// the filter of shadowMode; no shadow when they are off or behind the light's far plane
+float calcDirShadow(vec4 lightSpacePos)
+{
+	vec3 projCoords = lightSpacePos.xyz / lightSpacePos.w * 0.5 + 0.5;
+	if (showShadow == 0 || projCoords.z > 1.0)
+		return 0.0;
+	const float bias = 0.001;
+	if (shadowMode == 1)
+		return calcShadowHardware(projCoords, bias);
+	if (shadowMode == 2)
+		return calcShadowVariance(projCoords);
+	return calcShadow(projCoords, bias);
+}
+
+// clustered lighting: only the lights in the list of the cluster the fragment lies in
+vec3 calcPointLights(vec3 position, vec3 norm, vec3 viewDir, vec3 albedo)
+{
+	// tile from the position on screen, slice from the view-space depth
+	float depth = -(view * vec4(position, 1.0)).z;
+	ivec2 tile = clamp(ivec2(gl_FragCoord.xy * clusterTileScale), ivec2(0), clusterGrid.xy - 1);
+	int slice = depth < clusterSlices.z ? 0 : 1 + int(log(depth) * clusterSlices.x - clusterSlices.y);
+	slice = clamp(slice, 0, clusterGrid.z - 1);
+	uvec2 cluster = lightClusters[tile.x + clusterGrid.x * (tile.y + clusterGrid.y * slice)];
+
+	vec3 result = vec3(0.0);
+	for (uint i = 0u; i < cluster.y; i++)
+	{
+		PointLight light = pointLights[lightIndices[cluster.x + i]];
+		vec3 toLight = light.positionRadius.xyz - position;
+		float distance = length(toLight);
+		// the falloff reaches zero at the radius, beyond it the light is not in the cluster
+		float ratio = distance / light.positionRadius.w;
+		float falloff = clamp(1.0 - ratio * ratio * ratio * ratio, 0.0, 1.0);
+		float attenuation = falloff * falloff / (1.0 + 16.0 * ratio * ratio);
+		// Blinn-Phong, as for the directional light
+		vec3 lightDir = toLight / max(distance, 0.0001);
+		float diffFactor = max(dot(norm, lightDir), 0.0);
+		float specFactor = pow(max(dot(normalize(lightDir + viewDir), norm), 0.0), 64.0);
+		result += (diffFactor * albedo + specFactor * 0.5) * light.colourIntensity.rgb * light.colourIntensity.w * attenuation;
+	}
+	return result;
+}
+
+// Blinn-Phong from dirLight with the selected shadow filter, the point lights, and the fog towards the sky
+vec4 shadeTerrain(vec3 position, vec3 norm, vec3 albedo, vec4 lightSpacePos, float visibility)
+{
+	vec3 ambient = dirLight.ambient * albedo;
+	vec3 lightDir = normalize(dirLight.direction - position);
+	vec3 diffuse = max(dot(lightDir, norm), 0.0) * dirLight.diffuse * albedo;
+	vec3 viewDir = normalize(camPos - position);
+	vec3 halfDir = normalize(lightDir + viewDir);
+	vec3 specular = pow(max(dot(halfDir, norm), 0.0), 64.0) * dirLight.specular * albedo;
+
+	float shadow = calcDirShadow(lightSpacePos);
+	vec3 pointLit = vec3(0.0);
+	if (pointLightCount > 0)
+		pointLit = calcPointLights(position, norm, viewDir, albedo);
+
+	return mix(vec4(sky, 1.0), vec4(ambient + (1.0 - shadow) * (diffuse + specular) + pointLit, 1.0), visibility);
+}
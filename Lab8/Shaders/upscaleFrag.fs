@@ -0,0 +1,31 @@
+#version 330 core
+// dynamic resolution: the scene was rendered into the corner uvScale of its target. Bilinear upscale,
+// then sharpened against the four neighbours; the result stays inside their range, so edges do not ring
+out vec4 FragColor;
+
+in vec2 TextCoords;
+
+uniform sampler2D scene;
+uniform vec2 uvScale;
+// 0 - plain bilinear
+uniform float sharpness;
+
+void main()
+{
+	vec2 texel = 1.0 / vec2(textureSize(scene, 0));
+	// stay half a texel inside the rendered area, the rest of the target is only cleared
+	vec2 lo = 0.5 * texel;
+	vec2 hi = uvScale - 0.5 * texel;
+	vec2 uv = clamp(TextCoords * uvScale, lo, hi);
+
+	vec3 centre = texture(scene, uv).rgb;
+	vec3 north = texture(scene, clamp(uv + vec2(0.0, texel.y), lo, hi)).rgb;
+	vec3 south = texture(scene, clamp(uv - vec2(0.0, texel.y), lo, hi)).rgb;
+	vec3 east = texture(scene, clamp(uv + vec2(texel.x, 0.0), lo, hi)).rgb;
+	vec3 west = texture(scene, clamp(uv - vec2(texel.x, 0.0), lo, hi)).rgb;
+
+	vec3 low = min(centre, min(min(north, south), min(east, west)));
+	vec3 high = max(centre, max(max(north, south), max(east, west)));
+	vec3 sharpened = centre + (4.0 * centre - north - south - east - west) * 0.25 * sharpness;
+	FragColor = vec4(clamp(sharpened, low, high), 1.0);
+}
@@ -0,0 +1,249 @@
+#include "StagingUploader.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <limits>
+
+static const uint64_t STAGING_ALIGNMENT = 16;
+
+StagingUploader::StagingUploader(size_t ringSizeIn, size_t frameBudgetIn)
+{
+	ringSize = ringSizeIn;
+	frameBudget = frameBudgetIn;
+	head = 0;
+	tail = 0;
+	fencedHead = 0;
+	bytesLastFrame = 0;
+	ringFullFrames = 0;
+
+	const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+	glCreateBuffers(1, &ring);
+	glNamedBufferStorage(ring, ringSize, nullptr, flags);
+	mapped = static_cast<unsigned char*>(glMapNamedBufferRange(ring, 0, ringSize, flags));
+	if (!mapped)
+		std::cout << "ERROR::STAGING::MAP_FAILED" << std::endl;
+}
+
+StagingUploader::~StagingUploader()
+{
+	for (Region &region : inFlight)
+		glDeleteSync(region.fence);
+	glUnmapNamedBuffer(ring);
+	glDeleteBuffers(1, &ring);
+}
+
+void StagingUploader::queueBuffer(BufferUpload upload)
+{
+	Request request;
+	request.isTexture = false;
+	request.buffer = std::move(upload);
+	request.done = 0;
+	std::lock_guard<std::mutex> lock(queueMutex);
+	queue.push_back(std::move(request));
+}
+
+void StagingUploader::queueTexture(TextureUpload upload)
+{
+	// rows are never split, one that does not fit the ring could never be copied
+	if (upload.rowBytes > ringSize)
+	{
+		std::cout << "ERROR::STAGING::ROW_LARGER_THAN_RING " << upload.rowBytes << " bytes" << std::endl;
+		return;
+	}
+	Request request;
+	request.isTexture = true;
+	request.texture = std::move(upload);
+	request.done = 0;
+	std::lock_guard<std::mutex> lock(queueMutex);
+	queue.push_back(std::move(request));
+}
+
+GLuint StagingUploader::queueImage(std::shared_ptr<const unsigned char> pixels, int width, int height, int components)
+{
+	GLuint texture;
+	glCreateTextures(GL_TEXTURE_2D, 1, &texture);
+	queueImage(texture, std::move(pixels), width, height, components);
+	return texture;
+}
+
+void StagingUploader::queueImage(GLuint texture, std::shared_ptr<const unsigned char> pixels, int width, int height, int components)
+{
+	static const GLenum formats[] = { GL_RED, GL_RG, GL_RGB, GL_RGBA };
+	static const GLenum internalFormats[] = { GL_R8, GL_RG8, GL_RGB8, GL_RGBA8 };
+	components = std::min(std::max(components, 1), 4);
+
+	TextureUpload upload;
+	upload.texture = texture;
+	upload.internalFormat = internalFormats[components - 1];
+	upload.format = formats[components - 1];
+	upload.width = width;
+	upload.height = height;
+	upload.levels = 1;
+	for (int size = std::max(width, height); size > 1; size >>= 1)
+		upload.levels++;
+	upload.rowBytes = (size_t)width * components;
+	upload.pixels = pixels.get();
+	upload.owner = pixels;
+	upload.generateMipmap = true;
+	queueTexture(std::move(upload));
+}
+
+bool StagingUploader::idle()
+{
+	std::lock_guard<std::mutex> lock(queueMutex);
+	return queue.empty() && active.empty();
+}
+
+// frees ring space of every frame the GPU has finished with
+void StagingUploader::retire(bool wait)
+{
+	while (!inFlight.empty())
+	{
+		Region &region = inFlight.front();
+		GLenum status = glClientWaitSync(region.fence, wait ? GL_SYNC_FLUSH_COMMANDS_BIT : 0, wait ? 1000000000ull : 0);
+		if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+			break;
+		glDeleteSync(region.fence);
+		tail = region.end;
+		inFlight.pop_front();
+		wait = false;
+	}
+}
+
+bool StagingUploader::allocate(size_t size, size_t &offset)
+{
+	if (size > ringSize)
+		return false;
+	// nothing in flight: start over at the beginning of the ring, so even an allocation of the whole ring fits
+	if (head == tail)
+		head = tail = (head + ringSize - 1) / ringSize * ringSize;
+	uint64_t start = (head + STAGING_ALIGNMENT - 1) / STAGING_ALIGNMENT * STAGING_ALIGNMENT;
+	uint64_t pos = start % ringSize;
+	// never split an allocation over the end of the ring
+	if (pos + size > ringSize)
+		start += ringSize - pos;
+	if (start + size - tail > ringSize)
+		return false;
+	offset = (size_t)(start % ringSize);
+	head = start + size;
+	return true;
+}
+
+bool StagingUploader::process(Request &request, size_t &budget, bool &ringFull)
+{
+	const size_t maxChunk = std::max<size_t>(ringSize / 4, 1);
+
+	if (!request.isTexture)
+	{
+		BufferUpload &up = request.buffer;
+		while (request.done < up.size)
+		{
+			size_t chunk = std::min(std::min(up.size - request.done, budget), maxChunk);
+			size_t offset;
+			if (chunk == 0)
+				return false;
+			if (!allocate(chunk, offset))
+			{
+				ringFull = true;
+				return false;
+			}
+			std::memcpy(mapped + offset, static_cast<const unsigned char*>(up.data) + request.done, chunk);
+			glCopyNamedBufferSubData(ring, up.buffer, offset, up.offset + request.done, chunk);
+			request.done += chunk;
+			budget -= chunk;
+		}
+		if (up.onComplete)
+			up.onComplete();
+		return true;
+	}
+
+	TextureUpload &up = request.texture;
+	if (up.allocateStorage)
+	{
+		glTextureStorage2D(up.texture, up.levels, up.internalFormat, up.width, up.height);
+		up.allocateStorage = false;
+	}
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, ring);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	bool finished = true;
+	while (request.done < (size_t)up.height)
+	{
+		size_t rows = std::min((size_t)up.height - request.done, std::min(budget, maxChunk) / up.rowBytes);
+		// rows wider than a chunk move one at a time, and rows wider than a whole budget one per fresh frame
+		if (rows == 0 && (budget >= up.rowBytes || budget == frameBudget))
+			rows = 1;
+		size_t offset;
+		if (rows == 0)
+		{
+			finished = false;
+			break;
+		}
+		if (!allocate(rows * up.rowBytes, offset))
+		{
+			ringFull = true;
+			finished = false;
+			break;
+		}
+		std::memcpy(mapped + offset, static_cast<const unsigned char*>(up.pixels) + request.done * up.rowBytes, rows * up.rowBytes);
+		glTextureSubImage2D(up.texture, 0, 0, (GLint)request.done, up.width, (GLsizei)rows, up.format, up.type, (void*)(uintptr_t)offset);
+		request.done += rows;
+		budget -= std::min(budget, rows * up.rowBytes);
+	}
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	if (!finished)
+		return false;
+
+	if (up.generateMipmap)
+		glGenerateTextureMipmap(up.texture);
+	if (up.onComplete)
+		up.onComplete();
+	return true;
+}
+
+bool StagingUploader::pump(size_t budget)
+{
+	{
+		std::lock_guard<std::mutex> lock(queueMutex);
+		while (!queue.empty())
+		{
+			active.push_back(std::move(queue.front()));
+			queue.pop_front();
+		}
+	}
+
+	const size_t startBudget = budget;
+	bool ringFull = false;
+	while (!active.empty() && !ringFull)
+	{
+		if (!process(active.front(), budget, ringFull))
+			break;
+		// drop the request, and with it the producer's data
+		active.pop_front();
+	}
+	if (ringFull)
+		ringFullFrames++;
+	bytesLastFrame = startBudget - budget;
+
+	// one fence covers everything copied in this round
+	if (head != fencedHead)
+	{
+		inFlight.push_back({ glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0), head });
+		fencedHead = head;
+	}
+	return active.empty();
+}
+
+void StagingUploader::update()
+{
+	retire(false);
+	pump(frameBudget);
+}
+
+void StagingUploader::flush()
+{
+	retire(false);
+	while (!pump(std::numeric_limits<size_t>::max()))
+		retire(true);
+}
@@ -0,0 +1,126 @@
+#pragma once
+#ifndef STAGINGUPLOADER_H
+#define STAGINGUPLOADER_H
+
+#include <glad/glad.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// Streams buffer and texture data to the GPU through one persistently mapped staging ring.
+// Uploads are queued from any thread and copied on the GL thread by update(), at most frameBudget bytes per frame.
+// The copy into the destination is a GPU-side glCopyNamedBufferSubData / PBO glTextureSubImage2D, and ring space
+// is recycled with one fence per frame that is only polled, never waited on, so a frame never stalls on an upload.
+class StagingUploader
+{
+public:
+	struct BufferUpload
+	{
+		GLuint buffer = 0;
+		GLintptr offset = 0;
+		const void *data = nullptr;
+		size_t size = 0;
+		std::shared_ptr<const void> owner;          // keeps data alive until it is copied
+		std::function<void()> onComplete;           // called on the GL thread once the last byte is queued
+	};
+
+	struct TextureUpload
+	{
+		GLuint texture = 0;                         // a name from glCreateTextures
+		bool allocateStorage = true;                // glTextureStorage2D before the first rows
+		GLenum internalFormat = GL_RGBA8;
+		GLsizei levels = 1;
+		GLsizei width = 0;
+		GLsizei height = 0;
+		GLenum format = GL_RGBA;
+		GLenum type = GL_UNSIGNED_BYTE;
+		size_t rowBytes = 0;                        // tightly packed rows
+		const void *pixels = nullptr;
+		std::shared_ptr<const void> owner;
+		bool generateMipmap = false;
+		std::function<void()> onComplete;
+	};
+
+	// needs a current GL 4.4+ context
+	StagingUploader(size_t ringSize = 16u << 20, size_t frameBudget = 4u << 20);
+	~StagingUploader();
+	StagingUploader(const StagingUploader&) = delete;
+	StagingUploader& operator=(const StagingUploader&) = delete;
+
+	// thread-safe
+	void queueBuffer(BufferUpload upload);
+	void queueTexture(TextureUpload upload);
+	// convenience: moves the vector into the request
+	template<typename T>
+	void queueBuffer(GLuint buffer, std::vector<T> &&data)
+	{
+		auto owned = std::make_shared<std::vector<T> >(std::move(data));
+		BufferUpload upload;
+		upload.buffer = buffer;
+		upload.data = owned->data();
+		upload.size = owned->size() * sizeof(T);
+		upload.owner = owned;
+		queueBuffer(std::move(upload));
+	}
+	// creates an immutable, fully mipmapped texture for 8-bit pixels with 1-4 channels and queues its upload;
+	// sampling parameters are left to the caller
+	GLuint queueImage(std::shared_ptr<const unsigned char> pixels, int width, int height, int components);
+	// same for a texture created earlier with glCreateTextures; makes no GL calls, so decoding threads can call it
+	void queueImage(GLuint texture, std::shared_ptr<const unsigned char> pixels, int width, int height, int components);
+
+	// GL thread, once per frame: recycles finished ring space and copies up to the frame budget
+	void update();
+	// GL thread: uploads everything that is queued, waiting on the GPU if the ring is full (loading screens, shutdown)
+	void flush();
+
+	void setFrameBudget(size_t bytes) { frameBudget = bytes; }
+	size_t getFrameBudget() const { return frameBudget; }
+	bool idle();
+	size_t getBytesLastFrame() const { return bytesLastFrame; }
+	size_t getRingFullFrames() const { return ringFullFrames; }
+
+private:
+	struct Request
+	{
+		bool isTexture;
+		BufferUpload buffer;
+		TextureUpload texture;
+		size_t done;            // bytes for buffers, rows for textures
+	};
+	struct Region
+	{
+		GLsync fence;
+		uint64_t end;
+	};
+
+	GLuint ring;
+	unsigned char *mapped;
+	size_t ringSize;
+	size_t frameBudget;
+	// monotonically growing byte counters, the ring offset is counter % ringSize
+	uint64_t head;
+	uint64_t tail;
+	std::deque<Region> inFlight;
+
+	std::mutex queueMutex;
+	std::deque<Request> queue;      // filled by producers
+	std::deque<Request> active;     // GL thread only
+	uint64_t fencedHead;
+
+	size_t bytesLastFrame;
+	size_t ringFullFrames;
+
+	void retire(bool wait);
+	bool allocate(size_t size, size_t &offset);
+	// returns false when the ring or the budget ran out before the request finished
+	bool process(Request &request, size_t &budget, bool &ringFull);
+	// one round of copies, returns true when nothing is left
+	bool pump(size_t budget);
+};
+
+#endif
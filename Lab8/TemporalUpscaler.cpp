@@ -0,0 +1,111 @@
+#include "TemporalUpscaler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+namespace
+{
+	// jitter positions per output pixel; the sequence gets longer as the render scale drops, so that every
+	// output pixel still sees a few samples per cycle
+	const int SAMPLES_PER_PIXEL = 8;
+	const int MAX_PHASES = 64;
+}
+
+TemporalUpscaler::TemporalUpscaler(int outputWidthIn, int outputHeightIn)
+{
+	outputWidth = outputWidthIn;
+	outputHeight = outputHeightIn;
+	renderWidth = outputWidth;
+	renderHeight = outputHeight;
+	current = 0;
+	historyValid = false;
+	frameIndex = 0;
+	phaseCount = SAMPLES_PER_PIXEL;
+	jitter = glm::vec2(0.0f);
+	reprojection = glm::mat4(1.0f);
+	previousViewProjection = glm::mat4(1.0f);
+}
+
+TemporalUpscaler::~TemporalUpscaler()
+{
+	release();
+}
+
+bool TemporalUpscaler::create()
+{
+	// half floats, the accumulated colour keeps more precision than one 8 bit frame
+	RenderTargetDesc desc;
+	desc.width = outputWidth;
+	desc.height = outputHeight;
+	desc.colour.resize(1);
+	desc.colour[0].internalFormat = GL_RGBA16F;
+	for (int i = 0; i < 2; i++)
+	{
+		if (!history[i].create(desc))
+		{
+			std::cout << "ERROR::TEMPORALUPSCALER:: could not create the history targets" << std::endl;
+			release();
+			return false;
+		}
+	}
+	reset();
+	return true;
+}
+
+void TemporalUpscaler::release()
+{
+	history[0].release();
+	history[1].release();
+	historyValid = false;
+}
+
+void TemporalUpscaler::reset()
+{
+	historyValid = false;
+	frameIndex = 0;
+}
+
+float TemporalUpscaler::halton(unsigned index, unsigned base)
+{
+	float result = 0.0f;
+	float fraction = 1.0f;
+	while (index > 0)
+	{
+		fraction /= base;
+		result += fraction * (index % base);
+		index /= base;
+	}
+	return result;
+}
+
+void TemporalUpscaler::beginFrame(const glm::mat4 &projection, const glm::mat4 &view, int renderWidthIn, int renderHeightIn)
+{
+	renderWidth = std::max(renderWidthIn, 1);
+	renderHeight = std::max(renderHeightIn, 1);
+	float pixelRatio = (float)(outputWidth * outputHeight) / (float)(renderWidth * renderHeight);
+	phaseCount = std::min(std::max((int)std::ceil(SAMPLES_PER_PIXEL * pixelRatio), SAMPLES_PER_PIXEL), MAX_PHASES);
+
+	// Halton (2, 3) from index 1, the 0 sample would sit on every pixel centre
+	unsigned phase = frameIndex % (unsigned)phaseCount + 1;
+	jitter = glm::vec2(halton(phase, 2) - 0.5f, halton(phase, 3) - 0.5f);
+	frameIndex++;
+
+	glm::mat4 viewProjection = projection * view;
+	reprojection = historyValid ? previousViewProjection * glm::inverse(viewProjection) : glm::mat4(1.0f);
+	previousViewProjection = viewProjection;
+}
+
+glm::vec2 TemporalUpscaler::getClipJitter() const
+{
+	return glm::vec2(2.0f * jitter.x / renderWidth, 2.0f * jitter.y / renderHeight);
+}
+
+void TemporalUpscaler::present(GLuint fbo)
+{
+	RenderTarget &output = history[current];
+	glBlitNamedFramebuffer(output.getFramebuffer(), fbo, 0, 0, outputWidth, outputHeight,
+		0, 0, outputWidth, outputHeight, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+	current = 1 - current;
+	historyValid = true;
+}
@@ -0,0 +1,71 @@
+#pragma once
+#ifndef TEMPORALUPSCALER_H
+#define TEMPORALUPSCALER_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "RenderTarget.h"
+
+// Temporal upsampling: the scene is rendered at a reduced resolution with a different sub-pixel offset every
+// frame, and Shaders/temporalFrag.fs accumulates those samples into a full-resolution history. The history
+// is reprojected with the scene depth and last frame's view-projection, so only camera motion is followed,
+// which is all the terrain has.
+//
+// The history targets live outside the render graph because they have to survive the frame; the resolve
+// writes one of them and reads the other, present() copies the result out and swaps them.
+// The alpha of the history is the per-pixel confidence: how many samples it holds, as a fraction of the most
+// it may hold.
+class TemporalUpscaler
+{
+public:
+	TemporalUpscaler(int outputWidth, int outputHeight);
+	~TemporalUpscaler();
+	TemporalUpscaler(const TemporalUpscaler&) = delete;
+	TemporalUpscaler &operator=(const TemporalUpscaler&) = delete;
+
+	bool create();
+	void release();
+
+	// once per frame before rendering, with the unjittered matrices: picks this frame's offset for a render of
+	// renderWidth x renderHeight and the reprojection into last frame's history
+	void beginFrame(const glm::mat4 &projection, const glm::mat4 &view, int renderWidth, int renderHeight);
+	// offset to add to the projection, in NDC (Camera::GetProjectionMatrix)
+	glm::vec2 getClipJitter() const;
+	// the same offset in render pixels, for the resolve
+	const glm::vec2 &getJitter() const { return jitter; }
+	// current NDC to last frame's clip space
+	const glm::mat4 &getReprojection() const { return reprojection; }
+	bool hasHistory() const { return historyValid; }
+	// the next frame starts without history, e.g. after a camera cut or when switching the upscaler on
+	void reset();
+
+	// what the resolve writes and reads this frame
+	RenderTarget &getOutput() { return history[current]; }
+	GLuint getHistory() const { return history[1 - current].getColour(); }
+	// copies the resolved frame into fbo (0 - the default framebuffer) and makes it next frame's history
+	void present(GLuint fbo);
+
+	int getOutputWidth() const { return outputWidth; }
+	int getOutputHeight() const { return outputHeight; }
+	int getRenderWidth() const { return renderWidth; }
+	int getRenderHeight() const { return renderHeight; }
+	// jitter positions before the sequence repeats, more when fewer pixels are rendered
+	int getPhaseCount() const { return phaseCount; }
+
+private:
+	int outputWidth, outputHeight;
+	int renderWidth, renderHeight;
+	RenderTarget history[2];
+	int current;
+	bool historyValid;
+	unsigned frameIndex;
+	int phaseCount;
+	glm::vec2 jitter;
+	glm::mat4 reprojection;
+	glm::mat4 previousViewProjection;
+
+	static float halton(unsigned index, unsigned base);
+};
+
+#endif
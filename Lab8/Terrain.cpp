@@ -1,4 +1,9 @@
 #include "Terrain.h"
+#include "TerrainBaker.h"
+#include "JobSystem.h"
+#include "RenderState.h"
+
+#include <algorithm>
 
 //   Terrain
 Terrain::Terrain(int widthIn, int heightIn, int stepSizeIn)
@@ -9,6 +14,27 @@ Terrain::Terrain(int widthIn, int heightIn, int stepSizeIn)
     makeVertices(&vertices);
 }
 
+//    :    ,   
+Terrain::Terrain(int widthIn, int heightIn, int stepSizeIn, const char* bakedPath)
+{
+    width = widthIn;
+    height = heightIn;
+    stepSize = stepSizeIn;
+    if (bakedTiles.open(bakedPath)) {
+        //       
+        const TileFileHeader& header = bakedTiles.header();
+        float bakedX = (bakedTiles.samplesX() - 1) * header.sampleSpacing;
+        float bakedY = (bakedTiles.samplesY() - 1) * header.sampleSpacing;
+        if (bakedX < (width - 1) * stepSize || bakedY < (height - 1) * stepSize) {
+            std::cout << "Baked terrain " << bakedPath << " is smaller than the grid, using Perlin noise" << std::endl;
+            bakedTiles.close();
+        }
+    }
+    else
+        std::cout << "No baked terrain at " << bakedPath << ", using Perlin noise" << std::endl;
+    makeVertices(&vertices);
+}
+
 Terrain::Terrain() {
     width = 50;
     height = 50;
@@ -17,15 +43,20 @@ Terrain::Terrain() {
 }
 
 //  getVAO    VAO (Vertex Array Object)   
-unsigned int Terrain::getVAO() {
-    //  VAO  VBO
+//      staging-   ,  
+unsigned int Terrain::getVAO(StagingUploader* uploader) {
+    //  VAO   VBO
     glGenVertexArrays(1, &VAO);
-    glGenBuffers(1, &VBO);
+    glCreateBuffers(1, &VBO);
+    if (uploader) {
+        glNamedBufferStorage(VBO, vertices.size() * sizeof(GLfloat), nullptr, 0);
+        uploader->queueBuffer(VBO, std::vector<float>(vertices));
+    }
+    else
+        glNamedBufferStorage(VBO, vertices.size() * sizeof(GLfloat), vertices.data(), 0);
     //  VAO  VBO
-    glBindVertexArray(VAO);
+    RenderState::get().bindVertexArray(VAO);
     glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    //     
-    glBufferData(GL_ARRAY_BUFFER, (vertices.size() * sizeof(GLfloat)), vertices.data(), GL_STATIC_DRAW);
 
     //       
     //   -  xyz
@@ -37,16 +68,21 @@ unsigned int Terrain::getVAO() {
 
     //  VAO  VBO
     glBindBuffer(GL_ARRAY_BUFFER, 0);
-    glBindVertexArray(0);
+    RenderState::get().bindVertexArray(0);
 
     return VAO;
 }
 
-//  getSize      vertices
+//  getSize      vertices ( 5  )
 int Terrain::getSize() {
     return vertices.size();
 }
 
+//  getVertexCount   :   glDrawArrays(GL_PATCHES, ...)
+int Terrain::getVertexCount() const {
+    return (int)(vertices.size() / 5);
+}
+
 //  getVertices   
 std::vector<float> Terrain::getVertices() {
     return vertices;
@@ -81,35 +117,45 @@ void Terrain::makeVertices(std::vector<float>* vertices) {
        x y z u v
         */
 
-        //   
-    for (int y = 0; y < height - 1; y++) {
-        float  offSetY = y * stepSize;
-        for (int x = 0; x < width - 1; x++) {
-            float offSetX = x * stepSize;
-            makeVertex(offSetX, offSetY, vertices);  // a
-            makeVertex(offSetX, offSetY + stepSize, vertices);  // b
-            makeVertex(offSetX + stepSize, offSetY, vertices);   // c
-            makeVertex(offSetX + stepSize, offSetY, vertices);  //d
-            makeVertex(offSetX, offSetY + stepSize, vertices);  //e
-            makeVertex(offSetX + stepSize, offSetY + stepSize, vertices);  //f
+    //   :       ,
+    //         
+    const int rowFloats = (width - 1) * 6 * 5;
+    vertices->assign((size_t)std::max(height - 1, 0) * std::max(rowFloats, 0), 0.0f);
+    JobSystem::instance().parallelFor(0, height - 1, 4, [&](int firstRow, int lastRow) {
+        for (int y = firstRow; y < lastRow; y++) {
+            float* out = vertices->data() + (size_t)y * rowFloats;
+            int offSetY = y * stepSize;
+            for (int x = 0; x < width - 1; x++) {
+                int offSetX = x * stepSize;
+                out = makeVertex(offSetX, offSetY, out);  // a
+                out = makeVertex(offSetX, offSetY + stepSize, out);  // b
+                out = makeVertex(offSetX + stepSize, offSetY, out);   // c
+                out = makeVertex(offSetX + stepSize, offSetY, out);  //d
+                out = makeVertex(offSetX, offSetY + stepSize, out);  //e
+                out = makeVertex(offSetX + stepSize, offSetY + stepSize, out);  //f
+            }
         }
-    }
+    });
 }
 
-//  makeVertex           vertices
-void Terrain::makeVertex(int x, int y, std::vector<float>* vertices) {
-    //      
-    double pn = perlin.noise(x, y, 0.5);
-
-    //   xyz   
-    vertices->push_back((float)x); //xPos
-    //vertices->push_back(1.0f); //yPos - always 0 for now. Going to calculate this on GPU - can change to calclaue it here.
-    vertices->push_back(pn);
-    vertices->push_back((float)y); //zPos
-
-    //    uv   
-    vertices->push_back((float)x / (width * stepSize));
-    vertices->push_back((float)y / (height * stepSize));
+//  makeVertex          out
+//      
+float* Terrain::makeVertex(int x, int y, float* out) const {
+    //           ,     
+    // (perlin -  ,  seed 0)
+    static const BakeSettings defaultBake;
+    double pn = bakedTiles.isOpen() ? bakedTiles.heightAt((float)x, (float)y) : generateHeight(perlin, defaultBake, x, y);
+
+    //   xyz
+    *out++ = (float)x; //xPos
+    //yPos - always 0 for now. Going to calculate this on GPU - can change to calclaue it here.
+    *out++ = (float)pn;
+    *out++ = (float)y; //zPos
+
+    //    uv
+    *out++ = (float)x / (width * stepSize);
+    *out++ = (float)y / (height * stepSize);
+    return out;
 }
 
 //  cycleOctaves           .
@@ -131,4 +177,44 @@ double Terrain::cycleOctaves(glm::vec3 pos, int numOctaves)
         amp /= 2;
     }
     return (total / maxAmp);
-}
\ No newline at end of file
+}
+
+//  hasBakedHeights ,      
+bool Terrain::hasBakedHeights() const {
+    return bakedTiles.isOpen();
+}
+
+//  loadHeightMap     CPU,     ,   TES
+bool Terrain::loadHeightMap(const char* path, float heightScale) {
+    //    - x / (width * stepSize),      
+    glm::vec2 worldSize((float)(width * stepSize), (float)(height * stepSize));
+    return heightField.loadFromFile(path, heightScale, worldSize);
+}
+
+//  getHeight      (x, z)
+float Terrain::getHeight(float x, float z) const {
+    return heightField.getHeight(x, z);
+}
+
+//  getNormal      (x, z)
+glm::vec3 Terrain::getNormal(float x, float z) const {
+    return heightField.getNormal(x, z);
+}
+
+//  getHeights       (x, z)
+void Terrain::getHeights(const glm::vec2* points, float* heights, size_t count) const {
+    heightField.getHeights(points, heights, count);
+}
+
+//  raycast     
+bool Terrain::raycast(const glm::vec3& origin, const glm::vec3& dir, float maxDist, glm::vec3& hitPoint) const {
+    float t;
+    if (!heightField.raycast(origin, dir, maxDist, t))
+        return false;
+    hitPoint = origin + dir * t;
+    return true;
+}
+
+const HeightField& Terrain::getHeightField() const {
+    return heightField;
+}
@@ -9,14 +9,39 @@
 #include <glm/gtc/matrix_transform.hpp>
 #include <iostream>
 #include "PerlinNoise.h"
+#include "HeightField.h"
+#include "TerrainTiles.h"
+#include "StagingUploader.h"
 class Terrain
 {
 public:
 	Terrain(int widthIn, int heightIn, int stepSizeIn);
 	Terrain();
-	unsigned int getVAO();
+	// uses heights from a baked tile file (see TerrainBaker) and falls back to generateHeight with the default
+	// bake settings when it is missing. The tiles only replace this CPU-side generation of the patch corners:
+	// the tessellation evaluation shader displaces by the height map and derives its own normals, so the baked
+	// heights only feed the distances the tessellation levels are picked from and the baked normals are not read
+	Terrain(int widthIn, int heightIn, int stepSizeIn, const char* bakedPath);
+	bool hasBakedHeights() const;
+	// with an uploader the vertices are streamed through its staging ring instead of a blocking glBufferData
+	unsigned int getVAO(StagingUploader* uploader = nullptr);
+	// floats in the vertex data, five per vertex
 	int getSize();
+	// vertices in the VAO, the count for the GL_PATCHES draws
+	int getVertexCount() const;
 	PerlinNoise perlin;
+
+	// CPU height queries, valid once loadHeightMap succeeded
+	bool loadHeightMap(const char* path, float heightScale);
+	float getHeight(float x, float z) const;
+	glm::vec3 getNormal(float x, float z) const;
+	void getHeights(const glm::vec2* points, float* heights, size_t count) const;
+	bool raycast(const glm::vec3& origin, const glm::vec3& dir, float maxDist, glm::vec3& hitPoint) const;
+	const HeightField& getHeightField() const;
+	// patch corners as uploaded to the VAO: x y z u v per vertex, three vertices per patch
+	const std::vector<float>& getVertexData() const { return vertices; }
+	// world size covered by the grid
+	glm::vec2 getExtent() const { return glm::vec2((float)((width - 1) * stepSize), (float)((height - 1) * stepSize)); }
 	
 private:
 	std::vector<float> vertices;
@@ -24,8 +49,10 @@ private:
 	int width;
 	int height;
 	int stepSize;
+	HeightField heightField;
+	TerrainTileFile bakedTiles;
 	void makeVertices(std::vector<float> *vertices);
-	void makeVertex(int x, int y, std::vector<float> *vertices);
+	float* makeVertex(int x, int y, float* out) const;
 	std::vector<float> getVertices();
 	double cycleOctaves(glm::vec3 pos, int numOctaves);
 };
@@ -0,0 +1,149 @@
+#include "TerrainBaker.h"
+#include "TerrainTiles.h"
+#include "PerlinNoise.h"
+#include "JobSystem.h"
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+
+float generateHeight(const PerlinNoise &perlin, const BakeSettings &settings, double x, double z)
+{
+	return (float)(perlin.octaveNoise(x, z, settings.octaves, settings.frequency) * settings.heightScale);
+}
+
+bool bakeTerrainTiles(const BakeSettings &settings)
+{
+	const PerlinNoise perlin = settings.seed ? PerlinNoise(settings.seed) : PerlinNoise();
+	const int tileCount = settings.tilesX * settings.tilesY;
+	const int edge = settings.tileCells + 1;
+
+	std::vector<std::vector<float> > heights(tileCount);
+	std::vector<std::vector<glm::vec3> > normals(tileCount);
+
+	auto heightAt = [&](double x, double z)
+	{
+		return generateHeight(perlin, settings, x, z);
+	};
+
+	// every tile is independent: shared border samples are simply evaluated twice
+	auto bakeTile = [&](int t)
+	{
+		const int tx = t % settings.tilesX;
+		const int ty = t / settings.tilesX;
+		std::vector<float> &h = heights[t];
+		std::vector<glm::vec3> &n = normals[t];
+		h.resize((size_t)edge * edge);
+		n.resize((size_t)edge * edge);
+		const float s = settings.spacing;
+		for (int j = 0; j < edge; j++)
+		{
+			for (int i = 0; i < edge; i++)
+			{
+				double x = (tx * settings.tileCells + i) * (double)s;
+				double z = (ty * settings.tileCells + j) * (double)s;
+				h[(size_t)j * edge + i] = heightAt(x, z);
+				// central differences straight from the noise, so normals are continuous across tiles
+				float left = heightAt(x - s, z);
+				float right = heightAt(x + s, z);
+				float down = heightAt(x, z - s);
+				float up = heightAt(x, z + s);
+				n[(size_t)j * edge + i] = glm::normalize(glm::vec3(left - right, 2.0f * s, down - up));
+			}
+		}
+	};
+
+	// the calling thread helps while it waits, so a private system needs one worker less than --threads
+	std::unique_ptr<JobSystem> ownJobs;
+	if (settings.threads > 0)
+		ownJobs.reset(new JobSystem(std::max(1, settings.threads - 1)));
+	JobSystem &jobs = ownJobs ? *ownJobs : JobSystem::instance();
+	const int threadCount = jobs.getWorkerCount() + 1;
+
+	auto start = std::chrono::steady_clock::now();
+	jobs.parallelFor(0, tileCount, 1, [&](int first, int last)
+	{
+		for (int t = first; t < last; t++)
+			bakeTile(t);
+	});
+	auto baked = std::chrono::steady_clock::now();
+
+	TileFileHeader header = {};
+	header.flags = settings.quantize ? TILE_FLAG_QUANTIZED : 0;
+	header.tilesX = settings.tilesX;
+	header.tilesY = settings.tilesY;
+	header.tileCells = settings.tileCells;
+	header.sampleSpacing = settings.spacing;
+	header.seed = settings.seed;
+	header.octaves = settings.octaves;
+	header.frequency = settings.frequency;
+	header.heightScale = settings.heightScale;
+	if (!TerrainTileFile::write(settings.output.c_str(), header, heights, normals))
+	{
+		std::cout << "ERROR::TERRAIN_BAKER::WRITE_FAILED " << settings.output << std::endl;
+		return false;
+	}
+	auto written = std::chrono::steady_clock::now();
+
+	std::cout << "Baked " << tileCount << " tiles on " << threadCount << " threads in "
+		<< std::chrono::duration<double, std::milli>(baked - start).count() << " ms, written in "
+		<< std::chrono::duration<double, std::milli>(written - baked).count() << " ms to " << settings.output << std::endl;
+	return true;
+}
+
+int runTerrainBaker(int argc, char **argv)
+{
+	BakeSettings settings;
+	int i = 1;
+	if (i < argc && std::strcmp(argv[i], "--bake") == 0)
+		i++;
+	if (i < argc && argv[i][0] != '-')
+		settings.output = argv[i++];
+
+	for (; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		bool hasValue = i + 1 < argc;
+		if (arg == "--seed" && hasValue)
+			settings.seed = (unsigned int)std::strtoul(argv[++i], nullptr, 10);
+		else if (arg == "--octaves" && hasValue)
+			settings.octaves = std::atoi(argv[++i]);
+		else if (arg == "--frequency" && hasValue)
+			settings.frequency = (float)std::atof(argv[++i]);
+		else if (arg == "--scale" && hasValue)
+			settings.heightScale = (float)std::atof(argv[++i]);
+		else if (arg == "--tiles" && i + 2 < argc)
+		{
+			settings.tilesX = std::atoi(argv[++i]);
+			settings.tilesY = std::atoi(argv[++i]);
+		}
+		else if (arg == "--tile-cells" && hasValue)
+			settings.tileCells = std::atoi(argv[++i]);
+		else if (arg == "--spacing" && hasValue)
+			settings.spacing = (float)std::atof(argv[++i]);
+		else if (arg == "--threads" && hasValue)
+			settings.threads = std::atoi(argv[++i]);
+		else if (arg == "--float")
+			settings.quantize = false;
+		else
+		{
+			std::cout << "unknown baker argument: " << arg << std::endl;
+			std::cout << "usage: Lab8 --bake <file> [--seed N] [--octaves N] [--frequency F] [--scale F] "
+				"[--tiles X Y] [--tile-cells N] [--spacing F] [--float] [--threads N]" << std::endl;
+			return -1;
+		}
+	}
+	if (settings.octaves < 1 || settings.tilesX < 1 || settings.tilesY < 1 || settings.tileCells < 1 || settings.spacing <= 0.0f)
+	{
+		std::cout << "ERROR::TERRAIN_BAKER::INVALID_SETTINGS" << std::endl;
+		return -1;
+	}
+	return bakeTerrainTiles(settings) ? 0 : -1;
+}
@@ -0,0 +1,36 @@
+#pragma once
+#ifndef TERRAINBAKER_H
+#define TERRAINBAKER_H
+
+#include "PerlinNoise.h"
+
+#include <string>
+
+// Offline generation of baked terrain tiles (see TerrainTiles.h)
+struct BakeSettings
+{
+	std::string output = "terrain.tiles";
+	unsigned int seed = 0;          // 0 keeps the reference Perlin permutation, like Terrain::perlin
+	int octaves = 4;
+	float frequency = 0.005f;       // frequency of the first octave, per world unit
+	float heightScale = 1.0f;       // octave noise is in [0,1], baked heights are noise * heightScale
+	int tilesX = 4;
+	int tilesY = 4;
+	int tileCells = 16;
+	float spacing = 10.0f;          // world units between samples, Terrain's stepSize
+	bool quantize = true;
+	int threads = 0;                // 0 - one per hardware thread
+};
+
+// the height of world position (x, z): octave noise * heightScale. Terrain computes the same for its patch
+// corners when there is no baked file, so a file baked with the default settings matches that exactly
+float generateHeight(const PerlinNoise &perlin, const BakeSettings &settings, double x, double z);
+
+// generates every tile across all cores and writes the file
+bool bakeTerrainTiles(const BakeSettings &settings);
+
+// command line entry point: Lab8 --bake <file> [--seed N] [--octaves N] [--frequency F] [--scale F]
+//                                  [--tiles X Y] [--tile-cells N] [--spacing F] [--float] [--threads N]
+int runTerrainBaker(int argc, char **argv);
+
+#endif
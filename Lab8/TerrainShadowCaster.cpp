@@ -0,0 +1,158 @@
+#include "TerrainShadowCaster.h"
+#include "RenderState.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+TerrainShadowCaster::TerrainShadowCaster()
+{
+	VAO = 0;
+	VBO = 0;
+	EBO = 0;
+	indexCount = 0;
+	visibleChunks = 0;
+}
+
+TerrainShadowCaster::~TerrainShadowCaster()
+{
+	release();
+}
+
+bool TerrainShadowCaster::build(const HeightField &field, glm::vec2 extent, float spacing, int chunkCells,
+	StagingUploader *uploader)
+{
+	release();
+	if (field.empty() || spacing <= 0.0f || chunkCells < 1)
+	{
+		std::cout << "ERROR::SHADOWCASTER:: needs a loaded height field" << std::endl;
+		return false;
+	}
+
+	const int cellsX = std::max(1, (int)std::ceil(extent.x / spacing));
+	const int cellsZ = std::max(1, (int)std::ceil(extent.y / spacing));
+	const int vertsX = cellsX + 1;
+	const int vertsZ = cellsZ + 1;
+
+	// positions: one batched height query for the whole grid
+	std::vector<glm::vec2> points((size_t)vertsX * vertsZ);
+	for (int z = 0; z < vertsZ; z++)
+		for (int x = 0; x < vertsX; x++)
+			points[(size_t)z * vertsX + x] = glm::vec2(extent.x * x / cellsX, extent.y * z / cellsZ);
+	std::vector<float> heights(points.size());
+	field.getHeights(points.data(), heights.data(), points.size());
+	std::vector<glm::vec3> positions(points.size());
+	for (size_t i = 0; i < points.size(); i++)
+		positions[i] = glm::vec3(points[i].x, heights[i], points[i].y);
+
+	// indices chunk by chunk, so every chunk is one contiguous range
+	std::vector<GLuint> indices;
+	indices.reserve((size_t)cellsX * cellsZ * 6);
+	for (int cz = 0; cz < cellsZ; cz += chunkCells)
+	{
+		for (int cx = 0; cx < cellsX; cx += chunkCells)
+		{
+			Chunk chunk;
+			chunk.first = (GLsizei)indices.size();
+			chunk.boxMin = glm::vec3(INFINITY);
+			chunk.boxMax = glm::vec3(-INFINITY);
+			int endX = std::min(cx + chunkCells, cellsX);
+			int endZ = std::min(cz + chunkCells, cellsZ);
+			for (int z = cz; z < endZ; z++)
+			{
+				for (int x = cx; x < endX; x++)
+				{
+					// same winding as Terrain::makeVertices: a b c, c b f
+					GLuint a = z * vertsX + x;
+					GLuint b = a + vertsX;
+					GLuint c = a + 1;
+					GLuint f = b + 1;
+					GLuint cell[6] = { a, b, c, c, b, f };
+					for (GLuint index : cell)
+					{
+						indices.push_back(index);
+						chunk.boxMin = glm::min(chunk.boxMin, positions[index]);
+						chunk.boxMax = glm::max(chunk.boxMax, positions[index]);
+					}
+				}
+			}
+			chunk.count = (GLsizei)indices.size() - chunk.first;
+			chunks.push_back(chunk);
+		}
+	}
+	indexCount = indices.size();
+	counts.reserve(chunks.size());
+	offsets.reserve(chunks.size());
+
+	glCreateBuffers(1, &VBO);
+	glCreateBuffers(1, &EBO);
+	if (uploader)
+	{
+		glNamedBufferStorage(VBO, positions.size() * sizeof(glm::vec3), nullptr, 0);
+		glNamedBufferStorage(EBO, indices.size() * sizeof(GLuint), nullptr, 0);
+		uploader->queueBuffer(VBO, std::move(positions));
+		uploader->queueBuffer(EBO, std::move(indices));
+	}
+	else
+	{
+		glNamedBufferStorage(VBO, positions.size() * sizeof(glm::vec3), positions.data(), 0);
+		glNamedBufferStorage(EBO, indices.size() * sizeof(GLuint), indices.data(), 0);
+	}
+	// location 0 like the terrain VAO, so depthVert.vs works unchanged
+	glCreateVertexArrays(1, &VAO);
+	glVertexArrayVertexBuffer(VAO, 0, VBO, 0, sizeof(glm::vec3));
+	glVertexArrayElementBuffer(VAO, EBO);
+	glEnableVertexArrayAttrib(VAO, 0);
+	glVertexArrayAttribFormat(VAO, 0, 3, GL_FLOAT, GL_FALSE, 0);
+	glVertexArrayAttribBinding(VAO, 0, 0);
+
+	std::cout << "Shadow caster: " << getTriangleCount() << " triangles in " << chunks.size() << " chunks, "
+		<< vertsX << "x" << vertsZ << " vertices" << std::endl;
+	return true;
+}
+
+void TerrainShadowCaster::release()
+{
+	if (VAO)
+	{
+		RenderState::get().forgetVertexArray(VAO);
+		glDeleteVertexArrays(1, &VAO);
+		glDeleteBuffers(1, &VBO);
+		glDeleteBuffers(1, &EBO);
+	}
+	VAO = VBO = EBO = 0;
+	indexCount = 0;
+	visibleChunks = 0;
+	chunks.clear();
+	counts.clear();
+	offsets.clear();
+}
+
+size_t TerrainShadowCaster::draw(const Frustum &frustum)
+{
+	counts.clear();
+	offsets.clear();
+	visibleChunks = 0;
+	size_t triangles = 0;
+	for (const Chunk &chunk : chunks)
+	{
+		if (!frustum.intersects(chunk.boxMin, chunk.boxMax))
+			continue;
+		visibleChunks++;
+		triangles += chunk.count / 3;
+		// neighbouring chunks are neighbouring ranges, merge them into one draw
+		const void *offset = (const void*)(chunk.first * sizeof(GLuint));
+		if (!counts.empty() && (const char*)offsets.back() + counts.back() * sizeof(GLuint) == offset)
+			counts.back() += chunk.count;
+		else
+		{
+			counts.push_back(chunk.count);
+			offsets.push_back(offset);
+		}
+	}
+	if (counts.empty())
+		return 0;
+	RenderState::get().bindVertexArray(VAO);
+	glMultiDrawElements(GL_TRIANGLES, counts.data(), GL_UNSIGNED_INT, offsets.data(), (GLsizei)counts.size());
+	return triangles;
+}
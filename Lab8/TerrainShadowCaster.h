@@ -0,0 +1,58 @@
+#pragma once
+#ifndef TERRAINSHADOWCASTER_H
+#define TERRAINSHADOWCASTER_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <vector>
+
+#include "HeightField.h"
+#include "Frustum.h"
+#include "StagingUploader.h"
+
+// Coarse, pre-decimated copy of the terrain surface for the shadow depth pass.
+// The camera view tessellates the terrain up to 66x per patch near the viewer, which the shadow map
+// does not need: the light sees the whole terrain at roughly one texel per 0.16 units, and the silhouette
+// of a height field that has been smoothed to a few units per vertex casts practically the same shadow.
+// The grid is split into square chunks with their own bounds, culled against the light frustum and drawn
+// with a single glMultiDrawElements. Positions only, no tessellation stages needed.
+class TerrainShadowCaster
+{
+public:
+	TerrainShadowCaster();
+	~TerrainShadowCaster();
+	TerrainShadowCaster(const TerrainShadowCaster&) = delete;
+	TerrainShadowCaster &operator=(const TerrainShadowCaster&) = delete;
+
+	// grid over [0, extent.x] x [0, extent.y] with about spacing units between vertices;
+	// heights come from the field, so they match what the tessellation evaluation shader displaces to
+	bool build(const HeightField &field, glm::vec2 extent, float spacing, int chunkCells = 16,
+		StagingUploader *uploader = nullptr);
+	void release();
+
+	// culls chunks against the frustum and draws the visible ones, returns the triangles drawn
+	size_t draw(const Frustum &frustum);
+
+	size_t getTriangleCount() const { return indexCount / 3; }
+	size_t getChunkCount() const { return chunks.size(); }
+	size_t getVisibleChunks() const { return visibleChunks; }
+
+private:
+	struct Chunk
+	{
+		glm::vec3 boxMin, boxMax;
+		GLsizei first;          // offset into the index buffer, in indices
+		GLsizei count;
+	};
+
+	GLuint VAO, VBO, EBO;
+	size_t indexCount;
+	std::vector<Chunk> chunks;
+	// draw lists, kept between frames so draw() does not allocate
+	std::vector<GLsizei> counts;
+	std::vector<const void*> offsets;
+	size_t visibleChunks;
+};
+
+#endif
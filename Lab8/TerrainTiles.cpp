@@ -0,0 +1,317 @@
+#include "TerrainTiles.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+static_assert(sizeof(TileFileHeader) == 64, "TileFileHeader layout is part of the file format");
+static_assert(sizeof(TileInfo) == 32, "TileInfo layout is part of the file format");
+
+static uint64_t alignUp(uint64_t v, uint64_t a)
+{
+	return (v + a - 1) / a * a;
+}
+
+TerrainTileFile::TerrainTileFile()
+{
+	data = nullptr;
+	size = 0;
+#ifdef _WIN32
+	fileHandle = INVALID_HANDLE_VALUE;
+	mappingHandle = nullptr;
+#else
+	fd = -1;
+#endif
+}
+
+TerrainTileFile::~TerrainTileFile()
+{
+	close();
+}
+
+bool TerrainTileFile::open(const char *path)
+{
+	close();
+#ifdef _WIN32
+	HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_RANDOM_ACCESS, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+		return false;
+	LARGE_INTEGER fileSize;
+	GetFileSizeEx(file, &fileSize);
+	HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (!mapping)
+	{
+		CloseHandle(file);
+		return false;
+	}
+	data = static_cast<const unsigned char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+	fileHandle = file;
+	mappingHandle = mapping;
+	size = (size_t)fileSize.QuadPart;
+#else
+	fd = ::open(path, O_RDONLY);
+	if (fd < 0)
+		return false;
+	struct stat st;
+	fstat(fd, &st);
+	size = (size_t)st.st_size;
+	void *mapped = size ? mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+	data = mapped == MAP_FAILED ? nullptr : static_cast<const unsigned char*>(mapped);
+#endif
+	if (!data)
+	{
+		close();
+		return false;
+	}
+
+	// validate once, afterwards everything is read in place
+	const TileFileHeader &h = header();
+	bool valid = size >= sizeof(TileFileHeader) && h.magic == TILE_FILE_MAGIC && h.version == TILE_FILE_VERSION &&
+		h.tileCells > 0 && h.tileTableOffset + (uint64_t)h.tilesX * h.tilesY * sizeof(TileInfo) <= size;
+	if (valid)
+	{
+		uint64_t samples = (uint64_t)(h.tileCells + 1) * (h.tileCells + 1);
+		uint64_t heightBytes = samples * (isQuantized() ? sizeof(uint16_t) : sizeof(float));
+		uint64_t normalBytes = samples * (isQuantized() ? 2 * sizeof(int8_t) : 3 * sizeof(float));
+		for (uint32_t t = 0; t < h.tilesX * h.tilesY && valid; t++)
+		{
+			const TileInfo &info = tileInfo(t % h.tilesX, t / h.tilesX);
+			valid = info.heightsOffset + heightBytes <= size && info.normalsOffset + normalBytes <= size;
+		}
+	}
+	if (!valid)
+	{
+		std::cout << "ERROR::TERRAIN_TILES::INVALID_FILE " << path << std::endl;
+		close();
+		return false;
+	}
+	std::cout << "Mapped terrain tiles: " << path << " " << h.tilesX << "x" << h.tilesY << " tiles of " << h.tileCells << " cells" << std::endl;
+	return true;
+}
+
+void TerrainTileFile::close()
+{
+#ifdef _WIN32
+	if (data)
+		UnmapViewOfFile(data);
+	if (mappingHandle)
+		CloseHandle(mappingHandle);
+	if (fileHandle != INVALID_HANDLE_VALUE)
+		CloseHandle(fileHandle);
+	fileHandle = INVALID_HANDLE_VALUE;
+	mappingHandle = nullptr;
+#else
+	if (data)
+		munmap(const_cast<unsigned char*>(data), size);
+	if (fd >= 0)
+		::close(fd);
+	fd = -1;
+#endif
+	data = nullptr;
+	size = 0;
+}
+
+const TileInfo &TerrainTileFile::tileInfo(int tx, int ty) const
+{
+	const TileInfo *table = reinterpret_cast<const TileInfo*>(data + header().tileTableOffset);
+	return table[ty * header().tilesX + tx];
+}
+
+float TerrainTileFile::tileHeight(int tx, int ty, int i, int j) const
+{
+	const TileFileHeader &h = header();
+	const TileInfo &info = tileInfo(tx, ty);
+	size_t index = (size_t)j * (h.tileCells + 1) + i;
+	if (isQuantized())
+	{
+		const uint16_t *q = reinterpret_cast<const uint16_t*>(data + info.heightsOffset);
+		return h.heightMin + (h.heightMax - h.heightMin) * (q[index] / 65535.0f);
+	}
+	return reinterpret_cast<const float*>(data + info.heightsOffset)[index];
+}
+
+glm::vec3 TerrainTileFile::tileNormal(int tx, int ty, int i, int j) const
+{
+	const TileInfo &info = tileInfo(tx, ty);
+	size_t index = (size_t)j * (header().tileCells + 1) + i;
+	if (isQuantized())
+		return unpackNormalOct(reinterpret_cast<const int8_t*>(data + info.normalsOffset) + index * 2);
+	const float *n = reinterpret_cast<const float*>(data + info.normalsOffset) + index * 3;
+	return glm::vec3(n[0], n[1], n[2]);
+}
+
+void TerrainTileFile::locate(int gx, int gy, int &tx, int &ty, int &i, int &j) const
+{
+	const TileFileHeader &h = header();
+	const int cells = (int)h.tileCells;
+	gx = std::clamp(gx, 0, samplesX() - 1);
+	gy = std::clamp(gy, 0, samplesY() - 1);
+	// the last sample row of a tile is the first of the next one, use the lower tile for shared samples
+	tx = std::min(gx / cells, (int)h.tilesX - 1);
+	ty = std::min(gy / cells, (int)h.tilesY - 1);
+	i = gx - tx * cells;
+	j = gy - ty * cells;
+}
+
+float TerrainTileFile::height(int gx, int gy) const
+{
+	int tx, ty, i, j;
+	locate(gx, gy, tx, ty, i, j);
+	return tileHeight(tx, ty, i, j);
+}
+
+glm::vec3 TerrainTileFile::normal(int gx, int gy) const
+{
+	int tx, ty, i, j;
+	locate(gx, gy, tx, ty, i, j);
+	return tileNormal(tx, ty, i, j);
+}
+
+float TerrainTileFile::heightAt(float x, float z) const
+{
+	float fx = x / header().sampleSpacing;
+	float fz = z / header().sampleSpacing;
+	int i = (int)std::floor(fx);
+	int j = (int)std::floor(fz);
+	fx -= i;
+	fz -= j;
+	float h0 = height(i, j) + (height(i + 1, j) - height(i, j)) * fx;
+	float h1 = height(i, j + 1) + (height(i + 1, j + 1) - height(i, j + 1)) * fx;
+	return h0 + (h1 - h0) * fz;
+}
+
+static void writePadding(std::ofstream &out, uint64_t &pos, uint64_t target)
+{
+	static const char zeros[16] = {};
+	while (pos < target)
+	{
+		uint64_t n = std::min<uint64_t>(target - pos, sizeof(zeros));
+		out.write(zeros, (std::streamsize)n);
+		pos += n;
+	}
+}
+
+bool TerrainTileFile::write(const char *path, TileFileHeader h, const std::vector<std::vector<float> > &heights,
+	const std::vector<std::vector<glm::vec3> > &normals)
+{
+	const uint32_t tileCount = h.tilesX * h.tilesY;
+	const uint64_t samples = (uint64_t)(h.tileCells + 1) * (h.tileCells + 1);
+	if (heights.size() != tileCount || normals.size() != tileCount)
+		return false;
+	const bool quantized = (h.flags & TILE_FLAG_QUANTIZED) != 0;
+
+	h.magic = TILE_FILE_MAGIC;
+	h.version = TILE_FILE_VERSION;
+	h.heightMin = 1e30f;
+	h.heightMax = -1e30f;
+	std::vector<TileInfo> table(tileCount);
+	for (uint32_t t = 0; t < tileCount; t++)
+	{
+		if (heights[t].size() != samples || normals[t].size() != samples)
+			return false;
+		auto range = std::minmax_element(heights[t].begin(), heights[t].end());
+		table[t].minHeight = *range.first;
+		table[t].maxHeight = *range.second;
+		table[t].reserved = 0;
+		h.heightMin = std::min(h.heightMin, table[t].minHeight);
+		h.heightMax = std::max(h.heightMax, table[t].maxHeight);
+	}
+	if (h.heightMax <= h.heightMin)
+		h.heightMax = h.heightMin + 1.0f;
+
+	// lay out the sections
+	const uint64_t heightBytes = samples * (quantized ? sizeof(uint16_t) : sizeof(float));
+	const uint64_t normalBytes = samples * (quantized ? 2 * sizeof(int8_t) : 3 * sizeof(float));
+	h.tileTableOffset = alignUp(sizeof(TileFileHeader), 16);
+	uint64_t offset = alignUp(h.tileTableOffset + tileCount * sizeof(TileInfo), 16);
+	for (uint32_t t = 0; t < tileCount; t++)
+	{
+		table[t].heightsOffset = offset;
+		offset = alignUp(offset + heightBytes, 16);
+		table[t].normalsOffset = offset;
+		offset = alignUp(offset + normalBytes, 16);
+	}
+
+	std::ofstream out(path, std::ios::binary | std::ios::trunc);
+	if (!out)
+		return false;
+	uint64_t pos = 0;
+	out.write(reinterpret_cast<const char*>(&h), sizeof(h));
+	pos += sizeof(h);
+	writePadding(out, pos, h.tileTableOffset);
+	out.write(reinterpret_cast<const char*>(table.data()), (std::streamsize)(table.size() * sizeof(TileInfo)));
+	pos += table.size() * sizeof(TileInfo);
+
+	std::vector<uint16_t> qHeights;
+	std::vector<int8_t> qNormals;
+	for (uint32_t t = 0; t < tileCount; t++)
+	{
+		writePadding(out, pos, table[t].heightsOffset);
+		if (quantized)
+		{
+			qHeights.resize(samples);
+			for (uint64_t s = 0; s < samples; s++)
+				qHeights[s] = (uint16_t)std::lround((heights[t][s] - h.heightMin) / (h.heightMax - h.heightMin) * 65535.0f);
+			out.write(reinterpret_cast<const char*>(qHeights.data()), (std::streamsize)heightBytes);
+		}
+		else
+			out.write(reinterpret_cast<const char*>(heights[t].data()), (std::streamsize)heightBytes);
+		pos += heightBytes;
+
+		writePadding(out, pos, table[t].normalsOffset);
+		if (quantized)
+		{
+			qNormals.resize(samples * 2);
+			for (uint64_t s = 0; s < samples; s++)
+				packNormalOct(normals[t][s], &qNormals[s * 2]);
+			out.write(reinterpret_cast<const char*>(qNormals.data()), (std::streamsize)normalBytes);
+		}
+		else
+			out.write(reinterpret_cast<const char*>(normals[t].data()), (std::streamsize)normalBytes);
+		pos += normalBytes;
+	}
+	writePadding(out, pos, offset);
+	return (bool)out;
+}
+
+static float signNotZero(float v)
+{
+	return v >= 0.0f ? 1.0f : -1.0f;
+}
+
+void packNormalOct(const glm::vec3 &n, int8_t out[2])
+{
+	float l1 = std::abs(n.x) + std::abs(n.y) + std::abs(n.z);
+	glm::vec2 p(n.x / l1, n.z / l1);
+	// fold the lower hemisphere (terrain normals rarely need it, but keep it lossless in direction)
+	if (n.y < 0.0f)
+		p = glm::vec2((1.0f - std::abs(p.y)) * signNotZero(p.x), (1.0f - std::abs(p.x)) * signNotZero(p.y));
+	out[0] = (int8_t)std::lround(glm::clamp(p.x, -1.0f, 1.0f) * 127.0f);
+	out[1] = (int8_t)std::lround(glm::clamp(p.y, -1.0f, 1.0f) * 127.0f);
+}
+
+glm::vec3 unpackNormalOct(const int8_t in[2])
+{
+	glm::vec2 p(in[0] / 127.0f, in[1] / 127.0f);
+	glm::vec3 n(p.x, 1.0f - std::abs(p.x) - std::abs(p.y), p.y);
+	if (n.y < 0.0f)
+	{
+		float x = n.x;
+		n.x = (1.0f - std::abs(n.z)) * signNotZero(x);
+		n.z = (1.0f - std::abs(x)) * signNotZero(n.z);
+	}
+	return glm::normalize(n);
+}
@@ -0,0 +1,107 @@
+#pragma once
+#ifndef TERRAINTILES_H
+#define TERRAINTILES_H
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// Baked terrain tile file.
+// The file is used directly from a read-only memory mapping, so everything is fixed size, little endian and
+// 16-byte aligned - there is nothing to parse after the header checks.
+//
+//   TileFileHeader
+//   TileInfo[tilesX * tilesY]            (row major, at tileTableOffset)
+//   per tile: heights, then normals      (at TileInfo::heightsOffset / normalsOffset)
+//
+// Tiles share their border samples with their neighbours, so a tile of N cells stores (N + 1)^2 samples and
+// never needs a neighbour to be resident.
+// With TILE_FLAG_QUANTIZED heights are uint16 over [heightMin, heightMax] and normals are octahedral int8 pairs
+// (4 bytes per sample instead of 16), otherwise heights are float and normals are float xyz.
+
+const uint32_t TILE_FILE_MAGIC = 0x4C495454; // "TTIL"
+const uint32_t TILE_FILE_VERSION = 1;
+const uint32_t TILE_FLAG_QUANTIZED = 1u << 0;
+
+struct TileFileHeader
+{
+	uint32_t magic;
+	uint32_t version;
+	uint32_t flags;
+	uint32_t tilesX;
+	uint32_t tilesY;
+	uint32_t tileCells;         // cells per tile edge, samples per edge = tileCells + 1
+	float sampleSpacing;        // world units between samples
+	float heightMin;            // global range, also the quantization range
+	float heightMax;
+	// generator settings the file was baked with
+	uint32_t seed;
+	uint32_t octaves;
+	float frequency;
+	float heightScale;
+	uint32_t reserved;
+	uint64_t tileTableOffset;
+};
+
+struct TileInfo
+{
+	float minHeight;
+	float maxHeight;
+	uint64_t heightsOffset;
+	uint64_t normalsOffset;
+	uint64_t reserved;
+};
+
+// read-only view of a baked tile file
+class TerrainTileFile
+{
+public:
+	TerrainTileFile();
+	~TerrainTileFile();
+	TerrainTileFile(const TerrainTileFile&) = delete;
+	TerrainTileFile& operator=(const TerrainTileFile&) = delete;
+
+	bool open(const char *path);
+	void close();
+	bool isOpen() const { return data != nullptr; }
+
+	const TileFileHeader &header() const { return *reinterpret_cast<const TileFileHeader*>(data); }
+	const TileInfo &tileInfo(int tx, int ty) const;
+	bool isQuantized() const { return (header().flags & TILE_FLAG_QUANTIZED) != 0; }
+	// samples over the whole file in each direction
+	int samplesX() const { return (int)(header().tilesX * header().tileCells + 1); }
+	int samplesY() const { return (int)(header().tilesY * header().tileCells + 1); }
+
+	// decoded sample (i, j) of tile (tx, ty)
+	float tileHeight(int tx, int ty, int i, int j) const;
+	glm::vec3 tileNormal(int tx, int ty, int i, int j) const;
+	// decoded sample at global sample coordinates, clamped to the baked area
+	float height(int gx, int gy) const;
+	glm::vec3 normal(int gx, int gy) const;
+	// bilinear height at world position (x, z), sample (0, 0) sits at the world origin
+	float heightAt(float x, float z) const;
+
+	// writes a tile file; heights and normals hold (tileCells + 1)^2 samples per tile, tiles in row-major order
+	static bool write(const char *path, TileFileHeader header, const std::vector<std::vector<float> > &heights,
+		const std::vector<std::vector<glm::vec3> > &normals);
+
+private:
+	const unsigned char *data;
+	size_t size;
+#ifdef _WIN32
+	void *fileHandle;
+	void *mappingHandle;
+#else
+	int fd;
+#endif
+	void locate(int gx, int gy, int &tx, int &ty, int &i, int &j) const;
+};
+
+// octahedral normal packing used by quantized tiles
+void packNormalOct(const glm::vec3 &n, int8_t out[2]);
+glm::vec3 unpackNormalOct(const int8_t in[2]);
+
+#endif
@@ -0,0 +1,49 @@
+#include "TessellationController.h"
+
+TessellationController::TessellationController()
+	: control(0.2f, 0.1f, 2.0f)
+{
+	mode = MODE_OFF;
+	timeBudget = 4.0;
+	// the terrain at scale 1 is about 4.7M triangles from the start position and up to 8.7M over its middle:
+	// the start view stays close to the authored levels and the dense views are pulled in
+	triangleBudget = 4.0e6;
+	reset();
+}
+
+void TessellationController::setMode(Mode modeIn)
+{
+	mode = modeIn;
+	reset();
+}
+
+void TessellationController::reset()
+{
+	control.reset(1.0f);
+	smoothedTime.reset();
+	smoothedTriangles.reset();
+}
+
+float TessellationController::addSample(double gpuMilliseconds, uint64_t triangles)
+{
+	smoothedTime.add(gpuMilliseconds);
+	smoothedTriangles.add((double)triangles);
+	if (mode == MODE_GPU_TIME)
+		return control.update(smoothedTime.get(), timeBudget);
+	if (mode == MODE_TRIANGLES)
+		return control.update(smoothedTriangles.get(), triangleBudget);
+	return control.getScale();
+}
+
+const char *TessellationController::getModeName(Mode mode)
+{
+	switch (mode)
+	{
+	case MODE_GPU_TIME:
+		return "GPU time budget";
+	case MODE_TRIANGLES:
+		return "triangle budget";
+	default:
+		return "off";
+	}
+}
@@ -0,0 +1,47 @@
+#pragma once
+#ifndef TESSELLATIONCONTROLLER_H
+#define TESSELLATIONCONTROLLER_H
+
+#include "BudgetController.h"
+
+#include <cstdint>
+
+// Scales the terrain tessellation levels so the terrain pass holds a GPU time or a triangle budget.
+// It is fed query results that are a few frames old (QueryRing), so it never waits for the GPU; the
+// smoothing and the damped correction are BudgetController's.
+class TessellationController
+{
+public:
+	enum Mode { MODE_OFF, MODE_GPU_TIME, MODE_TRIANGLES, MODE_COUNT };
+
+	TessellationController();
+
+	void setMode(Mode mode);
+	void setTimeBudget(double milliseconds) { timeBudget = milliseconds; }
+	void setTriangleBudget(double triangles) { triangleBudget = triangles; }
+	void setLimits(float minScaleIn, float maxScaleIn) { control.setLimits(minScaleIn, maxScaleIn); }
+	// share of each correction applied per measurement, (0, 1]
+	void setDamping(float dampingIn) { control.setDamping(dampingIn); }
+
+	// one measurement of the terrain pass; returns the scale to use from now on
+	float addSample(double gpuMilliseconds, uint64_t triangles);
+	void reset();
+
+	float getScale() const { return control.getScale(); }
+	Mode getMode() const { return mode; }
+	double getTimeBudget() const { return timeBudget; }
+	double getTriangleBudget() const { return triangleBudget; }
+	double getSmoothedTime() const { return smoothedTime.get(); }
+	double getSmoothedTriangles() const { return smoothedTriangles.get(); }
+	static const char *getModeName(Mode mode);
+
+private:
+	Mode mode;
+	BudgetController control;
+	double timeBudget;
+	double triangleBudget;
+	SmoothedValue smoothedTime;
+	SmoothedValue smoothedTriangles;
+};
+
+#endif
@@ -11,30 +11,69 @@
 #include "Camera.h"
 #include "Model.h"
 #include "Terrain.h"
+#include "TerrainBaker.h"
+#include "StagingUploader.h"
+#include "JobSystem.h"
+#include "FrameArena.h"
+#include "RenderState.h"
+#include "RenderTarget.h"
+#include "RenderGraph.h"
+#include "TerrainShadowCaster.h"
+#include "Frustum.h"
+#include "QueryRing.h"
+#include "CpuTessellatedTerrain.h"
+#include "TessellationController.h"
+#include "DynamicResolution.h"
+#include "TemporalUpscaler.h"
+#include "ClusteredLights.h"
+#include "FrameUniforms.h"
+#include "RingBuffer.h"
 
 #include <iostream>
 #include <string>
 #include <numeric>
+#include <memory>
+#include <random>
 
 
 // settings
 const GLuint SCR_WIDTH = 1024;
 const GLuint SCR_HEIGHT = 1024;
 
-const GLuint SHADOW_W = 3072;
-const GLuint SHADOW_H = 3072;
+// hardware PCF smooths the edges that needed 3072^2 with nearest sampling
+const GLuint SHADOW_W = 2048;
+const GLuint SHADOW_H = 2048;
+const GLuint VARIANCE_SHADOW_SIZE = 1024;
+// dynamic resolution (R): GPU frame time to hold, and how hard the upscale sharpens
+const double FRAME_TIME_BUDGET = 8.0;
+const float UPSCALE_SHARPNESS = 0.5f;
+const float RESOLUTION_MIN_SCALE = 0.5f;
+// temporal upsampling (U): renders a quarter to half of the pixels, dynamic resolution picks where in between;
+// the history holds up to this many frames
+const float TEMPORAL_MAX_SCALE = 0.7071f;
+const float TEMPORAL_MAX_SAMPLES = 16.0f;
+
+// shadow filtering, keys 1-3; matches shadowMode in Shaders/frameBlock.glsl
+enum ShadowMode { SHADOW_PCF, SHADOW_HARDWARE, SHADOW_VARIANCE };
 
 const GLuint LOD = 32;
+const float TERRAIN_SCALE = 100.0f;
+const float CAMERA_GROUND_OFFSET = 2.0f;
+// vertex spacing of the shadow caster mesh, the height map has about one texel per unit
+const float SHADOW_CASTER_SPACING = 4.0f;
 glm::vec3 dirLightPos(0.1f,1.0f,0.2f);
+// point lights scattered over the terrain, O steps through these counts
+const size_t POINT_LIGHT_COUNTS[] = { 0, 64, 256, 1024 };
+const int POINT_LIGHT_LEVELS = sizeof(POINT_LIGHT_COUNTS) / sizeof(POINT_LIGHT_COUNTS[0]);
 
 void framebuffer_size_callback(GLFWwindow* window, int width, int height);
 void mouse_callback(GLFWwindow* window, double xpos, double ypos);
 void scroll_callback(GLFWwindow* window, double xoffset, double yoffset);
 void processInput(GLFWwindow *window);
-GLuint loadTexture(char const * path);
+GLuint loadTexture(char const * path, StagingUploader* uploader = nullptr, JobCounter* loads = nullptr);
+bool isSoftwareRenderer();
+std::vector<PointLight> scatterPointLights(size_t count, const Terrain &terrain);
 
-void setFBOcolour();
-void setFBOdepth();
 void renderQuad();
 
 // camera
@@ -44,12 +83,7 @@ float lastY = SCR_HEIGHT / 2.0f;
 bool firstMouse = true;
 
 //arrays
-GLuint VBO, VAO, quadVAO, quadVBO, FBO;
-GLuint textureColourbuffer;
-GLuint textureDepthBuffer;
-GLuint depthMap;
-GLuint SM;
-GLuint depthFBO;
+GLuint VBO, VAO, quadVAO, quadVBO;
 
 //terrain
 std::vector<float> verticies;
@@ -64,11 +98,16 @@ const float RED = 0.7f;
 const float GREEN = 0.8f;
 const float BLUE = 0.9f;
 
-int main()
+int main(int argc, char** argv)
 {
+	// offline mode: bake terrain tiles and exit, e.g. Lab8 --bake ..\\resources\\terrain.tiles --seed 7 --octaves 6
+	if (argc > 1 && std::string(argv[1]) == "--bake")
+		return runTerrainBaker(argc, argv);
+
 	glfwInit();
-	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+	// 4.5 for persistent mapping and DSA in the staging uploader
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 5);
 	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
 	GLFWwindow* window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "IMAT3907", NULL, NULL);
 	if (window == NULL)
@@ -88,25 +127,486 @@ int main()
 		std::cout << "Failed to initialize GLAD" << std::endl;
 		return -1;
 	}
-	glEnable(GL_DEPTH_TEST);
-	glEnable(GL_CULL_FACE);
-	glCullFace(GL_BACK);
+	RenderState::get().enable(GL_DEPTH_TEST);
+	RenderState::get().enable(GL_CULL_FACE);
+	RenderState::get().cullFace(GL_BACK);
+
+	// streams textures and vertex data to the GPU without blocking the frame
+	// (released before glfwTerminate, its destructor needs the context)
+	std::unique_ptr<StagingUploader> uploader(new StagingUploader());
+	// the per-frame uniform block (Shaders/frameBlock.glsl), one region per frame in flight
+	std::unique_ptr<RingBuffer> frameUniforms(new RingBuffer(4096));
 
 	// simple vertex and fragment shader - add your own tess and geo shader
 	Shader shader("..\\Shaders\\plainVert.vs", "..\\Shaders\\plainFrag.fs", "..\\Shaders\\tessEvaluationShader.tes", "..\\Shaders\\tessControlShader.tcs");
 	Shader postProcessor("..\\Shaders\\VertShader.vs", "..\\Shaders\\fragShader.fs");
 	Shader depthShader("..\\Shaders\\depthVert.vs", "..\\Shaders\\depthFrag.fs");
+	// same vertex and tessellation stages as the terrain shader, gl_Position is invariant in the TES
+	// so both programs produce the exact same depth
+	Shader terrainDepthShader("..\\Shaders\\plainVert.vs", "..\\Shaders\\depthFrag.fs", "..\\Shaders\\tessEvaluationShader.tes", "..\\Shaders\\tessControlShader.tcs");
+	// the terrain tessellated on the CPU, plain triangles through the same fragment stage
+	Shader terrainCpuShader("..\\Shaders\\terrainCpuVert.vs", "..\\Shaders\\plainFrag.fs");
+	Shader terrainCpuDepthShader("..\\Shaders\\terrainCpuVert.vs", "..\\Shaders\\depthFrag.fs");
+	Shader depthMomentsShader("..\\Shaders\\depthVert.vs", "..\\Shaders\\depthMomentsFrag.fs");
+	Shader blurShader("..\\Shaders\\VertShader.vs", "..\\Shaders\\blurFrag.fs");
+	Shader upscaleShader("..\\Shaders\\VertShader.vs", "..\\Shaders\\upscaleFrag.fs");
+	// deferred path (F): the terrain into a thin G-buffer, then one lighting pass over the pixels
+	Shader gbufferShader("..\\Shaders\\plainVert.vs", "..\\Shaders\\gbufferFrag.fs", "..\\Shaders\\tessEvaluationShader.tes", "..\\Shaders\\tessControlShader.tcs");
+	Shader gbufferCpuShader("..\\Shaders\\terrainCpuVert.vs", "..\\Shaders\\gbufferFrag.fs");
+	Shader deferredShader("..\\Shaders\\VertShader.vs", "..\\Shaders\\deferredFrag.fs");
+	Shader temporalShader("..\\Shaders\\VertShader.vs", "..\\Shaders\\temporalFrag.fs");
 	Shader ShadowM("..\\Shaders\\SMVertShader.vs", "..\\Shaders\\SMFragShader.fs");
-	GLuint heightMap = loadTexture("..\\resources\\HeightMap.jpg");
+	JobCounter textureLoads;
+	GLuint heightMap = loadTexture("..\\resources\\HeightMap.jpg", uploader.get(), &textureLoads);
 	//GLuint cat = loadTexture("..\\resources\\download.jfif");
 	
 
-	//Terrain Constructor ; number of grids in width, number of grids in height, gridSize
-	Terrain terrain(50, 50,10);
-	VAO = terrain.getVAO();	
-	setFBOcolour();
-	setFBOdepth();
-	
+	//Terrain Constructor ; number of grids in width, number of grids in height, gridSize, baked heights
+	Terrain terrain(50, 50, 10, "..\\resources\\terrain.tiles");
+	VAO = terrain.getVAO(uploader.get());
+	terrain.loadHeightMap("..\\resources\\HeightMap.jpg", TERRAIN_SCALE);
+	// the depth pass draws this instead of the tessellated terrain
+	TerrainShadowCaster shadowCaster;
+	shadowCaster.build(terrain.getHeightField(), terrain.getExtent(), SHADOW_CASTER_SPACING, 16, uploader.get());
+	Frustum lightFrustum;
+	// tessellation on the CPU (T), the default on software rasterizers where the tessellation stages crawl;
+	// at the same camera position both paths draw the same triangle count (C), unless the CPU ring overflows
+	CpuTessellatedTerrain cpuTerrain;
+	bool cpuTessellation = isSoftwareRenderer();
+	bool cpuKeyDown = false;
+	if (cpuTessellation)
+	{
+		std::cout << "Software renderer, tessellating the terrain on the CPU" << std::endl;
+		cpuTerrain.build(terrain.getVertexData(), terrain.getHeightField());
+	}
+	size_t shadowTriangles = 0;
+	// everything else these programs take comes from the per-frame block; samplers have their units in the shaders
+	for (Shader* program : { &shader, &terrainDepthShader, &gbufferShader, &depthShader, &depthMomentsShader })
+	{
+		program->use();
+		program->setMat4("model", glm::mat4(1.0f));
+	}
+	blurShader.use();
+	blurShader.setInt("image", 0);
+	upscaleShader.use();
+	upscaleShader.setInt("scene", 0);
+	temporalShader.use();
+	temporalShader.setInt("scene", 0);
+	temporalShader.setInt("sceneDepth", 1);
+	temporalShader.setInt("history", 2);
+	// the first frame needs everything, later loads go through the per-frame budget
+	JobSystem::instance().wait(textureLoads);
+	uploader->flush();
+	// the setup above bound things directly
+	RenderState::get().invalidate();
+
+	// offscreen targets come from the pool, a pass asking for the same shape every frame gets the same target back
+	RenderTargetPool targetPool;
+	RenderTargetDesc shadowDesc;
+	shadowDesc.width = SHADOW_W;
+	shadowDesc.height = SHADOW_H;
+	shadowDesc.depth.internalFormat = GL_DEPTH_COMPONENT24;
+	shadowDesc.depth.filter = GL_NEAREST;
+	shadowDesc.depth.wrap = GL_CLAMP_TO_BORDER;
+	shadowDesc.depth.border = glm::vec4(1.0f);
+	// variance shadows: filtered moments at a fraction of the depth map resolution, cleared to the far plane
+	RenderTargetDesc momentsDesc;
+	momentsDesc.width = VARIANCE_SHADOW_SIZE;
+	momentsDesc.height = VARIANCE_SHADOW_SIZE;
+	momentsDesc.colour.resize(1);
+	momentsDesc.colour[0].internalFormat = GL_RG32F;
+	momentsDesc.colour[0].wrap = GL_CLAMP_TO_BORDER;
+	momentsDesc.colour[0].border = glm::vec4(1.0f);
+	momentsDesc.depth.internalFormat = GL_DEPTH_COMPONENT24;
+	momentsDesc.depth.sampled = false;
+	RenderTargetDesc blurDesc = momentsDesc;
+	blurDesc.depth = AttachmentDesc();
+	const glm::vec4 farMoments(1.0f);
+	// dynamic resolution renders the scene into the corner of a full-size target and upscales it to the window;
+	// the depth is sampled by the temporal resolve
+	RenderTargetDesc sceneDesc;
+	sceneDesc.width = SCR_WIDTH;
+	sceneDesc.height = SCR_HEIGHT;
+	sceneDesc.colour.resize(1);
+	sceneDesc.colour[0].internalFormat = GL_RGBA8;
+	sceneDesc.depth.internalFormat = GL_DEPTH_COMPONENT24;
+	sceneDesc.depth.sampled = true;
+	// albedo and octahedral normal, 12 bytes per pixel with the depth the position is rebuilt from
+	RenderTargetDesc gbufferDesc = sceneDesc;
+	gbufferDesc.colour.resize(2);
+	gbufferDesc.colour[1].internalFormat = GL_RG16;
+	gbufferDesc.colour[0].filter = gbufferDesc.colour[1].filter = GL_NEAREST;
+
+	// the depth map is read two ways, the sampler objects override the texture's own filtering:
+	// raw depth for the manual 3x3 PCF, and hardware comparison with linear filtering (2x2 PCF per fetch)
+	GLuint shadowSamplers[2];
+	glCreateSamplers(2, shadowSamplers);
+	const GLfloat borderDepth[] = { 1.0f, 1.0f, 1.0f, 1.0f };
+	for (int i = 0; i < 2; i++)
+	{
+		GLenum filter = i == 0 ? GL_NEAREST : GL_LINEAR;
+		glSamplerParameteri(shadowSamplers[i], GL_TEXTURE_MIN_FILTER, filter);
+		glSamplerParameteri(shadowSamplers[i], GL_TEXTURE_MAG_FILTER, filter);
+		glSamplerParameteri(shadowSamplers[i], GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
+		glSamplerParameteri(shadowSamplers[i], GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
+		glSamplerParameterfv(shadowSamplers[i], GL_TEXTURE_BORDER_COLOR, borderDepth);
+	}
+	glSamplerParameteri(shadowSamplers[1], GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+	glSamplerParameteri(shadowSamplers[1], GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+
+	// optional depth pre-pass for the terrain (Z), measured with queries read back a few frames later;
+	// fragment shader invocations need pipeline statistics queries, the GPU time works everywhere
+	bool depthPrepass = false;
+	bool prepassKeyDown = false;
+	std::unique_ptr<QueryRing> terrainTime(new QueryRing(GL_TIME_ELAPSED));
+	std::unique_ptr<QueryRing> terrainFragments;
+	std::unique_ptr<QueryRing> terrainPrimitives(new QueryRing(GL_PRIMITIVES_GENERATED));
+	// scales the tessellation levels to hold the terrain pass at a GPU time or triangle budget (M cycles the mode),
+	// from the query results above; each result is fed once
+	TessellationController tessController;
+	bool tessModeKeyDown = false;
+	uint64_t tessSamples = 0;
+	// GPU time of the whole frame; timestamps, because the terrain pass has a timer query of its own
+	std::unique_ptr<QueryRing> frameTime(new QueryRing(GL_TIMESTAMP));
+	DynamicResolution dynamicResolution(SCR_WIDTH, SCR_HEIGHT);
+	dynamicResolution.setTimeBudget(FRAME_TIME_BUDGET);
+	dynamicResolution.setLimits(RESOLUTION_MIN_SCALE, 1.0f);
+	// history targets are created the first time it is switched on
+	TemporalUpscaler temporalUpscaler(SCR_WIDTH, SCR_HEIGHT);
+	bool temporalUpscaling = false;
+	bool temporalKeyDown = false;
+	// point lights binned into view-space clusters on the job system, the terrain shaders loop over their cluster
+	ClusteredLights clusteredLights;
+	std::vector<PointLight> pointLights;
+	int pointLightLevel = 0;
+	bool pointLightKeyDown = false;
+	bool resolutionKeyDown = false;
+	uint64_t frameSamples = 0;
+	if (QueryRing::pipelineStatisticsSupported())
+		terrainFragments.reset(new QueryRing(GL_FRAGMENT_SHADER_INVOCATIONS));
+	else
+		std::cout << "No pipeline statistics queries, terrain fragment counts disabled" << std::endl;
+
+	// the frame as passes over named resources; the graph orders them and hands the shadow map from the pool
+	ShadowMode shadowMode = SHADOW_HARDWARE;
+	bool showShadowMap = false;
+	GLenum terrainMode = GL_FILL;
+	RenderGraph frameGraph;
+	RenderGraph::Handle backbuffer = RenderGraph::INVALID;
+	RenderGraph::Handle shadowMap = RenderGraph::INVALID;
+	RenderGraph::Handle scene = RenderGraph::INVALID;
+	RenderGraph::Handle gbuffer = RenderGraph::INVALID;
+	// the target whose depth the temporal resolve reprojects with: the scene, or the G-buffer when deferred
+	RenderGraph::Handle sceneDepth = RenderGraph::INVALID;
+	// temporary of the variance shadow blur; out here like the others, the passes run long after the build
+	RenderGraph::Handle shadowBlur = RenderGraph::INVALID;
+	bool deferredShading = false;
+	bool deferredKeyDown = false;
+	// rebuilt when the shadow mode changes, the variance mode has its own passes and targets
+	auto buildFrameGraph = [&]()
+	{
+		frameGraph.clear();
+		backbuffer = frameGraph.importFramebuffer("backbuffer", 0, SCR_WIDTH, SCR_HEIGHT, glm::vec4(RED, GREEN, BLUE, 1.0f));
+		const bool variance = shadowMode == SHADOW_VARIANCE;
+		const bool temporal = temporalUpscaling;
+		const bool scaled = temporal || dynamicResolution.isEnabled();
+		const bool deferred = deferredShading;
+		frameGraph.addPass("shadow",
+			[&](RenderGraph::Builder &builder)
+			{
+				shadowMap = variance ? builder.create("shadowMoments", momentsDesc, farMoments) : builder.create("shadowMap", shadowDesc);
+			},
+			[&, variance](const RenderGraph::Resources &resources)
+			{
+				RenderState &state = RenderState::get();
+				resources.bind(shadowMap);
+				if (variance)
+					depthMomentsShader.use();
+				else
+					depthShader.use();
+				state.enable(GL_DEPTH_TEST);
+				state.polygonMode(GL_FILL);
+				shadowTriangles = shadowCaster.draw(lightFrustum);
+			});
+		if (variance)
+		{
+			// separable gaussian over the moments, back into the moments target through a temporary
+			frameGraph.addPass("shadowBlurX",
+				[&](RenderGraph::Builder &builder)
+				{
+					builder.read(shadowMap);
+					shadowBlur = builder.create("shadowBlur", blurDesc, farMoments);
+				},
+				[&](const RenderGraph::Resources &resources)
+				{
+					RenderState &state = RenderState::get();
+					resources.bind(shadowBlur);
+					blurShader.use();
+					blurShader.setVec2("direction", glm::vec2(1.0f, 0.0f));
+					state.bindTexture(0, resources.getColour(shadowMap));
+					state.disable(GL_DEPTH_TEST);
+					state.polygonMode(GL_FILL);
+					renderQuad();
+				});
+			frameGraph.addPass("shadowBlurY",
+				[&](RenderGraph::Builder &builder)
+				{
+					builder.read(shadowBlur);
+					shadowMap = builder.write(shadowMap);
+				},
+				[&](const RenderGraph::Resources &resources)
+				{
+					RenderState &state = RenderState::get();
+					resources.bind(shadowMap);
+					blurShader.use();
+					blurShader.setVec2("direction", glm::vec2(0.0f, 1.0f));
+					state.bindTexture(0, resources.getColour(shadowBlur));
+					state.disable(GL_DEPTH_TEST);
+					state.polygonMode(GL_FILL);
+					renderQuad();
+				});
+		}
+		if (deferred)
+		{
+			// geometry only, so the G-buffer pass carries the tessellation cost and the terrain timings
+			frameGraph.addPass("gbuffer",
+				[&](RenderGraph::Builder &builder)
+				{
+					gbuffer = builder.create("gbuffer", gbufferDesc);
+					sceneDepth = gbuffer;
+				},
+				[&, scaled](const RenderGraph::Resources &resources)
+				{
+					RenderState &state = RenderState::get();
+					resources.bind(gbuffer);
+					if (scaled)
+						state.viewport(0, 0, dynamicResolution.getWidth(), dynamicResolution.getHeight());
+					terrainTime->begin();
+					state.enable(GL_DEPTH_TEST);
+					state.depthMask(true);
+					state.depthFunc(GL_LESS);
+					state.bindTexture(0, heightMap);
+					state.bindVertexArray(VAO);
+					state.polygonMode(terrainMode);
+					if (terrainFragments)
+						terrainFragments->begin();
+					terrainPrimitives->begin();
+					if (cpuTessellation)
+					{
+						gbufferCpuShader.use();
+						cpuTerrain.draw();
+					}
+					else
+					{
+						gbufferShader.use();
+						glDrawArrays(GL_PATCHES, 0, terrain.getVertexCount());
+					}
+					terrainPrimitives->end();
+					if (terrainFragments)
+						terrainFragments->end();
+					terrainTime->end();
+				});
+			frameGraph.addPass("deferredLighting",
+				[&](RenderGraph::Builder &builder)
+				{
+					builder.read(gbuffer);
+					builder.read(shadowMap);
+					if (scaled)
+						scene = builder.create("scene", sceneDesc, glm::vec4(RED, GREEN, BLUE, 1.0f));
+					else
+						backbuffer = builder.write(backbuffer);
+				},
+				[&, variance, scaled](const RenderGraph::Resources &resources)
+				{
+					RenderState &state = RenderState::get();
+					if (scaled)
+					{
+						resources.bind(scene);
+						state.viewport(0, 0, dynamicResolution.getWidth(), dynamicResolution.getHeight());
+					}
+					else
+						resources.bind(backbuffer);
+					deferredShader.use();
+					state.bindTexture(5, resources.getColour(gbuffer, 0));
+					state.bindTexture(6, resources.getColour(gbuffer, 1));
+					state.bindTexture(7, resources.getDepth(gbuffer));
+					if (variance)
+						state.bindTexture(4, resources.getColour(shadowMap));
+					else
+					{
+						GLuint depth = resources.getDepth(shadowMap);
+						state.bindTexture(1, depth);
+						state.bindSampler(1, shadowSamplers[0]);
+						state.bindTexture(2, depth);
+						state.bindSampler(2, shadowSamplers[1]);
+					}
+					state.disable(GL_DEPTH_TEST);
+					state.polygonMode(GL_FILL);
+					renderQuad();
+					state.enable(GL_DEPTH_TEST);
+				});
+		}
+		else
+		{
+			frameGraph.addPass("terrain",
+				[&](RenderGraph::Builder &builder)
+				{
+					builder.read(shadowMap);
+					if (scaled)
+						scene = builder.create("scene", sceneDesc, glm::vec4(RED, GREEN, BLUE, 1.0f));
+					else
+						backbuffer = builder.write(backbuffer);
+					sceneDepth = scene;
+				},
+				[&, variance, scaled](const RenderGraph::Resources &resources)
+				{
+					RenderState &state = RenderState::get();
+					if (scaled)
+					{
+						resources.bind(scene);
+						state.viewport(0, 0, dynamicResolution.getWidth(), dynamicResolution.getHeight());
+					}
+					else
+						resources.bind(backbuffer);
+					terrainTime->begin();
+					state.enable(GL_DEPTH_TEST);
+					state.bindTexture(0, heightMap);
+					state.bindVertexArray(VAO);
+					state.polygonMode(terrainMode);
+					if (depthPrepass)
+					{
+						// depth only, same tessellation; the shading draw then runs one fragment per pixel
+						state.colorMask(false);
+						state.depthMask(true);
+						state.depthFunc(GL_LESS);
+						if (cpuTessellation)
+						{
+							terrainCpuDepthShader.use();
+							cpuTerrain.draw();
+						}
+						else
+						{
+							terrainDepthShader.use();
+							glDrawArrays(GL_PATCHES, 0, terrain.getVertexCount());
+						}
+						state.colorMask(true);
+						state.depthMask(false);
+						state.depthFunc(GL_EQUAL);
+					}
+					if (cpuTessellation)
+						terrainCpuShader.use();
+					else
+						shader.use();
+					if (variance)
+						state.bindTexture(4, resources.getColour(shadowMap));
+					else
+					{
+						GLuint depth = resources.getDepth(shadowMap);
+						state.bindTexture(1, depth);
+						state.bindSampler(1, shadowSamplers[0]);
+						state.bindTexture(2, depth);
+						state.bindSampler(2, shadowSamplers[1]);
+					}
+					if (terrainFragments)
+						terrainFragments->begin();
+					terrainPrimitives->begin();
+					if (cpuTessellation)
+						cpuTerrain.draw();
+					else
+						glDrawArrays(GL_PATCHES, 0, terrain.getVertexCount());
+					terrainPrimitives->end();
+					if (terrainFragments)
+						terrainFragments->end();
+					state.depthMask(true);
+					state.depthFunc(GL_LESS);
+					terrainTime->end();
+				});
+		}
+		if (temporal)
+		{
+			frameGraph.addPass("temporalResolve",
+				[&](RenderGraph::Builder &builder)
+				{
+					builder.read(scene);
+					if (sceneDepth != scene)
+						builder.read(sceneDepth);
+					backbuffer = builder.write(backbuffer);
+				},
+				[&](const RenderGraph::Resources &resources)
+				{
+					RenderState &state = RenderState::get();
+					temporalUpscaler.getOutput().bind();
+					temporalShader.use();
+					temporalShader.setVec2("renderSize", glm::vec2(temporalUpscaler.getRenderWidth(), temporalUpscaler.getRenderHeight()));
+					temporalShader.setVec2("outputSize", glm::vec2(temporalUpscaler.getOutputWidth(), temporalUpscaler.getOutputHeight()));
+					temporalShader.setVec2("jitter", temporalUpscaler.getJitter());
+					temporalShader.setMat4("reprojection", temporalUpscaler.getReprojection());
+					temporalShader.setBool("hasHistory", temporalUpscaler.hasHistory());
+					temporalShader.setFloat("maxSamples", TEMPORAL_MAX_SAMPLES);
+					state.bindTexture(0, resources.getColour(scene));
+					// units 1 and 2 keep the shadow comparison samplers, the depth is read as plain values
+					state.bindTexture(1, resources.getDepth(sceneDepth));
+					state.bindSampler(1, 0);
+					state.bindTexture(2, temporalUpscaler.getHistory());
+					state.bindSampler(2, 0);
+					state.disable(GL_DEPTH_TEST);
+					state.polygonMode(GL_FILL);
+					renderQuad();
+					state.enable(GL_DEPTH_TEST);
+					temporalUpscaler.present(0);
+					// the shadow map debug view draws over it
+					resources.bind(backbuffer);
+				});
+		}
+		else if (scaled)
+		{
+			frameGraph.addPass("upscale",
+				[&](RenderGraph::Builder &builder)
+				{
+					builder.read(scene);
+					backbuffer = builder.write(backbuffer);
+				},
+				[&](const RenderGraph::Resources &resources)
+				{
+					RenderState &state = RenderState::get();
+					resources.bind(backbuffer);
+					upscaleShader.use();
+					upscaleShader.setVec2("uvScale", dynamicResolution.getUvScale());
+					upscaleShader.setFloat("sharpness", dynamicResolution.getScale() < 1.0f ? UPSCALE_SHARPNESS : 0.0f);
+					state.bindTexture(0, resources.getColour(scene));
+					state.disable(GL_DEPTH_TEST);
+					state.polygonMode(GL_FILL);
+					renderQuad();
+					state.enable(GL_DEPTH_TEST);
+				});
+		}
+		// shadow map debug view on G; before, this drew the terrain patches with a non-tessellation program
+		// and an empty texture, which did nothing
+		frameGraph.addPass("shadowDebug",
+			[&](RenderGraph::Builder &builder)
+			{
+				builder.read(shadowMap);
+				backbuffer = builder.write(backbuffer);
+			},
+			[&, variance](const RenderGraph::Resources &resources)
+			{
+				if (!showShadowMap)
+					return;
+				RenderState &state = RenderState::get();
+				ShadowM.use();
+				ShadowM.setInt("SM", 3);
+				state.bindTexture(3, variance ? resources.getColour(shadowMap) : resources.getDepth(shadowMap));
+				state.disable(GL_DEPTH_TEST);
+				state.polygonMode(GL_FILL);
+				renderQuad();
+				state.enable(GL_DEPTH_TEST);
+			});
+		frameGraph.compile();
+#ifdef _DEBUG
+		frameGraph.printOrder();
+#endif
+	};
+	buildFrameGraph();
 
 	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 	glClearColor(RED, GREEN, BLUE, 1.0);
@@ -124,6 +624,12 @@ int main()
 	//Shadows
 
 
+#ifdef _DEBUG
+	// heap allocations per frame, the steady-state loop should not make any
+	size_t frameAllocations = heapAllocationCount();
+	float lastAllocationReport = 0.0f;
+#endif
+
 	while (!glfwWindowShouldClose(window))
 	{
 		showShadow = 0;
@@ -134,25 +640,110 @@ int main()
 		deltaTime = currentFrame - lastFrame;
 		lastFrame = currentFrame;
 		processInput(window);
-
+		bool prepassKey = glfwGetKey(window, GLFW_KEY_Z) == GLFW_PRESS;
+		if (prepassKey && !prepassKeyDown)
+		{
+			depthPrepass = !depthPrepass;
+			std::cout << "terrain depth pre-pass " << (depthPrepass ? "on" : "off") << std::endl;
+		}
+		prepassKeyDown = prepassKey;
+		bool cpuKey = glfwGetKey(window, GLFW_KEY_T) == GLFW_PRESS;
+		if (cpuKey && !cpuKeyDown)
+		{
+			cpuTessellation = !cpuTessellation;
+			if (cpuTessellation && cpuTerrain.empty())
+				cpuTerrain.build(terrain.getVertexData(), terrain.getHeightField());
+			std::cout << "terrain tessellated on the " << (cpuTessellation ? "CPU" : "GPU") << std::endl;
+		}
+		cpuKeyDown = cpuKey;
+		bool tessModeKey = glfwGetKey(window, GLFW_KEY_M) == GLFW_PRESS;
+		if (tessModeKey && !tessModeKeyDown)
+		{
+			TessellationController::Mode mode = (TessellationController::Mode)((tessController.getMode() + 1) % TessellationController::MODE_COUNT);
+			tessController.setMode(mode);
+			std::cout << "tessellation controller: " << TessellationController::getModeName(mode);
+			if (mode == TessellationController::MODE_GPU_TIME)
+				std::cout << ", " << tessController.getTimeBudget() << " ms";
+			else if (mode == TessellationController::MODE_TRIANGLES)
+				std::cout << ", " << tessController.getTriangleBudget() << " triangles";
+			std::cout << std::endl;
+		}
+		tessModeKeyDown = tessModeKey;
+		bool resolutionKey = glfwGetKey(window, GLFW_KEY_R) == GLFW_PRESS;
+		// temporal upsampling (U) renders below native resolution, it keeps dynamic resolution on
+		if (resolutionKey && !resolutionKeyDown && temporalUpscaling)
+			std::cout << "dynamic resolution stays on with temporal upsampling" << std::endl;
+		else if (resolutionKey && !resolutionKeyDown)
+		{
+			dynamicResolution.setEnabled(!dynamicResolution.isEnabled());
+			std::cout << "dynamic resolution " << (dynamicResolution.isEnabled() ? "on" : "off") << std::endl;
+			buildFrameGraph();
+		}
+		resolutionKeyDown = resolutionKey;
+		bool temporalKey = glfwGetKey(window, GLFW_KEY_U) == GLFW_PRESS;
+		if (temporalKey && !temporalKeyDown)
+		{
+			temporalUpscaling = !temporalUpscaling;
+			if (temporalUpscaling && !temporalUpscaler.getOutput().isValid() && !temporalUpscaler.create())
+				temporalUpscaling = false;
+			// upsampling only pays off below native resolution, so it brings dynamic resolution with it
+			dynamicResolution.setLimits(RESOLUTION_MIN_SCALE, temporalUpscaling ? TEMPORAL_MAX_SCALE : 1.0f);
+			if (temporalUpscaling)
+				dynamicResolution.setEnabled(true);
+			temporalUpscaler.reset();
+			std::cout << "temporal upsampling " << (temporalUpscaling ? "on" : "off") << std::endl;
+			buildFrameGraph();
+		}
+		temporalKeyDown = temporalKey;
+		bool pointLightKey = glfwGetKey(window, GLFW_KEY_O) == GLFW_PRESS;
+		if (pointLightKey && !pointLightKeyDown)
+		{
+			pointLightLevel = (pointLightLevel + 1) % POINT_LIGHT_LEVELS;
+			size_t count = POINT_LIGHT_COUNTS[pointLightLevel];
+			if (count > 0 && !clusteredLights.isCreated())
+				clusteredLights.create(POINT_LIGHT_COUNTS[POINT_LIGHT_LEVELS - 1]);
+			pointLights = scatterPointLights(count, terrain);
+			std::cout << count << " point lights" << std::endl;
+		}
+		pointLightKeyDown = pointLightKey;
+		bool deferredKey = glfwGetKey(window, GLFW_KEY_F) == GLFW_PRESS;
+		if (deferredKey && !deferredKeyDown)
+		{
+			deferredShading = !deferredShading;
+			std::cout << (deferredShading ? "deferred" : "forward") << " shading" << std::endl;
+			buildFrameGraph();
+		}
+		deferredKeyDown = deferredKey;
+		for (int mode = SHADOW_PCF; mode <= SHADOW_VARIANCE; mode++)
+		{
+			if (glfwGetKey(window, GLFW_KEY_1 + mode) == GLFW_PRESS && shadowMode != mode)
+			{
+				shadowMode = (ShadowMode)mode;
+				buildFrameGraph();
+			}
+		}
+		uploader->update();
+
+		// keep the camera above the ground
+		float ground = terrain.getHeight(camera.Position.x, camera.Position.z) + CAMERA_GROUND_OFFSET;
+		if (camera.Position.y < ground)
+			camera.Position.y = ground;
 		
 		
-		glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 1000.0f);
+		const float aspect = (float)SCR_WIDTH / (float)SCR_HEIGHT;
+		glm::mat4 projection = camera.GetProjectionMatrix(aspect, 0.1f, 1000.0f);
 		glm::mat4 view = camera.GetViewMatrix();
-		glm::mat4 model = glm::mat4(1.0f);
-
-		shader.use();
-		shader.setMat4("projection", projection);
-		shader.setMat4("view", view);
-		shader.setMat4("model", model);
-		shader.setVec3("camPos", camera.Position);
-		shader.setVec3("viewPos", camera.Position);
-		shader.setInt("showShadow", showShadow);
-		shader.setInt("heightMap", 0);
-		shader.setInt("shadowMap", 1);
-		shader.setInt("SM", 3);
-		shader.setInt("scale", 100);
-
+		if (temporalUpscaling)
+		{
+			// reprojection from the unjittered matrices, the scene itself is drawn with this frame's offset
+			temporalUpscaler.beginFrame(projection, view, dynamicResolution.getWidth(), dynamicResolution.getHeight());
+			projection = camera.GetProjectionMatrix(aspect, 0.1f, 1000.0f, temporalUpscaler.getClipJitter());
+		}
+		if (!pointLights.empty())
+		{
+			clusteredLights.update(pointLights, view, glm::radians(camera.Zoom), aspect, 0.1f, 1000.0f);
+			clusteredLights.bind();
+		}
 
 		lightPos = glm::vec3(337, 420, 250);
 		lookingAt = glm::vec3(- 390, 40, 266);
@@ -160,65 +751,145 @@ int main()
 		float near_plane = 0.01f, far_plane = 1000.f, ortho_size = 250.f;
 		lightProjection = glm::ortho(-ortho_size, ortho_size, -ortho_size, ortho_size, near_plane, far_plane);
 		lightSpaceMatrix = lightProjection * lightView;
-		shader.setMat4("lightSpaceMatrix", lightSpaceMatrix);
-		
-		//light properties
-		shader.setVec3("dirLight.position", dirLightPos);
-		shader.setVec3("dirLight.ambient", 0.5f, 0.5f, 0.5f);
-		shader.setVec3("dirLight.diffuse", 0.55f, 0.55f, 0.55f);
-		shader.setVec3("dirLight.specular", 0.6f, 0.6f, 0.6f);
-
-		shader.setVec3("sky", glm::vec3(RED, GREEN, BLUE));
 
-		depthShader.use();
-		depthShader.setMat4("lightSpaceMatrix", lightSpaceMatrix);
+		// one block for every terrain, shadow and deferred program, bound for the whole frame
+		frameUniforms->beginFrame();
+		GLintptr frameOffset = 0;
+		FrameUniforms *frame = frameUniforms->allocate<FrameUniforms>(frameOffset);
+		frame->view = view;
+		frame->projection = projection;
+		frame->inverseViewProjection = glm::inverse(projection * view);
+		frame->lightSpaceMatrix = lightSpaceMatrix;
+		frame->camPos = camera.Position;
+		frame->tessScale = tessController.getScale();
+		frame->sky = glm::vec3(RED, GREEN, BLUE);
+		frame->scale = (int)TERRAIN_SCALE;
+		//light properties
+		frame->dirLightDirection = glm::vec4(dirLightPos, 0.0f);
+		frame->dirLightAmbient = glm::vec4(0.5f, 0.5f, 0.5f, 0.0f);
+		frame->dirLightDiffuse = glm::vec4(0.55f, 0.55f, 0.55f, 0.0f);
+		frame->dirLightSpecular = glm::vec4(0.6f, 0.6f, 0.6f, 0.0f);
+		// the tiles cover the rendered area, which dynamic resolution shrinks
+		frame->clusterTileScale = glm::vec2((float)ClusteredLights::TILES_X / dynamicResolution.getWidth(),
+			(float)ClusteredLights::TILES_Y / dynamicResolution.getHeight());
+		frame->renderSize = glm::vec2(dynamicResolution.getWidth(), dynamicResolution.getHeight());
+		frame->clusterSlices = clusteredLights.getSliceParams();
+		frame->pointLightCount = (int)pointLights.size();
+		frame->shadowMode = shadowMode;
+		frame->showShadow = showShadow;
+		glBindBufferRange(GL_UNIFORM_BUFFER, FrameUniforms::FRAME_BINDING, frameUniforms->getBuffer(), frameOffset, sizeof(FrameUniforms));
+
+		lightFrustum.update(lightSpaceMatrix);
 			
-		//first
-		glViewport(0, 0, SHADOW_W, SHADOW_H);
-		depthShader.use();
-		glBindFramebuffer(GL_FRAMEBUFFER, 1);  // bind FBO		
-		glEnable(GL_DEPTH_TEST);
-		glActiveTexture(GL_TEXTURE0);
-		glBindTexture(GL_TEXTURE_2D, heightMap);
-		glClearColor(RED, GREEN, BLUE, 1.0);
-		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-		glBindVertexArray(VAO);
-		glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
-		glDrawArrays(GL_PATCHES, 0, terrain.getSize());
-		//second pass
-		glViewport(0, 0, SCR_WIDTH, SCR_HEIGHT);
-		glBindFramebuffer(GL_FRAMEBUFFER, 0);
-		shader.use();		
-		glEnable(GL_DEPTH_TEST);
-		glActiveTexture(GL_TEXTURE1);
-		glBindTexture(GL_TEXTURE_2D, depthMap);
-		glClearColor(RED, GREEN, BLUE, 1.0);
-		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-		glBindVertexArray(VAO);
-	    glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
-	    if (glfwGetKey(window, GLFW_KEY_K) == GLFW_PRESS)
-	    glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
-		glDrawArrays(GL_PATCHES, 0, terrain.getSize());
-		renderQuad();
-		if (glfwGetKey(window, GLFW_KEY_G) == GLFW_PRESS)
-		ShadowM.use();
-		glActiveTexture(GL_TEXTURE3);
-		glBindTexture(GL_TEXTURE_2D, SM);		
-		glDrawArrays(GL_PATCHES, 0, terrain.getSize());
-		renderQuad();
-
-
-
-
+		RenderState &state = RenderState::get();
+		showShadowMap = glfwGetKey(window, GLFW_KEY_G) == GLFW_PRESS;
+		terrainMode = glfwGetKey(window, GLFW_KEY_K) == GLFW_PRESS ? GL_LINE : GL_FILL;
+		if (cpuTessellation)
+		{
+			cpuTerrain.setLevelScale(tessController.getScale());
+			cpuTerrain.update(camera.Position);
+		}
+		frameTime->begin();
+		frameGraph.execute(targetPool);
+		frameTime->end();
+		targetPool.endFrame();
+		frameUniforms->endFrame();
+		if (frameTime->getResultCount() != frameSamples)
+		{
+			frameSamples = frameTime->getResultCount();
+			dynamicResolution.addSample(frameTime->getLatest() / 1.0e6);
+		}
+		if (terrainTime->getResultCount() != tessSamples && terrainPrimitives->hasResult())
+		{
+			tessSamples = terrainTime->getResultCount();
+			tessController.addSample(terrainTime->getLatest() / 1.0e6, terrainPrimitives->getLatest());
+		}
 
 		if (glfwGetKey(window, GLFW_KEY_P) == GLFW_PRESS)
+		{
 			camera.printCameraCoords();
+			// terrain point under the crosshair
+			glm::vec3 hit;
+			if (terrain.raycast(camera.Position, camera.Front, 1000.0f, hit))
+				std::cout << "picked " << hit.x << " " << hit.y << " " << hit.z << std::endl;
+		}
+
+		if (glfwGetKey(window, GLFW_KEY_C) == GLFW_PRESS)
+		{
+			// state changes that reached the driver vs. the ones the cache dropped, per frame
+			std::cout << "state calls: " << state.getIssued() << " issued, " << state.getSkipped() << " skipped" << std::endl;
+			std::cout << "terrain: " << terrainTime->getLatest() / 1.0e6 << " ms GPU";
+			if (terrainFragments)
+				std::cout << ", " << terrainFragments->getLatest() << " fragments shaded";
+			if (deferredShading)
+				std::cout << " (G-buffer)";
+			else if (depthPrepass)
+				std::cout << " (depth pre-pass)";
+			std::cout << std::endl;
+			std::cout << "terrain: " << terrainPrimitives->getLatest() << " triangles drawn, tessellation scale "
+				<< tessController.getScale() << " (" << TessellationController::getModeName(tessController.getMode()) << ")";
+			if (cpuTessellation)
+			{
+				const CpuTessellatedTerrain::Stats &cpu = cpuTerrain.getStats();
+				std::cout << ", CPU tessellated " << cpu.triangles << " from " << cpu.patches << " patches ("
+					<< cpu.evaluated << " re-tessellated, " << cpuTerrain.getPatternCount() << " patterns)"
+					<< (cpu.overflow ? ", ring full" : "");
+			}
+			std::cout << std::endl;
+			std::cout << "frame: " << frameTime->getLatest() / 1.0e6 << " ms GPU, rendered at " << dynamicResolution.getWidth()
+				<< "x" << dynamicResolution.getHeight();
+			if (temporalUpscaling)
+				std::cout << ", temporal upsampling over " << temporalUpscaler.getPhaseCount() << " jitter positions";
+			std::cout << std::endl;
+			if (!pointLights.empty())
+			{
+				const ClusteredLights::Stats &lights = clusteredLights.getStats();
+				std::cout << "point lights: " << lights.lights << ", " << lights.indices << " references in " << lights.busyClusters
+					<< " of " << ClusteredLights::CLUSTER_COUNT << " clusters, at most " << lights.maxPerCluster << " per cluster, binned in "
+					<< lights.binMilliseconds << " ms" << (lights.overflow ? ", index list full" : "") << std::endl;
+			}
+			std::cout << "shadow casters: " << shadowTriangles << " of " << shadowCaster.getTriangleCount() << " triangles, "
+				<< shadowCaster.getVisibleChunks() << " of " << shadowCaster.getChunkCount() << " chunks" << std::endl;
+		}
+		state.resetStats();
+
+		if (glfwGetKey(window, GLFW_KEY_J) == GLFW_PRESS)
+		{
+			// job system load per worker, the last line is work done by threads waiting on jobs
+			FrameVector<JobSystem::WorkerStats> stats = JobSystem::instance().getStats();
+			for (size_t i = 0; i < stats.size(); i++)
+				std::cout << "worker " << i << ": " << stats[i].jobs << " jobs, " << stats[i].steals << " stolen, "
+					<< stats[i].utilization * 100.0 << "% busy" << std::endl;
+		}
 
 		glfwSwapBuffers(window);
 		glfwPollEvents();
+		FrameArena::get().nextFrame();
+
+#ifdef _DEBUG
+		size_t allocations = heapAllocationCount();
+		if (allocations != frameAllocations && currentFrame - lastAllocationReport > 1.0f)
+		{
+			std::cout << "frame made " << allocations - frameAllocations << " heap allocations" << std::endl;
+			lastAllocationReport = currentFrame;
+		}
+		frameAllocations = heapAllocationCount();
+#endif
 	}
 
 
+	targetPool.clear();
+	glDeleteSamplers(2, shadowSamplers);
+	terrainTime.reset();
+	terrainFragments.reset();
+	terrainPrimitives.reset();
+	frameTime.reset();
+	temporalUpscaler.release();
+	clusteredLights.release();
+	cpuTerrain.release();
+	shadowCaster.release();
+	uploader.reset();
+	frameUniforms.reset();
 	glfwTerminate();
 	return 0;
 }
@@ -244,7 +915,7 @@ void processInput(GLFWwindow *window)
 // ---------------------------------------------------------------------------------------------
 void framebuffer_size_callback(GLFWwindow* window, int width, int height)
 {
-	glViewport(0, 0, width, height);
+	RenderState::get().viewport(0, 0, width, height);
 }
 
 // glfw: whenever the mouse moves, this callback is called
@@ -278,9 +949,34 @@ void scroll_callback(GLFWwindow* window, double xoffset, double yoffset)
 	camera.ProcessMouseScroll(yoffset);
 }
 
-GLuint loadTexture(char const * path)
+GLuint loadTexture(char const * path, StagingUploader* uploader, JobCounter* loads)
 {
 	GLuint textureID;
+
+	if (uploader)
+	{
+		// decoded on a worker thread, the pixels go from there straight into the upload queue
+		glCreateTextures(GL_TEXTURE_2D, 1, &textureID);
+		glTextureParameteri(textureID, GL_TEXTURE_WRAP_S, GL_REPEAT);
+		glTextureParameteri(textureID, GL_TEXTURE_WRAP_T, GL_REPEAT);
+		glTextureParameteri(textureID, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+		glTextureParameteri(textureID, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		std::string file = path;
+		JobSystem::instance().submit([file, textureID, uploader]()
+		{
+			int width, height, nrComponents;
+			unsigned char *data = stbi_load(file.c_str(), &width, &height, &nrComponents, 0);
+			if (!data)
+			{
+				std::cout << "Texture failed to load at path: " << file << std::endl;
+				return;
+			}
+			uploader->queueImage(textureID, std::shared_ptr<const unsigned char>(data, stbi_image_free), width, height, nrComponents);
+			std::cout << "Loaded texture at path: " << file << " width " << width << " id " << textureID << std::endl;
+		}, loads);
+		return textureID;
+	}
+
 	glGenTextures(1, &textureID);
 
 	int width, height, nrComponents;
@@ -317,6 +1013,38 @@ GLuint loadTexture(char const * path)
 	return textureID;
 }
 
+// Mesa's llvmpipe and softpipe, SwiftShader and the Windows fallback drivers run every stage on the CPU
+bool isSoftwareRenderer()
+{
+	const char* renderer = (const char*)glGetString(GL_RENDERER);
+	if (!renderer)
+		return false;
+	std::string name(renderer);
+	for (const char* software : { "llvmpipe", "softpipe", "SwiftShader", "GDI Generic", "Basic Render" })
+		if (name.find(software) != std::string::npos)
+			return true;
+	return false;
+}
+
+// the same lights every time for a count, a few units above the ground and each with its own colour
+std::vector<PointLight> scatterPointLights(size_t count, const Terrain &terrain)
+{
+	std::vector<PointLight> lights(count);
+	std::mt19937 random(7);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+	glm::vec2 extent = terrain.getExtent();
+	for (PointLight &light : lights)
+	{
+		float x = unit(random) * extent.x;
+		float z = unit(random) * extent.y;
+		light.position = glm::vec3(x, terrain.getHeight(x, z) + 3.0f + unit(random) * 10.0f, z);
+		light.radius = 15.0f + unit(random) * 25.0f;
+		light.colour = glm::vec3(0.3f) + 0.7f * glm::vec3(unit(random), unit(random), unit(random));
+		light.intensity = 1.5f;
+	}
+	return lights;
+}
+
 void renderQuad()
 {
 	if (quadVAO == 0)
@@ -331,7 +1059,7 @@ void renderQuad()
 
 		glGenVertexArrays(1, &quadVAO);
 		glGenBuffers(1, &quadVBO);
-		glBindVertexArray(quadVAO);
+		RenderState::get().bindVertexArray(quadVAO);
 		glBindBuffer(GL_ARRAY_BUFFER, quadVBO);
 		glBufferData(GL_ARRAY_BUFFER, sizeof(quadVertices), &quadVertices, GL_STATIC_DRAW);
 		glEnableVertexAttribArray(0);
@@ -339,52 +1067,7 @@ void renderQuad()
 		glEnableVertexAttribArray(1);
 		glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)(3 * sizeof(float)));
 	}
-	glBindVertexArray(quadVAO);
+	RenderState::get().bindVertexArray(quadVAO);
 	glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
-	glBindVertexArray(0);
 
 }
-
-
-void setFBOcolour()
-{
-	glGenFramebuffers(1, &FBO);
-	glBindFramebuffer(GL_FRAMEBUFFER, FBO);
-	
-	glGenTextures(1, &textureColourbuffer);
-	glBindTexture(GL_TEXTURE_2D, textureColourbuffer);	
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, SCR_WIDTH, SCR_HEIGHT, 0, GL_RGB, GL_UNSIGNED_BYTE, NULL);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-	glBindFramebuffer(GL_FRAMEBUFFER, textureColourbuffer);
-	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, textureColourbuffer, 0);
-
-	GLuint rbo;
-	glGenRenderbuffers(1, &rbo);
-	glBindRenderbuffer(GL_RENDERBUFFER, rbo);
-	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, SCR_WIDTH, SCR_HEIGHT);
-	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, rbo);
-
-}
-
-void setFBOdepth()
-{
-	glGenFramebuffers(1, &depthFBO);
-	glGenTextures(1, &depthMap);
-	glBindTexture(GL_TEXTURE_2D, depthMap);
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT, SHADOW_W, SHADOW_H, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
-
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
-	float boarderColour[] = { 1.0, 1.0, 1.0, 1.0 };
-	glTexParameterfv(GL_TEXTURE_2D, GL_TEXTURE_BORDER_COLOR, boarderColour);
-
-	glBindFramebuffer(GL_FRAMEBUFFER, depthFBO);
-	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, depthMap, 0);
-
-	glDrawBuffer(GL_NONE);
-	glDrawBuffer(GL_NONE);
-	glBindFramebuffer(GL_FRAMEBUFFER, 0);
-}
@@ -0,0 +1,63 @@
+#include "QueryRing.h"
+
+#include <algorithm>
+
+QueryRing::QueryRing(GLenum targetIn, int depthIn)
+{
+    target = targetIn;
+    depth = std::max(1, std::min(depthIn, MAX_DEPTH));
+    glCreateQueries(target, depth, queries);
+    for (int i = 0; i < depth; i++)
+        pending[i] = false;
+    head = 0;
+    tail = 0;
+    active = false;
+    latest = 0;
+    resultCount = 0;
+}
+
+QueryRing::~QueryRing()
+{
+    glDeleteQueries(depth, queries);
+}
+
+void QueryRing::begin()
+{
+    poll();
+    // every slot still in flight: drop this measurement instead of waiting for the GPU
+    if (pending[head])
+        return;
+    glBeginQuery(target, queries[head]);
+    active = true;
+}
+
+void QueryRing::end()
+{
+    if (!active)
+        return;
+    glEndQuery(target);
+    active = false;
+    pending[head] = true;
+    head = (head + 1) % depth;
+}
+
+bool QueryRing::poll()
+{
+    bool updated = false;
+    // results arrive in submission order, stop at the first one that is not ready
+    while (pending[tail])
+    {
+        GLint available = 0;
+        glGetQueryObjectiv(queries[tail], GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available)
+            break;
+        GLuint64 value = 0;
+        glGetQueryObjectui64v(queries[tail], GL_QUERY_RESULT, &value);
+        latest = value;
+        resultCount++;
+        updated = true;
+        pending[tail] = false;
+        tail = (tail + 1) % depth;
+    }
+    return updated;
+}
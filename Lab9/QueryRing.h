@@ -0,0 +1,43 @@
+#pragma once
+#ifndef QUERYRING_H
+#define QUERYRING_H
+
+#include <GLAD/glad.h>
+
+#include <cstdint>
+
+// A few query objects of one target used round-robin, so results are read back frames later when the GPU
+// has them instead of stalling on the one just issued. A slot whose result has not arrived yet is skipped
+// rather than waited for.
+class QueryRing
+{
+public:
+    explicit QueryRing(GLenum target, int depth = 4);
+    ~QueryRing();
+    QueryRing(const QueryRing&) = delete;
+    QueryRing& operator=(const QueryRing&) = delete;
+
+    void begin();
+    void end();
+    // collects the finished results, true when a newer one arrived
+    bool poll();
+
+    // most recent result, in the unit of the query (ns for GL_TIME_ELAPSED)
+    uint64_t getLatest() const { return latest; }
+    bool hasResult() const { return resultCount > 0; }
+
+    static const int MAX_DEPTH = 8;
+
+private:
+    GLenum target;
+    int depth;
+    GLuint queries[MAX_DEPTH];
+    bool pending[MAX_DEPTH];
+    int head;                   // slot of the next begin()
+    int tail;                   // oldest pending slot
+    bool active;                // begin() issued a query that end() has to close
+    uint64_t latest;
+    uint64_t resultCount;
+};
+
+#endif
@@ -0,0 +1,88 @@
+#include "RingBuffer.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+RingBuffer::RingBuffer(GLsizeiptr frameSizeIn, int framesIn)
+{
+    // one alignment that suits both uniform and storage block bindings
+    GLint uniformAlignment = 0, storageAlignment = 0;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &uniformAlignment);
+    glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &storageAlignment);
+    alignment = std::max<GLsizeiptr>(16, std::max(uniformAlignment, storageAlignment));
+
+    frames = std::max(1, std::min(framesIn, (int)MAX_FRAMES));
+    frameSize = (frameSizeIn + alignment - 1) / alignment * alignment;
+    frame = 0;
+    head = 0;
+    stalls = 0;
+    for (int i = 0; i < MAX_FRAMES; i++)
+        fences[i] = 0;
+
+    const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    glCreateBuffers(1, &buffer);
+    glNamedBufferStorage(buffer, frameSize * frames, nullptr, flags);
+    mapped = static_cast<unsigned char*>(glMapNamedBufferRange(buffer, 0, frameSize * frames, flags));
+    if (!mapped)
+        std::cerr << "Ring buffer mapping failed!" << std::endl;
+}
+
+RingBuffer::~RingBuffer()
+{
+    for (int i = 0; i < frames; i++)
+        if (fences[i])
+            glDeleteSync(fences[i]);
+    if (mapped)
+        glUnmapNamedBuffer(buffer);
+    glDeleteBuffers(1, &buffer);
+}
+
+void RingBuffer::beginFrame()
+{
+    frame = (frame + 1) % frames;
+    head = regionStart();
+    GLsync fence = fences[frame];
+    if (!fence)
+        return;
+    // normally signalled long ago; the flush makes sure a wait cannot hang on unsubmitted commands
+    GLenum result = glClientWaitSync(fence, 0, 0);
+    if (result == GL_TIMEOUT_EXPIRED)
+    {
+        stalls++;
+        do
+            result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+        while (result == GL_TIMEOUT_EXPIRED);
+    }
+    glDeleteSync(fence);
+    fences[frame] = 0;
+}
+
+void RingBuffer::endFrame()
+{
+    if (fences[frame])
+        glDeleteSync(fences[frame]);
+    fences[frame] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+RingBuffer::Allocation RingBuffer::allocate(GLsizeiptr size)
+{
+    Allocation allocation = { nullptr, 0, size };
+    GLintptr offset = (head + alignment - 1) / alignment * alignment;
+    if (!mapped || offset + size > regionStart() + frameSize)
+        return allocation;
+    allocation.data = mapped + offset;
+    allocation.offset = offset;
+    head = offset + size;
+    return allocation;
+}
+
+bool RingBuffer::bindRange(GLenum target, GLuint index, const void* data, GLsizeiptr size)
+{
+    Allocation allocation = allocate(size);
+    if (!allocation.data)
+        return false;
+    std::memcpy(allocation.data, data, size);
+    glBindBufferRange(target, index, buffer, allocation.offset, size);
+    return true;
+}
@@ -13,6 +13,12 @@
 #include <array>
 #include <fstream>
 #include <string>
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+
+#include "RingBuffer.h"
+#include "QueryRing.h"
 
 
 struct Vertex
@@ -20,9 +26,32 @@ struct Vertex
     glm::vec4 position; //  
 };
 
+// std140 TransformBlock  cube.cont  cube.eval
 struct Transform
 {
-    glm::mat4 MVP; //  -- (Model-View-Projection)
+    glm::mat4 viewProj;   //  -;      
+    glm::vec4 cameraPos;  //     ,    
+    glm::vec4 tessParams; //   (xy),    (z),    (w)
+    glm::ivec4 cull;      //    (x)     (y)
+};
+
+// std140 CullBlock  cull.comp
+struct CullParams
+{
+    glm::mat4 prevViewProj; //   ,     
+    glm::vec4 planes[6];    //     ,  
+    glm::vec4 pyramidSize;  //      (xy),   (z)
+    glm::uvec4 params;      //   (x),   (y),     (z)
+};
+
+// DrawElementsIndirectCommand: instanceCount  cull.comp
+struct DrawCommand
+{
+    GLuint count;
+    GLuint instanceCount;
+    GLuint firstIndex;
+    GLint baseVertex;
+    GLuint baseInstance;
 };
 
 namespace buffer
@@ -31,7 +60,6 @@ namespace buffer
     {
         VERTEX,    //    
         ELEMENT,   //     ()
-        TRANSFORM, //    
         MAX       //    
     };
 }
@@ -43,6 +71,17 @@ GLfloat zoom = 4.0f; // 
 double cursorX; //  X  
 double cursorY; //  Y  
 
+//    
+const int maxGridSide = 32;
+int gridSide = 16;             //    , gridSide^3  ( /)
+GLfloat pixelsPerEdge = 8.0f;  //       ([  ])
+bool cullBackFaces = true;     // B
+bool cullFrustum = true;       // F
+bool cullObjects = true;       // G:     GPU  
+bool cullOcclusion = true;     // H:      
+bool wireframe = true;         // W:       ,      
+bool instancesChanged = true;
+
 
 // Function prototypes
 void error_callback(int error, const char* description);
@@ -55,6 +94,8 @@ void checkShader(GLuint object);
 void checkProgram(GLuint object);
 GLuint createShader(std::string filename, GLenum type);
 GLuint createProgram(const std::vector<GLuint>& shaders);
+void createInstanceBuffers(int side, GLuint& modelBuffer, GLuint& boundsBuffer);
+void extractFrustumPlanes(const glm::mat4& viewProj, glm::vec4 planes[6]);
 
 
 //        
@@ -133,6 +174,16 @@ int main(void)
     glCreateProgramPipelines(1, &pipeline);
     glUseProgramStages(pipeline, GL_VERTEX_SHADER_BIT | GL_TESS_CONTROL_SHADER_BIT | GL_TESS_EVALUATION_SHADER_BIT | GL_FRAGMENT_SHADER_BIT, program);
 
+    //       -  
+    auto cullProgram = createProgram({ createShader("shaders/cull.comp", GL_COMPUTE_SHADER) });
+    auto reduceProgram = createProgram({ createShader("shaders/depthReduce.comp", GL_COMPUTE_SHADER) });
+    GLuint cullPipeline = 0, reducePipeline = 0;
+    glCreateProgramPipelines(1, &cullPipeline);
+    glUseProgramStages(cullPipeline, GL_COMPUTE_SHADER_BIT, cullProgram);
+    glCreateProgramPipelines(1, &reducePipeline);
+    glUseProgramStages(reducePipeline, GL_COMPUTE_SHADER_BIT, reduceProgram);
+    GLint sourceLodLoc = glGetUniformLocation(reduceProgram, "sourceLod");
+
     static const std::vector<Vertex> vertices = {
         Vertex{ glm::vec4(-1.0f,-1.0f,-1.0f, 1.0f) },
         Vertex{ glm::vec4(1.0f,-1.0f,-1.0f, 1.0f) },
@@ -150,18 +201,67 @@ int main(void)
         0, 1, 5, 4,
         7, 6, 2, 3,
         4, 5, 6, 7,
-        0, 1, 2, 3
+        0, 3, 2, 1 //    ,   :     
     };
 
-    GLint alignment = 0;
-    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
-    GLint blockSize = glm::max(GLint(sizeof(Transform)), alignment);
-
     std::array<GLuint, buffer::MAX> buffers;
     glCreateBuffers(buffer::MAX, &buffers[0]);
     glNamedBufferStorage(buffers[buffer::VERTEX], vertices.size() * sizeof(Vertex), vertices.data(), 0);
     glNamedBufferStorage(buffers[buffer::ELEMENT], indices.size() * sizeof(GLushort), indices.data(), 0);
-    glNamedBufferStorage(buffers[buffer::TRANSFORM], blockSize, nullptr, GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT);
+
+    // per-frame uniform data, written into a persistent mapping with one region per frame in flight
+    // (destroyed before glfwTerminate, it unmaps and deletes GL objects)
+    auto frameData = std::make_unique<RingBuffer>(64 * 1024);
+
+    //       SSBO,    
+    GLuint instanceBuffer = 0;
+    GLuint boundsBuffer = 0;
+
+    //       :    GPU
+    GLuint visibleBuffer = 0, commandBuffer = 0;
+    glCreateBuffers(1, &visibleBuffer);
+    glNamedBufferStorage(visibleBuffer, maxGridSide * maxGridSide * maxGridSide * sizeof(GLuint), nullptr, 0);
+    const DrawCommand drawCommand = { static_cast<GLuint>(indices.size()), 0, 0, 0, 0 };
+    glCreateBuffers(1, &commandBuffer);
+    glNamedBufferStorage(commandBuffer, sizeof(DrawCommand), &drawCommand, 0);
+
+    //     :      (   )
+    GLuint colorTexture = 0, depthTexture = 0, pyramidTexture = 0, framebuffer = 0;
+    glCreateTextures(GL_TEXTURE_2D, 1, &colorTexture);
+    glTextureStorage2D(colorTexture, 1, GL_RGBA8, width, height);
+    glCreateTextures(GL_TEXTURE_2D, 1, &depthTexture);
+    glTextureStorage2D(depthTexture, 1, GL_DEPTH_COMPONENT32F, width, height);
+    glTextureParameteri(depthTexture, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTextureParameteri(depthTexture, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glCreateFramebuffers(1, &framebuffer);
+    glNamedFramebufferTexture(framebuffer, GL_COLOR_ATTACHMENT0, colorTexture, 0);
+    glNamedFramebufferTexture(framebuffer, GL_DEPTH_ATTACHMENT, depthTexture, 0);
+    if (glCheckNamedFramebufferStatus(framebuffer, GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+        std::cerr << "Framebuffer is not complete!" << std::endl;
+
+    //  :   -     ,   texel -     
+    glm::ivec2 pyramidSize(1, 1);
+    while (pyramidSize.x * 2 <= width)
+        pyramidSize.x *= 2;
+    while (pyramidSize.y * 2 <= height)
+        pyramidSize.y *= 2;
+    int pyramidLevels = 1;
+    while ((std::max(pyramidSize.x, pyramidSize.y) >> pyramidLevels) > 0)
+        pyramidLevels++;
+    glCreateTextures(GL_TEXTURE_2D, 1, &pyramidTexture);
+    glTextureStorage2D(pyramidTexture, pyramidLevels, GL_R32F, pyramidSize.x, pyramidSize.y);
+    glTextureParameteri(pyramidTexture, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+    glTextureParameteri(pyramidTexture, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    bool pyramidValid = false;
+    glm::mat4 prevViewProj(1.0f);
+    GLint maxTessLevel = 64;
+    glGetIntegerv(GL_MAX_TESS_GEN_LEVEL, &maxTessLevel);
+
+    //     GPU,      
+    auto primitivesQuery = std::make_unique<QueryRing>(GL_PRIMITIVES_GENERATED);
+    auto gpuTimeQuery = std::make_unique<QueryRing>(GL_TIME_ELAPSED);
+    double lastReport = glfwGetTime();
+    int framesSinceReport = 0;
 
 
     GLuint vao = 0;
@@ -176,47 +276,145 @@ int main(void)
 
     glEnable(GL_DEPTH_TEST);
     glDepthFunc(GL_LEQUAL);
-    glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
 
     while (!glfwWindowShouldClose(window))
     {
+        if (instancesChanged)
+        {
+            glDeleteBuffers(1, &instanceBuffer);
+            glDeleteBuffers(1, &boundsBuffer);
+            createInstanceBuffers(gridSide, instanceBuffer, boundsBuffer);
+            instancesChanged = false;
+            //        
+            pyramidValid = false;
+        }
+        GLsizei instanceCount = gridSide * gridSide * gridSide;
+
+        frameData->beginFrame();
+        GLintptr transformOffset = 0;
+        GLintptr cullOffset = 0;
+        glm::mat4 viewProj;
         {
-            auto transform = static_cast<Transform*>(glMapNamedBufferRange(buffers[buffer::TRANSFORM],
-                0, blockSize,
-                GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT));
+            auto transform = frameData->allocate<Transform>(transformOffset);
 
             auto aspectRatio = static_cast<float>(width) / static_cast<float>(height);
             glm::mat4 Projection = glm::perspective(glm::pi<float>() * 0.25f, aspectRatio, 0.1f, 1000.0f);
             glm::mat4 View = glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 0.0f, -zoom));
             View = glm::rotate(View, glm::radians(beta), glm::vec3(1.0f, 0.0f, 0.0f));
             View = glm::rotate(View, glm::radians(alpha), glm::vec3(0.0f, 1.0f, 0.0f));
-            glm::mat4 Model = glm::mat4(1.0f);
 
-            transform->MVP = Projection * View * Model;
-
-            glUnmapNamedBuffer(buffers[buffer::TRANSFORM]);
+            viewProj = Projection * View;
+            transform->viewProj = viewProj;
+            transform->cameraPos = glm::inverse(View)[3];
+            transform->tessParams = glm::vec4(width, height, pixelsPerEdge, maxTessLevel);
+            transform->cull = glm::ivec4(cullBackFaces ? 1 : 0, cullFrustum ? 1 : 0, 0, 0);
+
+            auto cull = frameData->allocate<CullParams>(cullOffset);
+            cull->prevViewProj = prevViewProj;
+            extractFrustumPlanes(viewProj, cull->planes);
+            cull->pyramidSize = glm::vec4(pyramidSize.x, pyramidSize.y, pyramidLevels, 0.0f);
+            cull->params = glm::uvec4(instanceCount, cullObjects ? 1 : 0, cullObjects && cullOcclusion && pyramidValid ? 1 : 0, 0);
         }
 
+        gpuTimeQuery->begin();
+
+        //  :     ,   -  instanceCount .
+        //   ,   ,    
+        glClearNamedBufferSubData(commandBuffer, GL_R32UI, offsetof(DrawCommand, instanceCount), sizeof(GLuint), GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr);
+        glBindProgramPipeline(cullPipeline);
+        glBindBufferRange(GL_UNIFORM_BUFFER, 1, frameData->getBuffer(), cullOffset, sizeof(CullParams));
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, boundsBuffer);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, visibleBuffer);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 4, commandBuffer);
+        glBindTextureUnit(0, pyramidTexture);
+        glDispatchCompute((instanceCount + 63) / 64, 1, 1);
+        glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT);
+
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
         glClearBufferfv(GL_COLOR, 0, &glm::vec4(0.2f, 0.2f, 0.3f, 1.0f)[0]);
         glClearBufferfv(GL_DEPTH, 0, &glm::vec4(1.0f)[0]);
+        glPolygonMode(GL_FRONT_AND_BACK, wireframe ? GL_LINE : GL_FILL);
 
         glBindProgramPipeline(pipeline);
         glBindVertexArray(vao);
-        glBindBufferBase(GL_UNIFORM_BUFFER, 0, buffers[buffer::TRANSFORM]);
+        glBindBufferRange(GL_UNIFORM_BUFFER, 0, frameData->getBuffer(), transformOffset, sizeof(Transform));
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, instanceBuffer);
 
         // We work with 4 points per patch.
         glPatchParameteri(GL_PATCH_VERTICES, 4);
 
-        glDrawElementsInstancedBaseVertex(GL_PATCHES, static_cast<GLsizei>(indices.size()), GL_UNSIGNED_SHORT, nullptr, 1, 0);
+        //       
+        primitivesQuery->begin();
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+        glDrawElementsIndirect(GL_PATCHES, GL_UNSIGNED_SHORT, nullptr);
+        primitivesQuery->end();
+
+        //       
+        if (cullObjects && cullOcclusion)
+        {
+            glBindProgramPipeline(reducePipeline);
+            for (int level = 0; level < pyramidLevels; ++level)
+            {
+                glBindTextureUnit(0, level == 0 ? depthTexture : pyramidTexture);
+                glProgramUniform1i(reduceProgram, sourceLodLoc, level == 0 ? 0 : level - 1);
+                glBindImageTexture(0, pyramidTexture, level, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+                glm::ivec2 levelSize(std::max(pyramidSize.x >> level, 1), std::max(pyramidSize.y >> level, 1));
+                glDispatchCompute((levelSize.x + 7) / 8, (levelSize.y + 7) / 8, 1);
+                glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+            }
+            pyramidValid = true;
+        }
+        else
+            pyramidValid = false;
+        prevViewProj = viewProj;
+
+        gpuTimeQuery->end();
+        frameData->endFrame();
+
+        glBlitNamedFramebuffer(framebuffer, 0, 0, 0, width, height, 0, 0, width, height, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+        //    -    
+        framesSinceReport++;
+        double now = glfwGetTime();
+        if (now - lastReport >= 1.0)
+        {
+            std::string report = title + " | " + std::to_string(instanceCount) + " instances | "
+                + std::to_string(primitivesQuery->getLatest() / 1000) + "k primitives | "
+                + std::to_string(gpuTimeQuery->getLatest() / 1000) + " us GPU | "
+                + std::to_string(static_cast<int>(framesSinceReport / (now - lastReport))) + " fps | "
+                + std::to_string(static_cast<int>(pixelsPerEdge)) + " px/edge | cull"
+                + (cullBackFaces ? " back" : "") + (cullFrustum ? " frustum" : "")
+                + (cullObjects ? " objects" : "") + (cullObjects && cullOcclusion ? " occlusion" : "")
+                + (cullBackFaces || cullFrustum || cullObjects ? "" : " off") + (wireframe ? " | wireframe" : " | fill");
+            glfwSetWindowTitle(window, report.c_str());
+            lastReport = now;
+            framesSinceReport = 0;
+        }
 
         glfwSwapBuffers(window);
         glfwPollEvents();
     }
 
     glDeleteProgramPipelines(1, &pipeline);
+    glDeleteProgramPipelines(1, &cullPipeline);
+    glDeleteProgramPipelines(1, &reducePipeline);
     glDeleteProgram(program);
+    glDeleteProgram(cullProgram);
+    glDeleteProgram(reduceProgram);
     glDeleteVertexArrays(1, &vao);
     glDeleteBuffers(buffer::MAX, &buffers[0]);
+    glDeleteBuffers(1, &instanceBuffer);
+    glDeleteBuffers(1, &boundsBuffer);
+    glDeleteBuffers(1, &visibleBuffer);
+    glDeleteBuffers(1, &commandBuffer);
+    glDeleteFramebuffers(1, &framebuffer);
+    glDeleteTextures(1, &colorTexture);
+    glDeleteTextures(1, &depthTexture);
+    glDeleteTextures(1, &pyramidTexture);
+    frameData.reset();
+    primitivesQuery.reset();
+    gpuTimeQuery.reset();
 
     glfwDestroyWindow(window);
     glfwTerminate();
@@ -233,6 +431,34 @@ void key_callback(GLFWwindow* window, int key, int scancode, int action, int mod
 {
     if (key == GLFW_KEY_ESCAPE && action == GLFW_PRESS)
         glfwSetWindowShouldClose(window, GL_TRUE);
+
+    if (action != GLFW_PRESS)
+        return;
+
+    if (key == GLFW_KEY_UP && gridSide < maxGridSide)
+    {
+        gridSide *= 2;
+        instancesChanged = true;
+    }
+    if (key == GLFW_KEY_DOWN && gridSide > 1)
+    {
+        gridSide /= 2;
+        instancesChanged = true;
+    }
+    if (key == GLFW_KEY_LEFT_BRACKET && pixelsPerEdge > 1.0f)
+        pixelsPerEdge /= 2.0f;
+    if (key == GLFW_KEY_RIGHT_BRACKET && pixelsPerEdge < 64.0f)
+        pixelsPerEdge *= 2.0f;
+    if (key == GLFW_KEY_B)
+        cullBackFaces = !cullBackFaces;
+    if (key == GLFW_KEY_F)
+        cullFrustum = !cullFrustum;
+    if (key == GLFW_KEY_G)
+        cullObjects = !cullObjects;
+    if (key == GLFW_KEY_H)
+        cullOcclusion = !cullOcclusion;
+    if (key == GLFW_KEY_W)
+        wireframe = !wireframe;
 }
 
 //========================================================================
@@ -334,6 +560,48 @@ GLuint createProgram(const std::vector<GLuint>& shaders)
     return program;
 }
 
+//  side^3   [-1, 1]^3,   ,    .
+//   -      GPU
+void createInstanceBuffers(int side, GLuint& modelBuffer, GLuint& boundsBuffer)
+{
+    std::vector<glm::mat4> models;
+    std::vector<glm::vec4> bounds;
+    models.reserve(static_cast<size_t>(side) * side * side);
+    bounds.reserve(models.capacity());
+    float cell = 2.0f / side;
+    for (int z = 0; z < side; ++z)
+        for (int y = 0; y < side; ++y)
+            for (int x = 0; x < side; ++x)
+            {
+                glm::vec3 centre = glm::vec3(x + 0.5f, y + 0.5f, z + 0.5f) * cell - glm::vec3(1.0f);
+                glm::mat4 model = glm::translate(glm::mat4(1.0f), centre);
+                model = glm::rotate(model, 0.7f * static_cast<float>(models.size()), glm::normalize(glm::vec3(1.0f, 1.0f, 0.0f)));
+                model = glm::scale(model, glm::vec3(cell * 0.35f));
+                models.push_back(model);
+                //    [-1, 1]^3,    
+                bounds.push_back(glm::vec4(centre, cell * 0.35f * std::sqrt(3.0f)));
+            }
+
+    glCreateBuffers(1, &modelBuffer);
+    glNamedBufferStorage(modelBuffer, models.size() * sizeof(glm::mat4), models.data(), 0);
+    glCreateBuffers(1, &boundsBuffer);
+    glNamedBufferStorage(boundsBuffer, bounds.size() * sizeof(glm::vec4), bounds.data(), 0);
+}
+
+//      - (Gribb, Hartmann),    
+void extractFrustumPlanes(const glm::mat4& viewProj, glm::vec4 planes[6])
+{
+    glm::mat4 m = glm::transpose(viewProj);
+    planes[0] = m[3] + m[0];
+    planes[1] = m[3] - m[0];
+    planes[2] = m[3] + m[1];
+    planes[3] = m[3] - m[1];
+    planes[4] = m[3] + m[2];
+    planes[5] = m[3] - m[2];
+    for (int i = 0; i < 6; ++i)
+        planes[i] /= glm::length(glm::vec3(planes[i]));
+}
+
 void checkShader(GLuint object)
 {
     GLint isCompiled{};
@@ -2,6 +2,18 @@
 
 layout(location = 0) in vec4 position;
 
+// per-instance model matrices
+layout(std430, binding = 1) readonly buffer InstanceBlock
+{
+	mat4 model[];
+} Instances;
+
+// ids of the objects that survived culling, written by cull.comp
+layout(std430, binding = 3) readonly buffer VisibleBlock
+{
+	uint index[];
+} Visible;
+
 out gl_PerVertex
 {
 	vec4 gl_Position;
@@ -9,5 +21,6 @@ out gl_PerVertex
 
 void main()
 {
-	gl_Position = position;
-}
\ No newline at end of file
+	// world space, the control shader measures and culls patches there
+	gl_Position = Instances.model[Visible.index[gl_InstanceID]] * position;
+}